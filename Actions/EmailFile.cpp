@@ -2,12 +2,16 @@
 // Module: EmailFile
 //
 // Description: Take passed in file  attach it to an email and send to recipient
-// (SMTP) or append it to an email box (IMAP).
+// (SMTP) or append it to an email box (IMAP). Mail messages are generated by
+// MailMessage so attachments are base64 encoded a block at a time as they are
+// sent rather than held in memory whole. With a spool directory any file that
+// cannot be delivered is spooled and retried in the background.
 // 
 // Dependencies:
 // 
 // C11++              : Use of C11++ features.
-// Antik Classes      : CSMTP, CIMAP, CIMAPParse, CMIME, CFile, CPath
+// Antik Classes      : CSMTP, CMIME, CFile, CPath
+// libcurl            : SMTP session pool and IMAP session.
 // Linux              : Target platform
 //
 
@@ -20,6 +24,8 @@
 //
 
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 
 
 //
@@ -27,8 +33,6 @@
 //
 
 #include "CSMTP.hpp"
-#include "CIMAP.hpp"
-#include "CIMAPParse.hpp"
 #include "CMIME.hpp"
 #include "CFile.hpp"
 #include "CPath.hpp"
@@ -47,7 +51,6 @@ namespace FPE_TaskActions {
     // =======
 
     using namespace FPE;
-    using namespace Antik::IMAP;
     using namespace Antik::File;
     using namespace Antik::SMTP;
 
@@ -55,89 +58,243 @@ namespace FPE_TaskActions {
     // LOCAL VARIABLES
     // ===============
 
+    //
+    // IMAP append batch / SMTP digest defaults
+    //
+
+    constexpr int kDefaultBatchWait { 5 }; // seconds
+    constexpr std::size_t kMaxAppendBytes { 64 * 1024 * 1024 }; // Bytes of files per IMAP append batch
+    constexpr int kDefaultDigestSize { 10 * 1024 }; // KB of attachments per digest email
+
     // ===============
     // LOCAL FUNCTIONS
     // ===============
 
+    //
+    // Size of file (zero if it cannot be read).
+    //
+
+    static std::size_t fileSize(const std::string &file) {
+
+        std::ifstream fileStream(file, std::ios::binary | std::ios::ate);
+
+        return ((fileStream) ? static_cast<std::size_t> (fileStream.tellg()) : 0);
+
+    }
+
+    //
+    // Create mail message with files attached. More than one file makes a
+    // digest whose body lists the files attached. Files at least the compress
+    // size are attached gzipped unless their content is already compressed.
+    //
+
+    static std::unique_ptr<MailMessage> createMailMessage(std::unordered_map<std::string, std::string> &actionData,
+                                                          const std::vector<std::string> &files) {
+
+        std::unique_ptr<MailMessage> mailMessage;
+
+        if (files.size() == 1) {
+            mailMessage.reset(new MailMessage("<" + actionData[kUserOption] + ">",
+                                              "<" + actionData[kRecipientOption] + ">", "FPE Attached File"));
+        } else {
+            std::string body;
+            mailMessage.reset(new MailMessage("<" + actionData[kUserOption] + ">",
+                                              "<" + actionData[kRecipientOption] + ">",
+                                              "FPE Attached Files (" + std::to_string(files.size()) + ")"));
+            for (auto &file : files) {
+                body += file + "\r\n";
+            }
+            mailMessage->setBody(body);
+        }
+
+        long long compressSize = -1;
+
+        if (!actionData[kCompressOption].empty()) {
+            compressSize = std::stoll(actionData[kCompressOption]) * 1024;
+        }
+
+        for (auto &file : files) {
+            std::string contentType { CMIME::getFileMIMEType(file) };
+            if ((compressSize >= 0) && (static_cast<long long> (fileSize(file)) >= compressSize) &&
+                    !GZipFile::isCompressedType(contentType)) {
+                mailMessage->addCompressedAttachment(file);
+            } else {
+                mailMessage->addAttachment(file, contentType);
+            }
+        }
+
+        return (mailMessage);
+
+    }
+
     // ================
     // PUBLIC FUNCTIONS
     // ================
 
     //
-    // Email file task action.
+    // Email file task action. For an SMTP server a pool of sessions is
+    // created that are only connected when first used. For an IMAP server a
+    // single session is kept for the life of the task. If a batch size is
+    // given files are collected and either appended to the mailbox together
+    // or sent as attachments to a single digest email; a digest is sent when
+    // it reaches the batch size, the digest size or has waited batch wait
+    // seconds.
     //
 
     void EmailFile::init(void) {
+
         CSMTP::init();
+
+        int batchSize = (!this->m_actionData[kBatchSizeOption].empty()) ? std::stoi(this->m_actionData[kBatchSizeOption]) : 1;
+        int batchWait = (!this->m_actionData[kBatchWaitOption].empty()) ? std::stoi(this->m_actionData[kBatchWaitOption]) : kDefaultBatchWait;
+        int digestSize = (!this->m_actionData[kDigestSizeOption].empty()) ? std::stoi(this->m_actionData[kDigestSizeOption]) : kDefaultDigestSize;
+
+        if (this->m_actionData[kServerOption].find(std::string("smtp")) == 0) {
+
+            this->m_smtpPool.reset(new SMTPPool(this->m_actionData[kServerOption],
+                    this->m_actionData[kUserOption], this->m_actionData[kPasswordOption]));
+
+            this->m_maxBatchBytes = static_cast<std::size_t> (digestSize) * 1024;
+
+        } else if (this->m_actionData[kServerOption].find(std::string("imap")) == 0) {
+
+            this->m_imapSession.reset(new IMAPSession(this->m_actionData[kServerOption],
+                    this->m_actionData[kUserOption], this->m_actionData[kPasswordOption]));
+
+            this->m_maxBatchBytes = kMaxAppendBytes;
+
+        }
+
+        if (!this->m_actionData[kSpoolOption].empty()) {
+            this->m_spool.reset(new ActionSpool(this->m_actionData[kSpoolOption], this->m_actionData[kServerOption],
+                    [this] (const std::string & file) {
+                        std::vector<std::string> files { file };
+                        return (this->sendFiles(files));
+                    }, ActionSpool::Settings::fromOptions(this->m_actionData)));
+        }
+
+        if (batchSize > 1) {
+            this->m_batch.reset(new ActionBatch(batchSize, this->m_maxBatchBytes, std::chrono::seconds(batchWait),
+                    [this] (std::vector<std::string> &files) {
+                        if (!this->sendFiles(files)) {
+                            if (!this->m_spool || !this->m_spool->spoolFailed(files)) {
+                                this->m_failedFiles += files.size();
+                            }
+                        }
+                    }));
+        }
+
     };
 
+    //
+    // Send any files still waiting in a batch and report any batched files
+    // that could not be delivered or spooled.
+    //
+
     void EmailFile::term(void) {
+
+        this->m_batch.reset();
+        this->m_spool.reset();
+        this->m_imapSession.reset();
+        this->m_smtpPool.reset();
+
         CSMTP::closedown();
+
+        if (this->m_failedFiles) {
+            std::cerr << this->getName() << " Error: Failed to send " << this->m_failedFiles << " batched files." << std::endl;
+            this->m_failedFiles = 0;
+        }
+
     };
 
-    bool EmailFile::process(const std::string &file) {
+    //
+    // Send files to server (emailed or appended to mailbox). On failure files
+    // is left holding those not delivered.
+    //
 
-        // ASSERT for any invalid options.
+    bool EmailFile::sendFiles(std::vector<std::string> &files) {
 
-        assert(file.length() != 0);
+        if (this->m_imapSession) {
+            return (this->appendFiles(files));
+        }
 
-        bool bSuccess = false;
+        if (this->m_smtpPool) {
+            return (this->mailFiles(files));
+        }
 
-        CSMTP smtp;
+        return (false);
 
-        // Form source file path
+    }
 
-        CPath sourceFile(file);
+    //
+    // Email files to recipient as attachments to a single message.
+    //
 
-        try {
+    bool EmailFile::mailFiles(std::vector<std::string> &files) {
 
-            smtp.setServer(this->m_actionData[kServerOption]);
-            smtp.setUserAndPassword(this->m_actionData[kUserOption], this->m_actionData[kPasswordOption]);
-            smtp.setFromAddress("<" + this->m_actionData[kUserOption] + ">");
-            smtp.setToAddress("<" + this->m_actionData[kRecipientOption] + ">");
+        bool bSuccess = false;
+
+        try {
 
-            smtp.setMailSubject("FPE Attached File");
-            smtp.addFileAttachment(file, CMIME::getFileMIMEType(file), "base64");
+            std::unique_ptr<MailMessage> mailMessage { createMailMessage(this->m_actionData, files) };
 
-            if (this->m_actionData[kServerOption].find(std::string("smtp")) == 0) {
+            this->m_smtpPool->postMail("<" + this->m_actionData[kUserOption] + ">",
+                    { "<" + this->m_actionData[kRecipientOption] + ">"}, *mailMessage);
 
-                smtp.postMail();
+            for (auto &file : files) {
                 std::cout << "Emailing file [" << file << "] to [" << this->m_actionData[kRecipientOption] << "]" << std::endl;
-                bSuccess = true;
+            }
 
-            } else if (this->m_actionData[kServerOption].find(std::string("imap")) == 0) {
+            bSuccess = true;
 
-                CIMAP imap;
-                std::string mailMessage;
-                std::string commandLine;
+        } catch (const MailMessage::Exception &e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        } catch (const SMTPPool::Exception &e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        } catch (const std::exception & e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        }
 
-                commandLine = "Append " + this->m_actionData[kMailBoxOption] + " (\\Seen) {";
-                mailMessage = smtp.getMailMessage();
-                commandLine += std::to_string(mailMessage.length() - 2) + "}" + mailMessage;
+        return (bSuccess);
 
-                imap.setServer(this->m_actionData[kServerOption]);
-                imap.setUserAndPassword(this->m_actionData[kUserOption], this->m_actionData[kPasswordOption]);
+    }
 
-                imap.connect();
+    //
+    // Append files to IMAP mailbox over the session's connection. If an
+    // append fails then those files already appended are removed from files
+    // so that only the rest are spooled (appending them again would store
+    // duplicate messages).
+    //
+
+    bool EmailFile::appendFiles(std::vector<std::string> &files) {
+
+        std::vector<std::unique_ptr<MailMessage>> mailMessages;
+        std::vector<MailMessage *> appendMessages;
+        bool bSuccess = false;
 
-                std::string response(imap.sendCommand(commandLine));
+        try {
 
-                CIMAPParse::COMMANDRESPONSE commandResponse(CIMAPParse::parseResponse(response));
-                if (commandResponse->status == CIMAPParse::RespCode::BAD) {
-                    std::cout << commandResponse->errorMessage << std::endl;
-                } else {
-                    std::cout << "Added file [" << file << "] to [" << this->m_actionData[kMailBoxOption] << "]" << std::endl;
-                    bSuccess = true;
-                }
+            for (auto &file : files) {
+                mailMessages.push_back(createMailMessage(this->m_actionData, { file }));
+                appendMessages.push_back(mailMessages.back().get());
+            }
 
-                imap.disconnect();
+            this->m_imapSession->append(this->m_actionData[kMailBoxOption], appendMessages);
 
+            for (auto &file : files) {
+                std::cout << "Added file [" << file << "] to [" << this->m_actionData[kMailBoxOption] << "]" << std::endl;
             }
 
-        } catch (const CSMTP::Exception &e) {
+            bSuccess = true;
+
+        } catch (const MailMessage::Exception &e) {
             std::cerr << this->getName() << " Error: " << e.what() << std::endl;
-        } catch (const CIMAP::Exception &e) {
+        } catch (const IMAPSession::Exception &e) {
             std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+            for (std::size_t file = 0; file < e.appended; file++) {
+                std::cout << "Added file [" << files[file] << "] to [" << this->m_actionData[kMailBoxOption] << "]" << std::endl;
+            }
+            files.erase(files.begin(), files.begin() + std::min(e.appended, files.size()));
         } catch (const std::exception & e) {
             std::cerr << this->getName() << " Error: " << e.what() << std::endl;
         }
@@ -146,4 +303,31 @@ namespace FPE_TaskActions {
 
     }
 
+    bool EmailFile::process(const std::string &file) {
+
+        // ASSERT for any invalid options.
+
+        assert(file.length() != 0);
+
+        std::vector<std::string> files { file };
+
+        // Batching so queue file unless it is too large to share a message
+        // (or the server is down and it is going straight to the spool)
+
+        if (this->m_batch && (!this->m_spool || this->m_spool->serverAvailable())) {
+            std::size_t bytes = fileSize(file);
+            if (bytes < this->m_maxBatchBytes) {
+                this->m_batch->add(file, bytes);
+                return (true);
+            }
+        }
+
+        if (this->m_spool) {
+            return (this->m_spool->submit(file));
+        }
+
+        return (this->sendFiles(files));
+
+    }
+
 } // namespace FPE_TaskActions
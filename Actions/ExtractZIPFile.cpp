@@ -0,0 +1,297 @@
+//
+// Module: ExtractZIPFile
+//
+// Description: Take passed in ZIP archive and extract its entries into the
+// destination directory (keeping the archive's place in the watch folder's
+// directory structure, as for a file copy). The central directory is read
+// once and entries are inflated in parallel by --threads worker threads.
+// Entry names that are absolute, contain ".." or would otherwise resolve
+// outside of the destination (zip-slip) are refused, as are symbolic links.
+// Only the last of any entries with the same name is extracted so that no
+// two workers ever write the same file.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Antik Classes      : CFile, CPath.
+// Linux              : Target platform.
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+//
+// Antik Classes
+//
+
+#include "CFile.hpp"
+#include "CPath.hpp"
+
+//
+// Program components.
+//
+
+#include "FPE.hpp"
+#include "FPE_Actions.hpp"
+
+//
+// Linux
+//
+
+#include <sys/stat.h>
+
+namespace FPE_TaskActions {
+
+    // =======
+    // IMPORTS
+    // =======
+
+    using namespace FPE;
+    using namespace Antik::File;
+
+    namespace fs = std::filesystem;
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Path lies within (or is) root directory.
+    //
+
+    static bool withinRoot(const fs::path &root, const fs::path &path) {
+
+        auto rootEnd = std::mismatch(root.begin(), root.end(), path.begin(), path.end()).first;
+
+        return (rootEnd == root.end());
+
+    }
+
+    //
+    // Destination for entry name under root. False (zip-slip) if the name is
+    // empty, absolute, uses backslashes or has a ".." component.
+    //
+
+    static bool entryDestination(const fs::path &root, const std::string &entryName, fs::path &destination) {
+
+        fs::path entryPath(entryName);
+
+        if (entryName.empty() || entryPath.is_absolute() || (entryName.find('\\') != std::string::npos)) {
+            return (false);
+        }
+
+        for (auto &component : entryPath) {
+            if (component == "..") {
+                return (false);
+            }
+        }
+
+        destination = (root / entryPath).lexically_normal();
+
+        return (withinRoot(root, destination));
+
+    }
+
+    //
+    // Create directory (and any parents) unless its deepest existing part,
+    // with any links resolved, is outside of root (a directory already in
+    // the tree may be a link out of it). False if outside of root.
+    //
+
+    static bool createDirectory(const fs::path &root, const fs::path &directory) {
+
+        fs::path existing { directory };
+
+        while (!existing.empty() && !fs::exists(fs::symlink_status(existing))) {
+            existing = existing.parent_path();
+        }
+
+        if (!withinRoot(root, fs::canonical(existing))) {
+            return (false);
+        }
+
+        fs::create_directories(directory);
+
+        return (true);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Extract ZIP archive task action.
+    //
+
+    bool ExtractZIPFile::process(const std::string &file) {
+
+        // ASSERT for any invalid options.
+
+        assert(file.length() != 0);
+
+        bool bSuccess = false;
+
+        try {
+
+            // Form source and destination paths
+
+            CPath sourceFile(file);
+
+            // Destination file path += ("filename path" - "watch folder path")
+            // and entries are extracted to its directory.
+
+            CPath destinationFile { this->m_actionData[kDestinationOption] };
+            destinationFile.join(file.substr((this->m_actionData[kWatchOption]).length()));
+
+            fs::path root { destinationFile.parentPath().toString() };
+
+            if (!CFile::exists(destinationFile.parentPath())) {
+                fs::create_directories(root);
+                std::cout << "Created :" << root.string() << std::endl;
+            }
+
+            root = fs::canonical(root);
+
+            // Read central directory once
+
+            ZIPArchive archive(sourceFile.toString());
+
+            archive.open(true);
+
+            std::vector<ZIPArchive::Entry> archiveEntries { archive.entries() };
+            std::vector<std::pair<ZIPArchive::Entry, fs::path>> entries;
+            std::unordered_map<std::string, std::size_t> lastEntry;
+            std::atomic<std::size_t> nextEntry { 0 };
+            std::atomic<std::size_t> failed { 0 };
+
+            std::cout << "EXTRACT [" << sourceFile.toString() << "] (" << archiveEntries.size() << " entries) TO [" << root.string() << "]" << std::endl;
+
+            // Refuse unsafe entries and keep only the last entry for each
+            // destination (an archive may hold several versions of a file)
+            // before any worker starts
+
+            for (auto &entry : archiveEntries) {
+
+                fs::path destination;
+
+                if (!entryDestination(root, entry.name, destination)) {
+                    std::cerr << this->getName() << " Error: Unsafe entry name [" << entry.name << "] not extracted." << std::endl;
+                    failed++;
+                    continue;
+                }
+
+                if (S_ISLNK(entry.externalAttributes >> 16)) {
+                    std::cerr << this->getName() << " Error: Symbolic link [" << entry.name << "] not extracted." << std::endl;
+                    failed++;
+                    continue;
+                }
+
+                auto last = lastEntry.find(destination.string());
+
+                if (last != lastEntry.end()) {
+                    std::cout << "Entry [" << entry.name << "] replaces an earlier entry of the same name." << std::endl;
+                    entries[last->second] = {entry, destination};
+                } else {
+                    lastEntry[destination.string()] = entries.size();
+                    entries.emplace_back(entry, destination);
+                }
+
+            }
+
+            // Each worker takes the next entry not yet extracted
+
+            auto extractEntries = [&] () {
+
+                for (std::size_t index = nextEntry++; index < entries.size(); index = nextEntry++) {
+
+                    const ZIPArchive::Entry &entry = entries[index].first;
+                    const fs::path &destination = entries[index].second;
+
+                    try {
+
+                        bool bDirectory = (entry.name.back() == '/');
+
+                        if (!createDirectory(root, (bDirectory) ? destination : destination.parent_path())) {
+                            std::cerr << (this->getName() + " Error: Entry [" + entry.name + "] resolves outside of destination.\n");
+                            failed++;
+                            continue;
+                        }
+
+                        if (bDirectory) {
+                            continue;
+                        }
+
+                        // Currently only extract file if it doesn't already exist.
+
+                        if (fs::exists(fs::symlink_status(destination))) {
+                            std::cout << ("Destination already exists : " + destination.string() + "\n");
+                            continue;
+                        }
+
+                        archive.extract(entry, destination.string());
+
+                    } catch (const std::exception &e) {
+                        std::cerr << (this->getName() + " Error: " + e.what() + "\n");
+                        failed++;
+                    }
+
+                }
+
+            };
+
+            std::size_t threads = std::thread::hardware_concurrency();
+            if (!this->m_actionData[kThreadsOption].empty()) {
+                threads = std::stoi(this->m_actionData[kThreadsOption]);
+            }
+            threads = std::max<std::size_t>(1, std::min(threads, entries.size()));
+
+            std::vector<std::thread> workers;
+
+            for (std::size_t worker = 1; worker < threads; worker++) {
+                workers.emplace_back(extractEntries);
+            }
+
+            extractEntries();
+
+            for (auto &worker : workers) {
+                worker.join();
+            }
+
+            archive.close();
+
+            if (failed == 0) {
+                bSuccess = true;
+                if (!this->m_actionData[kDeleteOption].empty()) {
+                    std::cout << "Deleting Source [" + sourceFile.toString() + "]" << std::endl;
+                    CFile::remove(sourceFile);
+                }
+            } else {
+                std::cerr << this->getName() << " Error: " << failed << " entries of [" << sourceFile.toString() << "] not extracted." << std::endl;
+            }
+
+        } catch (const std::exception & e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        }
+
+        return (bSuccess);
+
+    }
+
+} // namespace FPE_TaskActions
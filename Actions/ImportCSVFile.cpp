@@ -1,7 +1,15 @@
 //
 // Module: ImportCSVFile
 //
-// Description: Take passed in CSV and import it into a MongoDB.
+// Description: Take passed in CSV and import it into a database. The
+// server URL picks the sink: "sqlite:file" imports into a table of an
+// embedded SQLite database file (no server needed) and anything else is
+// a MongoDB server. The sink lives for as long as the task and the file
+// is imported by class CSVImport (in parallel ranges or streamed from a
+// gzip compressed file, batched, typed by any schema, checkpointed and
+// de-duplicated on key columns when asked).
+// With a spool directory any file that cannot be imported is spooled and
+// retried in the background.
 //
 // Dependencies:
 // 
@@ -33,24 +41,9 @@
 
 #include "FPE.hpp"
 #include "FPE_Actions.hpp"
-
-//
-// Boost tokenizer library
-//
-
-#include <boost/tokenizer.hpp>
-
-//
-// MongoDB C++ Driver
-// Note: C++ Driver not easy to install so add define
-//
-
-#if defined(MONGO_DRIVER_INSTALLED)
-#include <bsoncxx/builder/stream/document.hpp>
-#include <bsoncxx/json.hpp>
-#include <mongocxx/client.hpp>
-#include <mongocxx/instance.hpp>
-#endif // MONGO_DRIVER_INSTALLED
+#include "FPE_CSVImport.hpp"
+#include "FPE_SQLiteSink.hpp"
+#include "FPE_MongoSink.hpp"
 
 namespace FPE_TaskActions {
 
@@ -61,22 +54,41 @@ namespace FPE_TaskActions {
     using namespace FPE;
     using namespace Antik::File;
 
-    // ===============
-    // LOCAL VARIABLES
-    // ===============
-
     // ===============
     // LOCAL FUNCTIONS
     // ===============
 
-    std::vector<std::string> getCSVTokens(const std::string& csvLineStr) {
+    //
+    // Import CSV File into sink.
+    //
+
+    bool ImportCSVFile::importFile(const std::string &file) {
+
+        bool bSuccess = false;
 
-        boost::tokenizer< boost::escaped_list_separator<char> > csvTokenizer(csvLineStr);
-        std::vector<std::string> csvTokens;
+        try {
 
-        csvTokens.assign(csvTokenizer.begin(), csvTokenizer.end());
+            // Form source file path
 
-        return (csvTokens);
+            CPath sourceFile(file);
+
+            if (!this->m_csvImport) {
+                throw std::runtime_error(this->m_initError);
+            }
+
+            std::cout << "Importing CSV file [" << sourceFile.fileName() << "] To " << this->m_sink->name() << "." << std::endl;
+
+            std::uint64_t rows = this->m_csvImport->importFile(sourceFile.toString());
+
+            std::cout << "Imported " << rows << " rows from [" << sourceFile.fileName() << "]." << std::endl;
+
+            bSuccess = true;
+
+        } catch (const std::exception & e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        }
+
+        return (bSuccess);
 
     }
 
@@ -85,62 +97,54 @@ namespace FPE_TaskActions {
     // ================
 
     //
-    // Import CSV File to MongoDB
+    // Create sink and import once for all files imported. If either cannot
+    // be created (no MongoDB driver say) the error is kept and each file
+    // then fails to import with it.
     //
 
-    bool ImportCSVFile::process(const std::string &file) {
+    void ImportCSVFile::init(void) {
 
-        // ASSERT for any invalid options.
+        try {
+            if (SQLiteSink::isSQLiteURL(this->m_actionData[kServerOption])) {
+                this->m_sink.reset(new SQLiteSink(SQLiteSink::databaseFile(this->m_actionData[kServerOption]),
+                        this->m_actionData[kCollectionOption]));
+            } else {
+                this->m_sink.reset(new MongoSink(this->m_actionData[kServerOption], this->m_actionData[kDatabaseOption],
+                        this->m_actionData[kCollectionOption]));
+            }
+            this->m_csvImport.reset(new CSVImport(*this->m_sink, CSVImport::Settings::fromOptions(this->m_actionData)));
+        } catch (const std::exception & e) {
+            this->m_initError = e.what();
+        }
 
-        assert(file.length() != 0);
+        if (!this->m_actionData[kSpoolOption].empty()) {
+            this->m_spool.reset(new ActionSpool(this->m_actionData[kSpoolOption], this->m_actionData[kServerOption],
+                    [this] (const std::string & file) {
+                        return (this->importFile(file));
+                    }, ActionSpool::Settings::fromOptions(this->m_actionData)));
+        }
 
-        bool bSuccess = false;
+    }
 
-        // Form source file path
+    void ImportCSVFile::term(void) {
 
-#if defined(MONGO_DRIVER_INSTALLED)
+        this->m_spool.reset();
+        this->m_csvImport.reset();
+        this->m_sink.reset();
 
-        try {
+    }
 
-            CPath sourceFile(file);
+    bool ImportCSVFile::process(const std::string &file) {
 
-            std::ifstream csvFileStream(sourceFile.toString());
-            if (!csvFileStream.is_open()) {
-                std::cout << "Error opening file " << sourceFile.toString() << std::endl;
-                return (false);
-            }
+        // ASSERT for any invalid options.
 
-            std::cout << "Importing CSV file [" << sourceFile.fileName() << "] To MongoDB." << std::endl;
-
-            mongocxx::instance driverInstance{};
-            mongocxx::client mongoConnection{mongocxx::uri{this->m_actionData[kServerOption]}};
-            auto csvCollection = mongoConnection[this->m_actionData[kDatabaseOption]][this->m_actionData[kCollectionOption]];
-            std::vector<std::string> fieldNames;
-            std::string csvLine;
-
-            getline(csvFileStream, csvLine);
-            if (csvLine.back() == '\r')csvLine.pop_back();
-
-            fieldNames = getCSVTokens(csvLine);
-
-            while (getline(csvFileStream, csvLine)) {
-                std::vector<std::string > fieldValues;
-                bsoncxx::builder::stream::document document{};
-                if (csvLine.back() == '\r')csvLine.pop_back();
-                fieldValues = getCSVTokens(csvLine);
-                int i = 0;
-                for (auto& field : fieldValues) {
-                    document << fieldNames[i++] << field;
-                }
-                csvCollection.insert_one(document.view());
-            }
+        assert(file.length() != 0);
 
-        } catch (const std::exception & e) {
-            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        if (this->m_spool) {
+            return (this->m_spool->submit(file));
         }
-#endif // MONGO_DRIVER_INSTALLED
 
-        return (bSuccess);
+        return (this->importFile(file));
 
     }
 
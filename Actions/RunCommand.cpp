@@ -19,6 +19,7 @@
 //
 
 #include <iostream>
+#include <sstream>
 
 //
 // Antik Classes
@@ -34,17 +35,6 @@
 #include "FPE.hpp"
 #include "FPE_Actions.hpp"
 
-// Process wait
-//
-
-#include <sys/wait.h>
-
-//
-// Boost format library
-//
-
-#include <boost/format.hpp>
-
 namespace FPE_TaskActions {
 
     // =======
@@ -58,104 +48,161 @@ namespace FPE_TaskActions {
     // LOCAL VARIABLES
     // ===============
 
+    //
+    // Batched command defaults
+    //
+
+    constexpr std::size_t kDefaultBatchSize { 1000 };
+    constexpr int kDefaultBatchWait { 5 }; // seconds
+
+    //
+    // Per file status lines a batched command may write to stdout
+    //
+
+    const std::string kBatchFileOK { "OK " };
+    const std::string kBatchFileFailed { "FAILED " };
+
     // ===============
     // LOCAL FUNCTIONS
     // ===============
 
     //
-    // Fork and execute Shell command
+    // Get a batch limit option value or its default if not set.
     //
 
-    static int forkCommand(char *const argv[]) {
+    static std::size_t batchOption(const std::string &value, std::size_t defaultValue) {
 
-        pid_t pid; // Process id
-        int status; // wait status
-        int exitStatus = 0; // child exit status
+        int option = (!value.empty()) ? std::stoi(value) : 0;
 
-        if ((pid = fork()) < 0) { /* fork a child process           */
+        return ((option > 0) ? option : defaultValue);
 
-            throw std::system_error(std::error_code(errno, std::system_category()), "Error: forking child process failed:");
+    }
 
-        } else if (pid == 0) { /* for the child process: */
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
 
-            FILE *ignore;
-            (void)ignore;
-            
-            // Redirect stdout/stderr
+    //
+    // Parse command. If it contains %files% then files are collected and passed
+    // to the command in batches limited by count, argv length and wait time.
+    // Files a batch fails on are spooled and retried on their own (where they
+    // were, not the spooled copy) when there is a spool, otherwise they are
+    // counted and the count reported at term.
+    //
 
-            ignore = freopen("/dev/null", "w", stdout);
-            ignore = freopen("/dev/null", "w", stderr);
+    void RunCommand::init(void) {
 
-            if (execvp(*argv, argv) < 0) { /* execute the command  */
-                exit(1);
-            }
+        this->m_command.reset(new ShellCommand(this->m_actionData[kCommandOption]));
+        this->m_command->setLimits(ShellCommand::Limits::fromOptions(this->m_actionData));
 
-        } else { // for the parent:
+        if (this->m_command->hasFiles()) {
 
-            while (wait(&status) != pid) { /* wait for completion  */
-            }
+            std::size_t batchSize = batchOption(this->m_actionData[kBatchSizeOption], kDefaultBatchSize);
+            std::size_t batchWait = batchOption(this->m_actionData[kBatchWaitOption], kDefaultBatchWait);
+            std::size_t batchBytes = this->m_command->argumentSpace();
 
-            if (WIFEXITED(status)) { // Set any exit status
-                exitStatus = WEXITSTATUS(status);
+            if (!this->m_actionData[kSpoolOption].empty()) {
+                ActionSpool::Settings settings { ActionSpool::Settings::fromOptions(this->m_actionData) };
+                settings.bDeliverOriginal = true;
+                this->m_spool.reset(new ActionSpool(this->m_actionData[kSpoolOption], this->m_actionData[kCommandOption],
+                        [this] (const std::string & file) {
+                            std::vector<std::string> files { file };
+                            return (this->runBatch(files).empty());
+                        }, settings));
             }
 
-        }
+            this->m_batch.reset(new ActionBatch(batchSize, batchBytes, std::chrono::seconds(batchWait),
+                    [this] (std::vector<std::string> &files) {
+                        std::vector<std::string> failedFiles { this->runBatch(files) };
+                        if (!failedFiles.empty()) {
+                            if (!this->m_spool || !this->m_spool->spoolFailed(failedFiles)) {
+                                this->m_failedFiles += failedFiles.size();
+                            }
+                        }
+                    }));
 
-        return (exitStatus);
+        }
 
     }
 
     //
-    // Run shell command. Split command into argv components before passing onto exec.
-    // All heap memory cleaned up when function returns due to unique_pointers.
+    // Run command on any files still waiting in a batch and report any
+    // batched files that failed.
     //
 
-    static int runShellCommand(const std::string& shellCommand) {
+    void RunCommand::term(void) {
 
-        int exitStatus = 0;
-        int argc = 0;
+        this->m_batch.reset();
+        this->m_spool.reset();
+        this->m_command.reset();
 
-        std::vector<char *> argvs;
-        std::unique_ptr<char*> argv;
-        std::unique_ptr<char> command{ new char[shellCommand.length() + 1]};
+        if (this->m_failedFiles) {
+            std::cerr << this->getName() << " Error: Command failed on " << this->m_failedFiles << " batched files." << std::endl;
+            this->m_failedFiles = 0;
+        }
 
-        // Take a 'C' string copy
+    }
 
-        shellCommand.copy(command.get(), shellCommand.length());
-        command.get()[shellCommand.length()] = 0; // null terminate
+    //
+    // Run command on a batch of files (%files% replaced by the file list). A
+    // command may report on individual files by writing "OK <file>" or
+    // "FAILED <file>" lines to stdout; any file not reported on takes the
+    // command exit status. The files that failed are returned.
+    //
 
-        // Loop through command splitting into substrings for argv
+    std::vector<std::string> RunCommand::runBatch(std::vector<std::string> &files) {
 
-        char *p2 = strtok(command.get(), " ");
+        std::unordered_map<std::string, bool> reported;
+        std::vector<std::string> failedFiles;
+        std::string output;
 
-        while (p2) {
-            argvs.push_back(p2);
-            p2 = strtok(0, " ");
-        }
+        std::cout << "Running command on batch of " << files.size() << " files." << std::endl;
 
-        // Allocate argv array and copy vector over
+        int result = -1;
 
-        argv.reset(new char*[argvs.size() + 1]);
+        try {
+            std::lock_guard<std::mutex> locker(this->m_runMutex);
+            result = this->m_command->run(files, output);
+        } catch (const std::exception & e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        }
 
-        for (char *arg : argvs) {
-            argv.get()[argc++] = arg;
+        std::istringstream outputStream { output };
+        std::string line;
+
+        while (std::getline(outputStream, line)) {
+            if (line.compare(0, kBatchFileOK.length(), kBatchFileOK) == 0) {
+                reported[line.substr(kBatchFileOK.length())] = true;
+            } else if (line.compare(0, kBatchFileFailed.length(), kBatchFileFailed) == 0) {
+                reported[line.substr(kBatchFileFailed.length())] = false;
+            }
         }
 
-        argv.get()[argc] = 0; // Last element null
+        for (auto &file : files) {
+
+            auto fileReport = reported.find(file);
+            bool bSuccess = (fileReport != reported.end()) ? fileReport->second : (result == 0);
 
-        // Fork command
+            if (bSuccess) {
+                std::cout << "Command success [" << file << "]" << std::endl;
+                if (!this->m_actionData[kDeleteOption].empty()) {
+                    std::cout << "Deleting Source [" << file << "]" << std::endl;
+                    CFile::remove(file);
+                }
+            } else {
+                std::cout << "Command failed [" << file << "]" << std::endl;
+                failedFiles.push_back(file);
+            }
 
-        exitStatus = forkCommand(argv.get());
+        }
 
-        return (exitStatus);
+        return (failedFiles);
 
     }
-    // ================
-    // PUBLIC FUNCTIONS
-    // ================
 
     //
-    // Run a specified command on the file (%1% source, %2% destination)
+    // Run a specified command on the file (%1% source, %2% destination) or
+    // add it to the current batch for a %files% command.
     //
 
     bool RunCommand::process(const std::string &file) {
@@ -166,6 +213,13 @@ namespace FPE_TaskActions {
 
         bool bSuccess = false;
 
+        // Batched command so queue file
+
+        if (this->m_batch) {
+            this->m_batch->add(file, file.length() + 1 + sizeof (char *));
+            return (true);
+        }
+
         try {
 
             // Form source and destination file paths
@@ -173,22 +227,14 @@ namespace FPE_TaskActions {
             CPath sourceFile(file);
             CPath destinationFile(this->m_actionData[kDestinationOption] + sourceFile.fileName());
 
-            // Create correct command for whether source and destination specified or just source or none
-
-            bool srcFound = (this->m_actionData[kCommandOption].find("%1%") != std::string::npos);
-            bool dstFound = (this->m_actionData[kCommandOption].find("%2%") != std::string::npos);
-
-            std::string command;
-            if (srcFound && dstFound) {
-                command = (boost::format(this->m_actionData[kCommandOption]) % sourceFile.toString() % destinationFile.toString()).str();
-            } else if (srcFound) {
-                command = (boost::format(this->m_actionData[kCommandOption]) % sourceFile.toString()).str();
-            } else {
-                command = this->m_actionData[kCommandOption];
-            }
+            // Run command substituting source and destination
 
             auto result = 0;
-            if ((result = runShellCommand(command)) == 0) {
+            {
+                std::lock_guard<std::mutex> locker(this->m_runMutex);
+                result = this->m_command->run(sourceFile.toString(), destinationFile.toString());
+            }
+            if (result == 0) {
                 bSuccess = true;
                 std::cout << "Command success." << std::endl;
                 if (!this->m_actionData[kDeleteOption].empty()) {
@@ -35,18 +35,6 @@
 #include "FPE.hpp"
 #include "FPE_Actions.hpp"
 
-//
-// Process wait
-//
-
-#include <sys/wait.h>
-
-//
-// Boost format library
-//
-
-#include <boost/format.hpp>
-
 namespace FPE_TaskActions {
 
     // =======
@@ -60,101 +48,40 @@ namespace FPE_TaskActions {
     // LOCAL VARIABLES
     // ===============
 
-    // ===============
-    // LOCAL FUNCTIONS
-    // ===============
-
     //
-    // Fork and execute Shell command
+    // Built-in conversion command
     //
 
-    static int forkCommand(char *const argv[]) {
-
-        pid_t pid; // Process id
-        int status; // wait status
-        int exitStatus = 0; // child exit status
-
-        if ((pid = fork()) < 0) { /* fork a child process           */
-
-            throw std::system_error(std::error_code(errno, std::system_category()), "Error: forking child process failed:");
-
-        } else if (pid == 0) { /* for the child process: */
-
-            FILE *ignore;
-            (void)ignore;
-            
-            // Redirect stdout/stderr
-
-            ignore = freopen("/dev/null", "w", stdout);
-            ignore = freopen("/dev/null", "w", stderr);
-
-            if (execvp(*argv, argv) < 0) { /* execute the command  */
-                exit(1);
-            }
-
-        } else { // for the parent:
-
-            while (wait(&status) != pid) { /* wait for completion  */
-            }
-
-            if (WIFEXITED(status)) { // Set any exit status
-                exitStatus = WEXITSTATUS(status);
-            }
+    constexpr char const *kHandBrakeCommand { "/usr/local/bin/HandBrakeCLI -i %1% -o %2% --preset=\"Normal\"" };
 
-        }
-
-        return (exitStatus);
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
 
-    }
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
 
     //
-    // Run shell command. Split command into argv components before passing onto exec.
-    // All heap memory cleaned up when function returns due to unique_pointers.
+    // Parse conversion command (the built-in command unless one is given).
     //
 
-    static int runShellCommand(const std::string& shellCommand) {
-
-        int exitStatus = 0;
-        int argc = 0;
-
-        std::vector<char *> argvs;
-        std::unique_ptr<char*> argv;
-        std::unique_ptr<char> command{ new char[shellCommand.length() + 1]};
-
-        // Take a 'C' string copy
+    void VideoConversion::init(void) {
 
-        shellCommand.copy(command.get(), shellCommand.length());
-        command.get()[shellCommand.length()] = 0; // null terminate
-
-        // Loop through command splitting into substrings for argv
-
-        char *p2 = strtok(command.get(), " ");
-
-        while (p2) {
-            argvs.push_back(p2);
-            p2 = strtok(0, " ");
-        }
-
-        // Allocate argv array and copy vector over
-
-        argv.reset(new char*[argvs.size() + 1]);
-
-        for (char *arg : argvs) {
-            argv.get()[argc++] = arg;
+        if (this->m_actionData[kCommandOption].empty()) {
+            this->m_actionData[kCommandOption] = kHandBrakeCommand;
         }
 
-        argv.get()[argc] = 0; // Last element null
+        this->m_command.reset(new ShellCommand(this->m_actionData[kCommandOption]));
+        this->m_command->setLimits(ShellCommand::Limits::fromOptions(this->m_actionData));
 
-        // Fork command
+    }
 
-        exitStatus = forkCommand(argv.get());
+    void VideoConversion::term(void) {
 
-        return (exitStatus);
+        this->m_command.reset();
 
     }
-    // ================
-    // PUBLIC FUNCTIONS
-    // ================
 
     //
     // Video file conversion action function. Convert passed in file to MP4 using Handbrake.
@@ -185,12 +112,10 @@ namespace FPE_TaskActions {
 
             // Convert file
 
-            std::string command = (boost::format(this->m_actionData[kCommandOption]) % sourceFile.toString() % destinationFile.toString()).str();
-
             std::cout << "Converting file [" << sourceFile.toString() << "] To [" << destinationFile.toString() << "]" << std::endl;
 
             auto result = 0;
-            if ((result = runShellCommand(command)) == 0) {
+            if ((result = this->m_command->run(sourceFile.toString(), destinationFile.toString())) == 0) {
                 bSuccess = true;
                 std::cout << "File conversion success." << std::endl;
                 if (!this->m_actionData[kDeleteOption].empty()) {
@@ -1,12 +1,20 @@
 //
 // Module: ZipFile
 //
-// Description: Take passed in file and add it to a ZIP archive.
+// Description: Take passed in file and add it to a ZIP archive. The archive
+// is opened once when the task starts and closed when it stops; its central
+// directory is written every kFlushEntries files, after kIdleFlush seconds
+// with no new files and on close. Large files are deflated in parallel
+// chunks by --threads worker threads (default one per CPU). The archive
+// name may be a pattern, in which case a new archive is started on the
+// entry/size/age limits given; with --shards several archives are written
+// at once by their own threads. Files already in the archive can be skipped
+// or added under a version name (--duplicates skip/version).
 // 
 // Dependencies:
 // 
 // C11++              : Use of C11++ features.
-// Antik Classes      : CZIP, CFile, CPath.
+// Antik Classes      : CPath.
 // Linux              : Target platform.
 //
 
@@ -19,13 +27,12 @@
 //
 
 #include <iostream>
+#include <thread>
 
 //
 // Antik Classes
 //
 
-#include "CZIP.hpp"
-#include "CFile.hpp"
 #include "CPath.hpp"
 
 //
@@ -48,13 +55,19 @@ namespace FPE_TaskActions {
     // =======
 
     using namespace FPE;
-    using namespace Antik::ZIP;
     using namespace Antik::File;
 
     // ===============
     // LOCAL VARIABLES
     // ===============
 
+    //
+    // Central directory flush interval
+    //
+
+    constexpr std::size_t kFlushEntries { 1000 }; // Entries added
+    constexpr int kIdleFlush { 5 }; // Seconds idle
+
     // ===============
     // LOCAL FUNCTIONS
     // ===============
@@ -63,6 +76,78 @@ namespace FPE_TaskActions {
     // PUBLIC FUNCTIONS
     // ================
 
+    //
+    // Open ZIP archive series or shards (creating archives and their paths
+    // if needed).
+    //
+
+    void ZIPFile::init(void) {
+
+        ZIPRollover::Limits limits;
+        std::size_t threads = std::thread::hardware_concurrency();
+        std::size_t shards = 1;
+        ZIPArchive::Duplicates duplicates = ZIPArchive::Duplicates::add;
+
+        if (!this->m_actionData[kThreadsOption].empty()) {
+            threads = std::stoi(this->m_actionData[kThreadsOption]);
+        }
+        if (!this->m_actionData[kShardsOption].empty()) {
+            shards = std::stoi(this->m_actionData[kShardsOption]);
+        }
+        if (!this->m_actionData[kArchiveEntriesOption].empty()) {
+            limits.maxEntries = std::stoi(this->m_actionData[kArchiveEntriesOption]);
+        }
+        if (!this->m_actionData[kArchiveSizeOption].empty()) {
+            limits.maxBytes = static_cast<std::uint64_t> (std::stoi(this->m_actionData[kArchiveSizeOption])) * 1024 * 1024;
+        }
+        if (!this->m_actionData[kArchiveAgeOption].empty()) {
+            limits.maxAge = std::chrono::seconds(std::stoi(this->m_actionData[kArchiveAgeOption]));
+        }
+
+        if (this->m_actionData[kDuplicatesOption] == "skip") {
+            duplicates = ZIPArchive::Duplicates::skip;
+        } else if (this->m_actionData[kDuplicatesOption] == "version") {
+            duplicates = ZIPArchive::Duplicates::version;
+        } else if (!this->m_actionData[kDuplicatesOption].empty()) {
+            std::cerr << this->getName() << " Error: Invalid duplicates value [" << this->m_actionData[kDuplicatesOption]
+                    << "]; files will always be added." << std::endl;
+        }
+
+        if (shards > 1) {
+            this->m_shards.reset(new ZIPShards(this->m_actionData[kArchiveOption], limits, shards, threads,
+                    kFlushEntries, std::chrono::seconds(kIdleFlush), duplicates));
+        } else {
+            this->m_archive.reset(new ZIPRollover(this->m_actionData[kArchiveOption], limits));
+            this->m_archive->setThreads(threads);
+            this->m_archive->setDuplicates(duplicates);
+            this->m_archive->setFlushInterval(kFlushEntries, std::chrono::seconds(kIdleFlush));
+            this->m_archive->open();
+        }
+
+    }
+
+    void ZIPFile::term(void) {
+
+        try {
+            if (this->m_shards) {
+                this->m_shards->close();
+                if (this->m_shards->failed()) {
+                    std::cerr << this->getName() << " Error: " << this->m_shards->failed()
+                            << " queued files could not be added to archive." << std::endl;
+                }
+            }
+            if (this->m_archive) {
+                this->m_archive->close();
+            }
+        } catch (const std::exception & e) {
+            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
+        }
+
+        this->m_shards.reset();
+        this->m_archive.reset();
+
+    }
+
     //
     // Add file to ZIP archive.
     //
@@ -77,40 +162,22 @@ namespace FPE_TaskActions {
 
         try {
 
-            // Form source and zips file paths
-
             CPath sourceFile(file);
-            CPath zipFilePath(this->m_actionData[kArchiveOption]);
 
-            // Create path for ZIP archive if needed.
+            // Append file to archive (or queue it for a shard)
 
-            if (!CFile::exists(zipFilePath.parentPath())) {
-                if (CFile::createDirectory(zipFilePath.parentPath())) {
-                    std::cout << "Created : " << zipFilePath.parentPath().toString() << std::endl;
+            if (this->m_shards) {
+                this->m_shards->add(sourceFile.toString(), sourceFile.fileName());
+            } else {
+                std::string entryName { this->m_archive->add(sourceFile.toString(), sourceFile.fileName()) };
+                if (!entryName.empty()) {
+                    std::cout << "Appended [" << entryName << "] to archive [" << this->m_archive->currentArchive() << "]" << std::endl;
                 } else {
-                    std::cerr << "Created failed for :" << zipFilePath.parentPath().toString() << std::endl;
+                    std::cout << "Skipped [" << sourceFile.fileName() << "] already in archive [" << this->m_archive->currentArchive() << "]" << std::endl;
                 }
             }
 
-            // Create archive if doesn't exist
-
-            CZIP zipFile(zipFilePath.toString());
-
-            if (!CFile::exists(zipFilePath)) {
-                std::cout << "Creating archive " << zipFilePath.toString() << std::endl;
-                zipFile.create();
-            }
-
-            // Append file to archive
-
-            zipFile.open();
-
-            bSuccess = zipFile.add(sourceFile.toString(), sourceFile.fileName());
-            if (bSuccess) {
-                std::cout << "Appended [" << sourceFile.fileName() << "] to archive [" << zipFilePath.toString() << "]" << std::endl;
-            }
-
-            zipFile.close();
+            bSuccess = true;
 
         } catch (const std::exception & e) {
            std::cerr << this->getName() << " Error: " << e.what() << std::endl;
@@ -120,5 +187,4 @@ namespace FPE_TaskActions {
 
     }
 
-} // namespace FPE_TaskActions
-
+} // namespace FPE_TaskActions
\ No newline at end of file
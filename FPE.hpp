@@ -28,6 +28,33 @@ namespace FPE {
     constexpr char const *kDatabaseOption{"database"};
     constexpr char const *kCollectionOption{"collection"};
     constexpr char const *kListOption{"list"};
+    constexpr char const *kBatchSizeOption{"batchsize"};
+    constexpr char const *kBatchWaitOption{"batchwait"};
+    constexpr char const *kDigestSizeOption{"digestsize"};
+    constexpr char const *kCompressOption{"compress"};
+    constexpr char const *kTimeoutOption{"timeout"};
+    constexpr char const *kKillGraceOption{"killgrace"};
+    constexpr char const *kCPULimitOption{"cpulimit"};
+    constexpr char const *kMemoryLimitOption{"memlimit"};
+    constexpr char const *kFileLimitOption{"filelimit"};
+    constexpr char const *kNiceOption{"nice"};
+    constexpr char const *kSpoolOption{"spool"};
+    constexpr char const *kRetriesOption{"retries"};
+    constexpr char const *kRetryDelayOption{"retrydelay"};
+    constexpr char const *kThreadsOption{"threads"};
+    constexpr char const *kArchiveEntriesOption{"archiveentries"};
+    constexpr char const *kArchiveSizeOption{"archivesize"};
+    constexpr char const *kArchiveAgeOption{"archiveage"};
+    constexpr char const *kShardsOption{"shards"};
+    constexpr char const *kDuplicatesOption{"duplicates"};
+    constexpr char const *kInsertBatchOption{"insertbatch"};
+    constexpr char const *kInsertSizeOption{"insertsize"};
+    constexpr char const *kSchemaOption{"schema"};
+    constexpr char const *kCheckpointOption{"checkpoint"};
+    constexpr char const *kKeyColumnsOption{"keycolumns"};
+    constexpr char const *kDedupOption{"dedup"};
+    constexpr char const *kColumnsOption{"columns"};
+    constexpr char const *kFilterOption{"filter"};
 
     //
     // File Processing Engine.
@@ -0,0 +1,191 @@
+//
+// Module: FPE_ActionBatch
+//
+// Description: Collect files passed to a task action into batches that are
+// handed on when a count or byte limit is reached or when the oldest file
+// in the batch has waited for the maximum wait time.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+
+//
+// Program components.
+//
+
+#include "FPE_ActionBatch.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Remove and return files currently waiting (batch mutex held by caller).
+    //
+
+    std::vector<std::string> ActionBatch::takeBatch(void) {
+
+        std::vector<std::string> batch;
+
+        batch.swap(this->m_files);
+        this->m_bytes = 0;
+
+        return (batch);
+
+    }
+
+    //
+    // Pass batch onto handler. Only one batch is handled at a time and any
+    // exception is reported here as it may be running on the timer thread.
+    //
+
+    void ActionBatch::runFlush(std::vector<std::string> &batch) {
+
+        if (batch.empty()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> locker(this->m_flushMutex);
+
+        try {
+            this->m_flushFn(batch);
+        } catch (const std::exception &e) {
+            std::cerr << "Batch Error: " << e.what() << std::endl;
+        }
+
+    }
+
+    //
+    // Timer thread. Flush batch when the oldest file has waited long enough.
+    //
+
+    void ActionBatch::timer(void) {
+
+        std::unique_lock<std::mutex> locker(this->m_batchMutex);
+
+        while (!this->m_stop) {
+
+            if (this->m_files.empty()) {
+                this->m_timerWakeup.wait(locker);
+                continue;
+            }
+
+            auto deadline = this->m_oldest + this->m_maxWait;
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::vector<std::string> batch { this->takeBatch() };
+                locker.unlock();
+                this->runFlush(batch);
+                locker.lock();
+            } else {
+                this->m_timerWakeup.wait_until(locker, deadline);
+            }
+
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    ActionBatch::ActionBatch(std::size_t maxCount, std::size_t maxBytes,
+                             std::chrono::milliseconds maxWait, FlushFn flushFn) :
+        m_maxCount{ (maxCount) ? maxCount : 1}, m_maxBytes{maxBytes}, m_maxWait{maxWait}, m_flushFn{flushFn} {
+
+        this->m_timerThread = std::thread(&ActionBatch::timer, this);
+
+    }
+
+    //
+    // Stop timer thread and pass on anything still waiting.
+    //
+
+    ActionBatch::~ActionBatch() {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_batchMutex);
+            this->m_stop = true;
+        }
+
+        this->m_timerWakeup.notify_one();
+        this->m_timerThread.join();
+
+        this->flush();
+
+    }
+
+    //
+    // Add file to batch. If it would take the batch over its byte limit then
+    // the current batch is handed on first; the batch is then handed on if it
+    // is now full.
+    //
+
+    void ActionBatch::add(const std::string &file, std::size_t bytes) {
+
+        std::vector<std::string> overflowBatch;
+        std::vector<std::string> fullBatch;
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_batchMutex);
+
+            if (!this->m_files.empty() && (this->m_bytes + bytes > this->m_maxBytes)) {
+                overflowBatch = this->takeBatch();
+            }
+
+            if (this->m_files.empty()) {
+                this->m_oldest = std::chrono::steady_clock::now();
+            }
+
+            this->m_files.push_back(file);
+            this->m_bytes += bytes;
+
+            if ((this->m_files.size() >= this->m_maxCount) || (this->m_bytes >= this->m_maxBytes)) {
+                fullBatch = this->takeBatch();
+            }
+
+        }
+
+        this->m_timerWakeup.notify_one();
+
+        this->runFlush(overflowBatch);
+        this->runFlush(fullBatch);
+
+    }
+
+    //
+    // Hand on any files waiting.
+    //
+
+    void ActionBatch::flush(void) {
+
+        std::vector<std::string> batch;
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_batchMutex);
+            batch = this->takeBatch();
+        }
+
+        this->runFlush(batch);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,74 @@
+#ifndef FPE_ACTIONBATCH_HPP
+#define FPE_ACTIONBATCH_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ActionBatch class. Collects files passed to an action and hands them
+    // on as a single batch once a count or byte limit is reached or the
+    // oldest file has waited for longer than the maximum wait time.
+    //
+
+    class ActionBatch {
+    public:
+
+        using FlushFn = std::function<void(std::vector<std::string>&)>;
+
+        ActionBatch(std::size_t maxCount, std::size_t maxBytes,
+                    std::chrono::milliseconds maxWait, FlushFn flushFn);
+
+        ~ActionBatch();
+
+        // Add file (bytes is its cost against the batch byte limit)
+
+        void add(const std::string &file, std::size_t bytes);
+
+        // Pass on any files currently waiting.
+
+        void flush(void);
+
+    private:
+
+        ActionBatch(const ActionBatch&) = delete;
+        ActionBatch& operator=(const ActionBatch&) = delete;
+
+        std::vector<std::string> takeBatch(void);
+        void runFlush(std::vector<std::string> &batch);
+        void timer(void);
+
+        std::size_t m_maxCount; // Maximum files per batch
+        std::size_t m_maxBytes; // Maximum bytes per batch
+        std::chrono::milliseconds m_maxWait; // Maximum time a file waits
+        FlushFn m_flushFn; // Batch handler
+
+        std::vector<std::string> m_files; // Files waiting
+        std::size_t m_bytes { 0 }; // Bytes waiting
+        std::chrono::steady_clock::time_point m_oldest; // Time first file added
+
+        bool m_stop { false }; // Stop timer thread
+        std::mutex m_batchMutex; // Protects batch state
+        std::mutex m_flushMutex; // Serialises batch handler calls
+        std::condition_variable m_timerWakeup; // Timer thread wakeup
+        std::thread m_timerThread; // Maximum wait timer thread
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_ACTIONBATCH_HPP */
+
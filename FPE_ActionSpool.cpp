@@ -0,0 +1,481 @@
+//
+// Module: FPE_ActionSpool
+//
+// Description: Durable on-disk spool of files waiting to be delivered to a
+// server by a task action. Each item is a directory holding a copy of the
+// file and its retry state; it is renamed into place only once complete
+// so a crash never leaves a half written item. A background thread retries
+// items with exponential backoff and jitter behind a per server circuit
+// breaker.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+
+//
+// Program components.
+//
+
+#include "FPE.hpp"
+#include "FPE_ActionSpool.hpp"
+
+namespace FPE_TaskActions {
+
+    // =======
+    // IMPORTS
+    // =======
+
+    namespace fs = std::filesystem;
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr char const *kStateFile { "state" }; // Item retry state
+    constexpr char const *kFailedDirectory { "failed" }; // Items out of attempts
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Spool sub-directory name for a server URL (any credentials dropped).
+    //
+
+    static std::string serverDirectory(const std::string &serverURL) {
+
+        std::string server { serverURL };
+        std::size_t scheme = server.find("://");
+        std::size_t credentials = server.find('@', (scheme != std::string::npos) ? scheme : 0);
+
+        if (credentials != std::string::npos) {
+            server.erase((scheme != std::string::npos) ? scheme + 3 : 0,
+                         credentials + 1 - ((scheme != std::string::npos) ? scheme + 3 : 0));
+        }
+
+        std::replace_if(server.begin(), server.end(), [] (char ch) {
+            return (!std::isalnum(static_cast<unsigned char> (ch)) && (ch != '.') && (ch != '-'));
+        }, '_');
+
+        return ((server.empty()) ? "default" : server);
+
+    }
+
+    //
+    // Time in seconds since epoch and back (retry times survive a restart).
+    //
+
+    static long long toEpoch(std::chrono::system_clock::time_point timePoint) {
+        return (std::chrono::duration_cast<std::chrono::seconds>(timePoint.time_since_epoch()).count());
+    }
+
+    static std::chrono::system_clock::time_point fromEpoch(long long seconds) {
+        return (std::chrono::system_clock::time_point(std::chrono::seconds(seconds)));
+    }
+
+    //
+    // Load items left in spool. Hidden directories are items that were never
+    // completed and are removed.
+    //
+
+    void ActionSpool::loadItems(void) {
+
+        for (auto &entry : fs::directory_iterator(this->m_directory)) {
+
+            std::string name { entry.path().filename().string() };
+
+            if (!entry.is_directory() || (name == kFailedDirectory)) {
+                continue;
+            }
+
+            if (name[0] == '.') {
+                fs::remove_all(entry.path());
+                continue;
+            }
+
+            std::ifstream stateStream(entry.path() / kStateFile);
+            std::string fileName;
+            long long nextAttempt = 0;
+            Item item;
+
+            if (std::getline(stateStream, fileName) && (stateStream >> item.attempts >> nextAttempt)) {
+                std::getline(stateStream >> std::ws, item.original);
+                item.directory = entry.path().string();
+                item.file = (entry.path() / fileName).string();
+                item.nextAttempt = fromEpoch(nextAttempt);
+                this->m_items.push_back(item);
+            } else {
+                std::cerr << "Spool Error: Invalid spool item [" << entry.path().string() << "]" << std::endl;
+            }
+
+        }
+
+        std::sort(this->m_items.begin(), this->m_items.end(), [] (const Item &a, const Item &b) {
+            return (a.directory < b.directory);
+        });
+
+        if (!this->m_items.empty()) {
+            std::cout << "Spool [" << this->m_directory << "] has " << this->m_items.size() << " item(s) waiting." << std::endl;
+        }
+
+    }
+
+    //
+    // Write item retry state (to a temporary file that is then renamed over it).
+    //
+
+    void ActionSpool::writeState(const Item &item) {
+
+        fs::path statePath { fs::path(item.directory) / kStateFile };
+        fs::path tempPath { statePath.string() + ".tmp" };
+
+        {
+            std::ofstream stateStream(tempPath, std::ios::trunc);
+            stateStream << fs::path(item.file).filename().string() << "\n"
+                    << item.attempts << " " << toEpoch(item.nextAttempt) << "\n"
+                    << item.original << "\n";
+            if (!stateStream) {
+                throw Exception("Could not write [" + tempPath.string() + "]");
+            }
+        }
+
+        fs::rename(tempPath, statePath);
+
+    }
+
+    //
+    // Delay before next attempt: doubles each attempt up to the maximum then
+    // a random amount of up to half is taken off so retries spread out.
+    //
+
+    std::chrono::seconds ActionSpool::retryDelay(int attempts) {
+
+        long long delay = this->m_settings.retryDelay.count();
+        long long maxDelay = this->m_settings.maxRetryDelay.count();
+
+        for (int attempt = 1; (attempt < attempts) && (delay < maxDelay); attempt++) {
+            delay *= 2;
+        }
+
+        delay = std::min(delay, maxDelay);
+
+        std::uniform_int_distribution<long long> jitter(delay / 2, delay);
+
+        return (std::chrono::seconds(jitter(this->m_jitter)));
+
+    }
+
+    //
+    // Copy file into spool. A hard link is used where possible; the item is
+    // written to a hidden directory and renamed into place when complete.
+    //
+
+    bool ActionSpool::spoolFile(const std::string &file, int attempts) {
+
+        try {
+
+            fs::path source { file };
+            std::string name;
+            Item item;
+
+            {
+                std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+                std::string sequence { std::to_string(this->m_nextItem++) };
+                std::string timeStamp { std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>
+                        (std::chrono::system_clock::now().time_since_epoch()).count()) };
+                name = std::string(16 - std::min<std::size_t>(16, timeStamp.length()), '0') + timeStamp + "-" +
+                        std::string(8 - std::min<std::size_t>(8, sequence.length()), '0') + sequence;
+                item.attempts = attempts;
+                item.nextAttempt = std::chrono::system_clock::now();
+                if (attempts) {
+                    item.nextAttempt += this->retryDelay(attempts);
+                }
+            }
+
+            fs::path tempDirectory { fs::path(this->m_directory) / ("." + name) };
+            fs::path itemDirectory { fs::path(this->m_directory) / name };
+
+            fs::create_directory(tempDirectory);
+
+            std::error_code linkError;
+            fs::create_hard_link(source, tempDirectory / source.filename(), linkError);
+            if (linkError) {
+                fs::copy_file(source, tempDirectory / source.filename());
+            }
+
+            item.directory = tempDirectory.string();
+            item.file = (tempDirectory / source.filename()).string();
+            item.original = fs::absolute(source).string();
+            this->writeState(item);
+
+            fs::rename(tempDirectory, itemDirectory);
+
+            item.directory = itemDirectory.string();
+            item.file = (itemDirectory / source.filename()).string();
+
+            {
+                std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+                this->m_items.push_back(item);
+            }
+
+            this->m_drainWakeup.notify_one();
+
+            std::cout << "Spooled file [" << file << "] for retry." << std::endl;
+
+            return (true);
+
+        } catch (const std::exception &e) {
+            std::cerr << "Spool Error: " << e.what() << std::endl;
+        }
+
+        return (false);
+
+    }
+
+    //
+    // Update circuit breaker with the result of a delivery. A success closes it
+    // and makes every waiting item due now the server is back; enough failures
+    // in a row open it (a failed probe keeps it open for another cooldown).
+    //
+
+    void ActionSpool::recordResult(bool bDelivered) {
+
+        std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+
+        if (bDelivered) {
+            if (this->m_bBreakerOpen) {
+                std::cout << "Spool [" << this->m_directory << "] server available again." << std::endl;
+            }
+            this->m_failures = 0;
+            this->m_bBreakerOpen = false;
+            for (auto &item : this->m_items) {
+                item.nextAttempt = std::min(item.nextAttempt, std::chrono::system_clock::now());
+            }
+        } else if (this->m_bBreakerOpen || (++this->m_failures >= this->m_settings.breakerThreshold)) {
+            if (!this->m_bBreakerOpen) {
+                std::cerr << "Spool [" << this->m_directory << "] server unavailable; spooling files." << std::endl;
+            }
+            this->m_bBreakerOpen = true;
+            this->m_breakerOpened = std::chrono::steady_clock::now();
+        }
+
+        this->m_drainWakeup.notify_one();
+
+    }
+
+    //
+    // Drain thread. Deliver items in the order spooled as they become due. While
+    // the circuit breaker is open only one item is tried (a probe) each time the
+    // cooldown passes.
+    //
+
+    void ActionSpool::drain(void) {
+
+        std::unique_lock<std::mutex> locker(this->m_spoolMutex);
+
+        while (!this->m_stop) {
+
+            if (this->m_items.empty()) {
+                this->m_drainWakeup.wait(locker);
+                continue;
+            }
+
+            if (this->m_bBreakerOpen) {
+                auto probeTime = this->m_breakerOpened + this->m_settings.breakerCooldown;
+                if (std::chrono::steady_clock::now() < probeTime) {
+                    this->m_drainWakeup.wait_until(locker, probeTime);
+                    continue;
+                }
+            }
+
+            auto now = std::chrono::system_clock::now();
+            auto due = std::find_if(this->m_items.begin(), this->m_items.end(), [&now] (const Item & item) {
+                return (item.nextAttempt <= now);
+            });
+
+            if (due == this->m_items.end()) {
+                auto next = std::min_element(this->m_items.begin(), this->m_items.end(), [] (const Item &a, const Item & b) {
+                    return (a.nextAttempt < b.nextAttempt);
+                });
+                this->m_drainWakeup.wait_until(locker, next->nextAttempt);
+                continue;
+            }
+
+            Item item { *due };
+            bool bDelivered = false;
+
+            locker.unlock();
+
+            try {
+                bDelivered = this->m_deliverFn((this->m_settings.bDeliverOriginal && !item.original.empty()) ? item.original : item.file);
+            } catch (const std::exception &e) {
+                std::cerr << "Spool Error: " << e.what() << std::endl;
+            }
+
+            this->recordResult(bDelivered);
+
+            locker.lock();
+
+            due = std::find_if(this->m_items.begin(), this->m_items.end(), [&item] (const Item & waiting) {
+                return (waiting.directory == item.directory);
+            });
+
+            try {
+
+                if (bDelivered) {
+                    std::cout << "Delivered spooled file [" << fs::path(item.file).filename().string() << "]" << std::endl;
+                    this->m_items.erase(due);
+                    fs::remove_all(item.directory);
+                } else if (++due->attempts >= this->m_settings.maxAttempts) {
+                    std::cerr << "Spool Error: Giving up on file [" << fs::path(item.file).filename().string()
+                            << "] after " << due->attempts << " attempts." << std::endl;
+                    fs::path failedDirectory { fs::path(this->m_directory) / kFailedDirectory };
+                    this->m_items.erase(due);
+                    fs::rename(item.directory, failedDirectory / fs::path(item.directory).filename());
+                } else {
+                    due->nextAttempt = std::chrono::system_clock::now() + this->retryDelay(due->attempts);
+                    this->writeState(*due);
+                }
+
+            } catch (const std::exception &e) {
+                std::cerr << "Spool Error: " << e.what() << std::endl;
+            }
+
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Get retry settings from task action options.
+    //
+
+    ActionSpool::Settings ActionSpool::Settings::fromOptions(std::unordered_map<std::string, std::string> &options) {
+
+        Settings settings;
+
+        if (!options[FPE::kRetriesOption].empty()) {
+            settings.maxAttempts = std::stoi(options[FPE::kRetriesOption]);
+        }
+
+        if (!options[FPE::kRetryDelayOption].empty()) {
+            settings.retryDelay = std::chrono::seconds(std::stoi(options[FPE::kRetryDelayOption]));
+        }
+
+        return (settings);
+
+    }
+
+    ActionSpool::ActionSpool(const std::string &spoolDirectory, const std::string &serverURL,
+                             DeliverFn deliverFn, const Settings &settings) :
+        m_deliverFn{deliverFn}, m_settings{settings}, m_jitter{std::random_device()()} {
+
+        this->m_directory = (fs::path(spoolDirectory) / serverDirectory(serverURL)).string();
+
+        try {
+            fs::create_directories(fs::path(this->m_directory) / kFailedDirectory);
+            this->loadItems();
+        } catch (const fs::filesystem_error &e) {
+            throw Exception(e.what());
+        }
+
+        this->m_drainThread = std::thread(&ActionSpool::drain, this);
+
+    }
+
+    //
+    // Stop drain thread; anything not delivered stays in the spool.
+    //
+
+    ActionSpool::~ActionSpool() {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+            this->m_stop = true;
+        }
+
+        this->m_drainWakeup.notify_one();
+        this->m_drainThread.join();
+
+    }
+
+    //
+    // Try to deliver file if the server is available and spool it if that fails.
+    //
+
+    bool ActionSpool::submit(const std::string &file) {
+
+        if (this->serverAvailable()) {
+
+            bool bDelivered = false;
+
+            try {
+                bDelivered = this->m_deliverFn(file);
+            } catch (const std::exception &e) {
+                std::cerr << "Spool Error: " << e.what() << std::endl;
+            }
+
+            this->recordResult(bDelivered);
+
+            if (bDelivered) {
+                return (true);
+            }
+
+            return (this->spoolFile(file, 1));
+
+        }
+
+        return (this->spoolFile(file, 0));
+
+    }
+
+    bool ActionSpool::spoolFailed(const std::vector<std::string> &files) {
+
+        bool bSpooled = true;
+
+        this->recordResult(false);
+
+        for (auto &file : files) {
+            bSpooled = this->spoolFile(file, 1) && bSpooled;
+        }
+
+        return (bSpooled);
+
+    }
+
+    bool ActionSpool::serverAvailable(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+
+        return (!this->m_bBreakerOpen);
+
+    }
+
+    std::size_t ActionSpool::waiting(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_spoolMutex);
+
+        return (this->m_items.size());
+
+    }
+
+} // namespace FPE_TaskActions
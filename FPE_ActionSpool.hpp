@@ -0,0 +1,137 @@
+#ifndef FPE_ACTIONSPOOL_HPP
+#define FPE_ACTIONSPOOL_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <unordered_map>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ActionSpool class. A durable on-disk spool for an action that delivers
+    // files to a server (SMTP/IMAP/MongoDB). A file that cannot be delivered
+    // is copied into the spool with its retry state and a background thread
+    // retries it with exponential backoff (plus jitter) until delivered or
+    // out of attempts. A circuit breaker stops workers waiting on a server
+    // that is down: once open, files are spooled without trying the server
+    // and only the drain thread probes it until a delivery succeeds. Items
+    // left in the spool are picked up again when the spool is next created.
+    // An action that works on a file where it is (running a command on it
+    // say) can have retries given the path the file was spooled from.
+    //
+
+    class ActionSpool {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("ActionSpool Failure: " + message) {
+            }
+
+        };
+
+        using DeliverFn = std::function<bool(const std::string &)>;
+
+        //
+        // Retry and circuit breaker settings
+        //
+
+        struct Settings {
+            int maxAttempts { 10 }; // Attempts before item is moved to failed
+            std::chrono::seconds retryDelay { 5 }; // Delay after first failure
+            std::chrono::seconds maxRetryDelay { 900 }; // Backoff ceiling
+            int breakerThreshold { 3 }; // Consecutive failures that open breaker
+            std::chrono::seconds breakerCooldown { 30 }; // Time open before a probe
+            bool bDeliverOriginal { false }; // Retry the file where it was spooled from (not the spooled copy)
+            static Settings fromOptions(std::unordered_map<std::string, std::string> &options);
+        };
+
+        ActionSpool(const std::string &spoolDirectory, const std::string &serverURL,
+                    DeliverFn deliverFn, const Settings &settings);
+
+        ~ActionSpool();
+
+        // Deliver file now unless the server is unavailable; spool it if not
+        // delivered. Returns false only if the file could not be spooled.
+
+        bool submit(const std::string &file);
+
+        // Spool files whose delivery has just failed elsewhere (for example
+        // as part of a batch).
+
+        bool spoolFailed(const std::vector<std::string> &files);
+
+        // Server is taking deliveries (circuit breaker closed)
+
+        bool serverAvailable(void);
+
+        // Items waiting in spool
+
+        std::size_t waiting(void);
+
+        // Spool directory for a server
+
+        const std::string& directory(void) const { return m_directory; }
+
+    private:
+
+        struct Item {
+            std::string directory; // Item directory in spool
+            std::string file; // Spooled copy of file
+            std::string original; // Path file was spooled from
+            int attempts; // Delivery attempts so far
+            std::chrono::system_clock::time_point nextAttempt; // Time of next attempt
+        };
+
+        ActionSpool(const ActionSpool&) = delete;
+        ActionSpool& operator=(const ActionSpool&) = delete;
+
+        void loadItems(void);
+        bool spoolFile(const std::string &file, int attempts);
+        void writeState(const Item &item);
+        std::chrono::seconds retryDelay(int attempts);
+        void recordResult(bool bDelivered);
+        void drain(void);
+
+        std::string m_directory; // Spool directory for server
+        DeliverFn m_deliverFn; // Delivers a file to server
+        Settings m_settings; // Retry/breaker settings
+
+        std::vector<Item> m_items; // Items waiting (in order spooled)
+        std::size_t m_nextItem { 0 }; // Sequence for item names
+        std::mt19937 m_jitter; // Backoff jitter source
+
+        int m_failures { 0 }; // Consecutive delivery failures
+        bool m_bBreakerOpen { false }; // Circuit breaker open
+        std::chrono::steady_clock::time_point m_breakerOpened; // Time breaker opened
+
+        bool m_stop { false }; // Stop drain thread
+        std::mutex m_spoolMutex; // Protects items and breaker
+        std::condition_variable m_drainWakeup; // Drain thread wakeup
+        std::thread m_drainThread; // Background drain thread
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_ACTIONSPOOL_HPP */
+
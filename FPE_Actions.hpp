@@ -9,6 +9,8 @@
 #include <memory>
 #include <unordered_map>
 #include <vector>
+#include <mutex>
+#include <atomic>
 
 //
 // Antik Classes
@@ -16,6 +18,14 @@
 
 #include "CTask.hpp"
 #include "FPE_TaskAction.hpp"
+#include "FPE_ActionBatch.hpp"
+#include "FPE_ActionSpool.hpp"
+#include "FPE_ShellCommand.hpp"
+#include "FPE_SMTPPool.hpp"
+#include "FPE_IMAPSession.hpp"
+#include "FPE_ZIPRollover.hpp"
+#include "FPE_CSVSink.hpp"
+#include "FPE_CSVImport.hpp"
 
 // =========
 // NAMESPACE
@@ -55,16 +65,8 @@ namespace FPE_TaskActions {
         VideoConversion() : TaskAction("Video Conversion") {
         }
 
-        void init(void) override {
-            // Allows the  of built-in command
-            if (m_actionData.find(FPE::kCommandOption)==m_actionData.end()) {
-                m_actionData[FPE::kCommandOption] =
-                    "/usr/local/bin/HandBrakeCLI -i %1% -o %2% --preset=\"Normal\"";
-            }
-        };
-
-        void term(void) override {
-        };
+        void init(void) override;
+        void term(void) override;
         
         bool process(const std::string &file) override;
 
@@ -74,6 +76,9 @@ namespace FPE_TaskActions {
 
         ~VideoConversion() override {
         };
+
+    private:
+        std::unique_ptr<ShellCommand> m_command; // Parsed conversion command
     };
 
     class EmailFile : public TaskAction {
@@ -94,6 +99,18 @@ namespace FPE_TaskActions {
 
         ~EmailFile() override {
         };
+
+    private:
+        bool sendFiles(std::vector<std::string> &files);
+        bool mailFiles(std::vector<std::string> &files);
+        bool appendFiles(std::vector<std::string> &files);
+
+        std::unique_ptr<SMTPPool> m_smtpPool; // SMTP sessions (SMTP server only)
+        std::unique_ptr<IMAPSession> m_imapSession; // IMAP session (IMAP server only)
+        std::unique_ptr<ActionBatch> m_batch; // Digest/IMAP append batch (null when not batching)
+        std::unique_ptr<ActionSpool> m_spool; // Undelivered file spool (null when not spooling)
+        std::size_t m_maxBatchBytes { 0 }; // Files this size or larger are sent alone
+        std::atomic<std::size_t> m_failedFiles { 0 }; // Batched files not delivered and not spooled
     };
 
     class ZIPFile : public TaskAction {
@@ -102,11 +119,8 @@ namespace FPE_TaskActions {
         ZIPFile() : TaskAction("ZIP Archive") {
         }
 
-        void init(void) override {
-        };
-
-        void term(void) override {
-        };
+        void init(void) override;
+        void term(void) override;
         
         bool process(const std::string &file) override;
 
@@ -116,6 +130,10 @@ namespace FPE_TaskActions {
 
         ~ZIPFile() override {
         };
+
+    private:
+        std::unique_ptr<ZIPRollover> m_archive; // Archive series kept open for task (null when sharded)
+        std::unique_ptr<ZIPShards> m_shards; // Sharded archive series (null when not sharded)
     };
 
     class RunCommand : public TaskAction {
@@ -124,11 +142,8 @@ namespace FPE_TaskActions {
         RunCommand() : TaskAction("Run Command") {
         }
 
-        void init(void) override {
-        };
-
-        void term(void) override {
-        };
+        void init(void) override;
+        void term(void) override;
         
         bool process(const std::string &file) override;
 
@@ -138,6 +153,15 @@ namespace FPE_TaskActions {
 
         ~RunCommand() override {
         };
+
+    private:
+        std::vector<std::string> runBatch(std::vector<std::string> &files);
+
+        std::unique_ptr<ShellCommand> m_command; // Parsed command
+        std::unique_ptr<ActionBatch> m_batch; // %files% batch (null when not batching)
+        std::unique_ptr<ActionSpool> m_spool; // Spool for files a batch fails on (null when not spooling)
+        std::size_t m_failedFiles { 0 }; // Batched files failed and not spooled
+        std::mutex m_runMutex; // Serialises command runs (ShellCommand is not thread safe)
     };
 
     class ImportCSVFile : public TaskAction {
@@ -146,20 +170,46 @@ namespace FPE_TaskActions {
         ImportCSVFile() : TaskAction("Import CSV File") {
         }
 
+        void init(void) override;
+        void term(void) override;
+        
+        bool process(const std::string &file) override;
+
+        std::vector<std::string> getParameters() override {
+            return (std::vector<std::string>({FPE::kServerOption, FPE::kCollectionOption}));
+        }
+
+        ~ImportCSVFile() override {
+        };
+
+    private:
+        bool importFile(const std::string &file);
+
+        std::unique_ptr<CSVSink> m_sink; // Database rows are imported into
+        std::unique_ptr<CSVImport> m_csvImport; // Imports files into sink (keeps keys seen)
+        std::string m_initError; // Why sink or import could not be created
+        std::unique_ptr<ActionSpool> m_spool; // Undelivered file spool (null when not spooling)
+    };
+
+    class ExtractZIPFile : public TaskAction {
+    public:
+
+        ExtractZIPFile() : TaskAction("Extract ZIP Archive") {
+        }
+
         void init(void) override {
         };
 
         void term(void) override {
         };
-        
+
         bool process(const std::string &file) override;
 
         std::vector<std::string> getParameters() override {
-            return (std::vector<std::string>({FPE::kServerOption, FPE::kUserOption,
-                FPE::kPasswordOption, FPE::kDatabaseOption, FPE::kCollectionOption}));
+            return (std::vector<std::string>({FPE::kDestinationOption}));
         }
 
-        ~ImportCSVFile() override {
+        ~ExtractZIPFile() override {
         };
     };
 
@@ -0,0 +1,191 @@
+//
+// Module: FPE_BSONEncoder
+//
+// Description: Encode CSV rows as BSON documents (BSON specification 1.1)
+// without going through a document builder so that field name keys need
+// only be encoded once per file.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+
+//
+// Program components.
+//
+
+#include "FPE_BSONEncoder.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // BSON element types
+    //
+
+    constexpr std::uint8_t kBSONDouble { 0x01 };
+    constexpr std::uint8_t kBSONString { 0x02 };
+    constexpr std::uint8_t kBSONBoolean { 0x08 };
+    constexpr std::uint8_t kBSONDateTime { 0x09 };
+    constexpr std::uint8_t kBSONNull { 0x0a };
+    constexpr std::uint8_t kBSONInt64 { 0x12 };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Append little-endian integer to document.
+    //
+
+    template <typename T>
+    static inline void appendLittleEndian(std::vector<std::uint8_t> &document, T value) {
+
+        for (std::size_t byte = 0; byte < sizeof (T); byte++) {
+            document.push_back(static_cast<std::uint8_t> (static_cast<std::uint64_t> (value) >> (byte * 8)));
+        }
+
+    }
+
+    //
+    // Append element (type, key, value) for field of column to document.
+    //
+
+    void BSONEncoder::appendField(std::vector<std::uint8_t> &document, std::size_t column, std::string_view field) const {
+
+        CSVSchema::Value value;
+
+        if (this->m_schema) {
+            this->m_schema->convert(column, field, value);
+        } else {
+            value.type = CSVSchema::Type::string;
+            value.text = field;
+        }
+
+        std::size_t typePosition = document.size();
+
+        document.push_back(kBSONString);
+        document.insert(document.end(), this->m_keys[column].begin(), this->m_keys[column].end());
+
+        switch (value.type) {
+            case CSVSchema::Type::int64:
+                document[typePosition] = kBSONInt64;
+                appendLittleEndian<std::int64_t>(document, value.integer);
+                break;
+            case CSVSchema::Type::real:
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value.real, sizeof (bits));
+                document[typePosition] = kBSONDouble;
+                appendLittleEndian<std::uint64_t>(document, bits);
+                break;
+            }
+            case CSVSchema::Type::boolean:
+                document[typePosition] = kBSONBoolean;
+                document.push_back(static_cast<std::uint8_t> (value.integer != 0));
+                break;
+            case CSVSchema::Type::date:
+                document[typePosition] = kBSONDateTime;
+                appendLittleEndian<std::int64_t>(document, value.integer);
+                break;
+            case CSVSchema::Type::null:
+                document[typePosition] = kBSONNull;
+                break;
+            default:
+                appendLittleEndian<std::int32_t>(document, static_cast<std::int32_t> (value.text.size() + 1));
+                document.insert(document.end(), value.text.begin(), value.text.end());
+                document.push_back(0);
+                break;
+        }
+
+    }
+
+    //
+    // Terminate document and fill in its length.
+    //
+
+    void BSONEncoder::finish(std::vector<std::uint8_t> &document) {
+
+        document.push_back(0);
+
+        std::int32_t length = static_cast<std::int32_t> (document.size());
+
+        for (std::size_t byte = 0; byte < sizeof (length); byte++) {
+            document[byte] = static_cast<std::uint8_t> (static_cast<std::uint32_t> (length) >> (byte * 8));
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    BSONEncoder::BSONEncoder(const std::vector<std::string> &fieldNames, const CSVSchema *schema) : m_schema{schema} {
+
+        for (auto &fieldName : fieldNames) {
+            this->m_keys.push_back(fieldName);
+            this->m_keys.back().push_back('\0');
+        }
+
+    }
+
+    //
+    // Document is its length, elements (type, key, value) and a null.
+    //
+
+    void BSONEncoder::encode(const CSVParser::Fields &fields, std::vector<std::uint8_t> &document, std::string_view id) const {
+
+        document.clear();
+        appendLittleEndian<std::int32_t>(document, 0);
+
+        if (!id.empty()) {
+            static const char idKey[] { "_id" };
+            document.push_back(kBSONString);
+            document.insert(document.end(), idKey, idKey + sizeof (idKey));
+            appendLittleEndian<std::int32_t>(document, static_cast<std::int32_t> (id.size() + 1));
+            document.insert(document.end(), id.begin(), id.end());
+            document.push_back(0);
+        }
+
+        for (std::size_t column = 0; (column < fields.size()) && (column < this->m_keys.size()); column++) {
+            this->appendField(document, column, fields[column]);
+        }
+
+        this->finish(document);
+
+    }
+
+    //
+    // Key document has the fields of the key columns only (a missing field
+    // being taken as empty).
+    //
+
+    void BSONEncoder::encodeKey(const CSVParser::Fields &fields, const std::vector<std::size_t> &keyColumns,
+            std::vector<std::uint8_t> &document) const {
+
+        document.clear();
+        appendLittleEndian<std::int32_t>(document, 0);
+
+        for (auto column : keyColumns) {
+            this->appendField(document, column, (column < fields.size()) ? fields[column] : std::string_view());
+        }
+
+        this->finish(document);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,62 @@
+#ifndef FPE_BSONENCODER_HPP
+#define FPE_BSONENCODER_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+#include "FPE_CSVSchema.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // BSONEncoder class. Encode CSV rows directly as BSON documents of the
+    // field names and values. The field name keys are encoded once for the
+    // file and values are written as native BSON types (int64, double,
+    // boolean, UTC datetime, null or string) from a schema or as strings
+    // if there is none.
+    //
+
+    class BSONEncoder {
+    public:
+
+        BSONEncoder(const std::vector<std::string> &fieldNames, const CSVSchema *schema = nullptr);
+
+        // Encode row as a document (replacing contents of document) with a
+        // string _id if one is passed. Fields beyond the number of field
+        // names are ignored.
+
+        void encode(const CSVParser::Fields &fields, std::vector<std::uint8_t> &document, std::string_view id = {}) const;
+
+        // Encode the key columns of row as a document (for an upsert filter)
+
+        void encodeKey(const CSVParser::Fields &fields, const std::vector<std::size_t> &keyColumns,
+                std::vector<std::uint8_t> &document) const;
+
+    private:
+
+        void appendField(std::vector<std::uint8_t> &document, std::size_t column, std::string_view field) const;
+        static void finish(std::vector<std::uint8_t> &document);
+
+        std::vector<std::string> m_keys; // Field names as BSON keys (with terminating null)
+        const CSVSchema *m_schema; // Column types (null for all strings)
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_BSONENCODER_HPP */
+
@@ -0,0 +1,234 @@
+//
+// Module: FPE_CSVCheckpoint
+//
+// Description: Checkpoint file of CSV import progress. The file is
+// rewritten (to a temporary file that is then renamed over it) each time
+// a batch of rows is acknowledged so it is always complete.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <future>
+#include <cstring>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVCheckpoint.hpp"
+
+namespace FPE_TaskActions {
+
+    // =======
+    // IMPORTS
+    // =======
+
+    namespace fs = std::filesystem;
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr char const *kCheckpointHeader { "FPE CSV checkpoint 1" }; // First line of checkpoint file
+    constexpr std::size_t kIdSegmentSize { 64 * 1024 * 1024 }; // Bytes of file hashed as one segment
+
+    constexpr std::uint64_t kPrime1 { 0x9E3779B185EBCA87ULL }; // 64 bit hash multipliers
+    constexpr std::uint64_t kPrime2 { 0xC2B2AE3D27D4EB4FULL };
+    constexpr std::uint64_t kPrime3 { 0x165667B19E3779F9ULL };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    static inline std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+        return ((value << bits) | (value >> (64 - bits)));
+    }
+
+    //
+    // 64 bit hash of a block of memory, taken a word at a time with the
+    // byte count mixed in and a final avalanche so every bit of the result
+    // depends on every byte.
+    //
+
+    static std::uint64_t hash64(const char *data, std::size_t length, std::uint64_t seed) {
+
+        std::uint64_t hash = seed ^ (length * kPrime1);
+        std::size_t offset = 0;
+
+        for (; offset + sizeof (std::uint64_t) <= length; offset += sizeof (std::uint64_t)) {
+            std::uint64_t word;
+            std::memcpy(&word, data + offset, sizeof (word));
+            hash ^= rotateLeft(word * kPrime2, 31) * kPrime1;
+            hash = rotateLeft(hash, 27) * kPrime1 + kPrime3;
+        }
+
+        for (; offset < length; offset++) {
+            hash ^= static_cast<unsigned char> (data[offset]) * kPrime3;
+            hash = rotateLeft(hash, 11) * kPrime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+
+        return (hash);
+
+    }
+
+    //
+    // Write checkpoint (caller holds ranges lock).
+    //
+
+    void CSVCheckpoint::save(void) {
+
+        std::string tempName { this->m_fileName + ".tmp" };
+
+        {
+            std::ofstream checkpointStream(tempName, std::ios::trunc);
+            checkpointStream << kCheckpointHeader << "\n";
+            for (auto &range : this->m_ranges) {
+                checkpointStream << range.start << " " << range.end << " " << range.next << " " << range.rows << "\n";
+            }
+            if (!checkpointStream) {
+                throw Exception("Could not write [" + tempName + "]");
+            }
+        }
+
+        fs::rename(tempName, this->m_fileName);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    CSVCheckpoint::CSVCheckpoint(const std::string &directory, const std::string &fileId) {
+
+        if (!fs::exists(directory)) {
+            fs::create_directories(directory);
+        }
+
+        this->m_fileName = (fs::path(directory) / (fileId + ".checkpoint")).string();
+
+    }
+
+    bool CSVCheckpoint::load(std::vector<Range> &ranges) {
+
+        std::lock_guard<std::mutex> locker(this->m_rangesMutex);
+        std::ifstream checkpointStream(this->m_fileName);
+        std::string header;
+
+        ranges.clear();
+
+        if (!checkpointStream || !std::getline(checkpointStream, header) || (header != kCheckpointHeader)) {
+            return (false);
+        }
+
+        Range range;
+
+        while (checkpointStream >> range.start >> range.end >> range.next >> range.rows) {
+            if ((range.start > range.next) || (range.next > range.end)) {
+                ranges.clear();
+                return (false);
+            }
+            ranges.push_back(range);
+        }
+
+        this->m_ranges = ranges;
+
+        return (!ranges.empty());
+
+    }
+
+    void CSVCheckpoint::start(const std::vector<Range> &ranges) {
+
+        std::lock_guard<std::mutex> locker(this->m_rangesMutex);
+
+        this->m_ranges = ranges;
+        this->save();
+
+    }
+
+    void CSVCheckpoint::acknowledge(std::size_t range, std::uint64_t next, std::uint64_t rows) {
+
+        std::lock_guard<std::mutex> locker(this->m_rangesMutex);
+
+        if (range >= this->m_ranges.size()) {
+            throw Exception("Invalid range " + std::to_string(range) + ".");
+        }
+
+        this->m_ranges[range].next = next;
+        this->m_ranges[range].rows += rows;
+        this->save();
+
+    }
+
+    void CSVCheckpoint::complete(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_rangesMutex);
+
+        fs::remove(this->m_fileName);
+        this->m_ranges.clear();
+
+    }
+
+    //
+    // The whole file is covered (not just its start) as files of the same
+    // size sharing a header and first rows, such as overlapping extracts,
+    // must not share a checkpoint or row ids. That costs one extra read of
+    // the file before its import starts so it is split into fixed size
+    // segments hashed in parallel, each thread taking every threads'th
+    // segment, and the segment hashes are then hashed in order (so the ID
+    // does not depend on the number of threads).
+    //
+
+    std::string CSVCheckpoint::fileId(const char *data, std::size_t length, std::size_t threads) {
+
+        std::ostringstream id;
+        std::size_t segmentCount = std::max<std::size_t>(1, (length + kIdSegmentSize - 1) / kIdSegmentSize);
+        std::vector<std::uint64_t> segmentHashes(segmentCount);
+        std::vector<std::future<void>> segmentHashing;
+
+        threads = std::max<std::size_t>(1, std::min(threads, segmentCount));
+
+        for (std::size_t thread = 0; thread < threads; thread++) {
+            segmentHashing.push_back(std::async(std::launch::async, [&, thread] () {
+                for (std::size_t segment = thread; segment < segmentCount; segment += threads) {
+                    std::size_t offset = segment * kIdSegmentSize;
+                    segmentHashes[segment] = hash64(data + offset, std::min(length - offset, kIdSegmentSize), segment);
+                }
+            }));
+        }
+
+        for (auto &hashing : segmentHashing) {
+            hashing.get();
+        }
+
+        std::uint64_t hash = hash64(reinterpret_cast<const char *> (segmentHashes.data()),
+                segmentHashes.size() * sizeof (std::uint64_t), length);
+
+        id << std::hex << std::setfill('0') << std::setw(16) << hash << "-" << std::dec << length;
+
+        return (id.str());
+
+    }
+
+} // namespace FPE_TaskActions
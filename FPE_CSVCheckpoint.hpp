@@ -0,0 +1,94 @@
+#ifndef FPE_CSVCHECKPOINT_HPP
+#define FPE_CSVCHECKPOINT_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVCheckpoint class. Progress of a CSV import kept in a small file in
+    // a checkpoint directory so that an interrupted import can carry on
+    // from where it got to. The file is named by an ID formed from the CSV
+    // file's contents (so a copy of the file, such as one spooled, is the
+    // same import) and holds for each byte range of the file being
+    // imported the offset of the first row not yet acknowledged by the
+    // database and the number of rows that have been.
+    //
+
+    class CSVCheckpoint {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVCheckpoint Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Range of file being imported
+        //
+
+        struct Range {
+            std::uint64_t start { 0 }; // Offset of first row
+            std::uint64_t end { 0 }; // Offset after last row
+            std::uint64_t next { 0 }; // Offset of first row not acknowledged
+            std::uint64_t rows { 0 }; // Rows acknowledged
+        };
+
+        CSVCheckpoint(const std::string &directory, const std::string &fileId);
+
+        // Load ranges from checkpoint file (false if there is none)
+
+        bool load(std::vector<Range> &ranges);
+
+        // Start new import of ranges
+
+        void start(const std::vector<Range> &ranges);
+
+        // Rows of a range acknowledged up to offset next
+
+        void acknowledge(std::size_t range, std::uint64_t next, std::uint64_t rows);
+
+        // Import complete (checkpoint file removed)
+
+        void complete(void);
+
+        // ID of CSV file from its size and a 64 bit hash of its contents
+        // (hashed by up to threads threads)
+
+        static std::string fileId(const char *data, std::size_t length, std::size_t threads = 1);
+
+    private:
+
+        CSVCheckpoint(const CSVCheckpoint&) = delete;
+        CSVCheckpoint& operator=(const CSVCheckpoint&) = delete;
+
+        void save(void);
+
+        std::string m_fileName; // Checkpoint file
+        std::vector<Range> m_ranges; // Ranges being imported
+        std::mutex m_rangesMutex; // Protects ranges and file
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVCHECKPOINT_HPP */
+
@@ -0,0 +1,599 @@
+//
+// Module: FPE_CSVImport
+//
+// Description: Import of a CSV file into a sink. The header row is read
+// once then the file is split into byte ranges (one per thread) that
+// start on row boundaries and each range is imported by its own thread.
+// A gzip compressed file is imported as one range streamed through the
+// parser as it is decompressed.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <sstream>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+//
+// Program components.
+//
+
+#include "FPE.hpp"
+#include "FPE_CSVImport.hpp"
+#include "FPE_CSVParser.hpp"
+#include "FPE_CSVSchema.hpp"
+#include "FPE_GZipStream.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kSampleSize { 1024 * 1024 }; // Bytes of rows column types are inferred from
+    constexpr std::size_t kHeadSize { 2 * kSampleSize }; // Bytes decompressed for header and sample of a compressed file
+
+    //
+    // File being imported
+    //
+
+    struct CSVImport::File {
+        const char *data { nullptr }; // Mapped file
+        std::string streamFile; // Compressed file streamed through parser (empty when mapped)
+        std::vector<CSVCheckpoint::Range> ranges; // Byte ranges imported by a thread each
+        std::unique_ptr<CSVCheckpoint> checkpoint; // Checkpoint (null for none)
+        std::string idPrefix; // Row id prefix (empty for ids assigned by database)
+        std::vector<std::size_t> keyColumns; // Key columns (filter de-duplication)
+        std::unique_ptr<CSVKeyFilter> keys; // Keys of rows in file (filter de-duplication)
+        std::atomic<std::uint64_t> duplicates { 0 }; // Rows dropped as duplicates
+        std::vector<std::size_t> selection; // Columns parsed (empty for all)
+        std::vector<std::size_t> projection; // Position in parsed fields of each column imported (empty for all)
+        std::unique_ptr<CSVRowFilter> rowFilter; // Row filter (null for none)
+        std::atomic<std::uint64_t> filtered { 0 }; // Rows dropped by filter
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Split comma separated list of names (ignoring empty entries).
+    //
+
+    static std::vector<std::string> splitNames(const std::string &list) {
+
+        std::istringstream names(list);
+        std::vector<std::string> nameList;
+        std::string name;
+
+        while (std::getline(names, name, ',')) {
+            if (!name.empty()) {
+                nameList.push_back(name);
+            }
+        }
+
+        return (nameList);
+
+    }
+
+    //
+    // Data is zstd compressed.
+    //
+
+    static bool isZstd(const char *data, std::size_t length) {
+
+        return ((length >= 4) && (static_cast<unsigned char> (data[0]) == 0x28) && (static_cast<unsigned char> (data[1]) == 0xb5)
+                && (static_cast<unsigned char> (data[2]) == 0x2f) && (static_cast<unsigned char> (data[3]) == 0xfd));
+
+    }
+
+    //
+    // Fields of the columns imported (a field missing from a short row
+    // being empty).
+    //
+
+    static void projectFields(const CSVParser::Fields &fields, const std::vector<std::size_t> &projection, CSVParser::Fields &projected) {
+
+        projected.clear();
+
+        for (auto position : projection) {
+            projected.push_back((position < fields.size()) ? fields[position] : std::string_view());
+        }
+
+    }
+
+    //
+    // Remember the keys of the rows of a range acknowledged before an import
+    // was interrupted (those before its first row not yet acknowledged) so
+    // that later rows repeating them are still dropped. A compressed file is
+    // decompressed up to that row.
+    //
+
+    void CSVImport::rememberKeys(File &file, std::size_t rangeNo) {
+
+        const CSVCheckpoint::Range &range = file.ranges[rangeNo];
+        CSVParser csvParser;
+        CSVParser::Fields projected;
+        std::string key;
+
+        auto rememberRow = [&] (const CSVParser::Fields &parsed, std::uint64_t offset) {
+            if ((offset >= range.next) || (file.rowFilter && !file.rowFilter->matches(parsed))) {
+                return;
+            }
+            if (!file.projection.empty()) {
+                projectFields(parsed, file.projection, projected);
+            }
+            CSVKeyFilter::rowKey(file.projection.empty() ? parsed : projected, file.keyColumns, key);
+            file.keys->insert(key);
+        };
+
+        csvParser.select(file.selection);
+
+        if (file.streamFile.empty()) {
+            csvParser.parse(file.data + range.start, range.next - range.start, true, [&] (const CSVParser::Fields &fields, std::size_t rowStart) {
+                rememberRow(fields, range.start + rowStart);
+            });
+        } else {
+            GZipStream stream(file.streamFile);
+            GZipStream::Block block;
+            std::size_t keep = 0;
+            while (stream.read(block, keep)) {
+                std::size_t start = (range.start > block.offset) ? std::min<std::uint64_t>(range.start - block.offset, block.length) : 0;
+                std::size_t parsed = csvParser.parse(block.data + start, block.length - start, block.bLast,
+                        [&] (const CSVParser::Fields &fields, std::size_t rowStart) {
+                            rememberRow(fields, block.offset + start + rowStart);
+                        });
+                if (block.offset + block.length >= range.next) {
+                    break;
+                }
+                keep = block.length - start - parsed;
+            }
+        }
+
+    }
+
+    //
+    // Import rows of a range of a CSV file from its first row not yet
+    // acknowledged. Rows are written in batches and the next batch is built
+    // while the last is being written; each batch acknowledged is
+    // checkpointed. A compressed file is parsed a block at a time as it is
+    // decompressed (on another thread) and any incomplete row at the end of
+    // a block is kept to be parsed in front of the next. Returns the number
+    // of rows written.
+    //
+
+    std::uint64_t CSVImport::importRows(CSVSink::Writer &writer, File &file, std::size_t rangeNo) {
+
+        const CSVCheckpoint::Range &range = file.ranges[rangeNo];
+        CSVParser csvParser;
+        CSVParser::Fields projected;
+        std::string id;
+        std::string key;
+        std::uint64_t rowsWritten = 0;
+        std::uint64_t end = range.end;
+
+        // Batch being built and the batch being written (with the offset of
+        // the row after it)
+
+        std::unique_ptr<CSVSink::Batch> batch { writer.batch() };
+        std::unique_ptr<CSVSink::Batch> writingBatch;
+        std::future<void> batchWriting;
+        std::uint64_t writingNext = 0;
+
+        // Wait for the last batch to be written (passing on any error) and
+        // checkpoint it then start writing the current one (which ends at
+        // offset next) in the background.
+
+        auto writeCurrentBatch = [&] (std::uint64_t next) {
+            if (batchWriting.valid()) {
+                batchWriting.get();
+                rowsWritten += writingBatch->rows();
+                if (file.checkpoint) {
+                    file.checkpoint->acknowledge(rangeNo, writingNext, writingBatch->rows());
+                }
+                writingBatch.reset();
+            }
+            if (batch->rows()) {
+                writingBatch = std::move(batch);
+                writingNext = next;
+                batchWriting = std::async(std::launch::async, [&writer, &writingBatch] () {
+                    writer.write(*writingBatch);
+                });
+                batch = writer.batch();
+            }
+        };
+
+        // A full batch is sent before the next row is added so that the
+        // offset of the row after the batch is known. Rows not passing the
+        // filter or whose key is in an earlier file or earlier in this one
+        // are dropped.
+
+        auto importRow = [&] (const CSVParser::Fields &parsed, std::uint64_t offset) {
+            if (file.rowFilter && !file.rowFilter->matches(parsed)) {
+                file.filtered++;
+                return;
+            }
+            if (!file.projection.empty()) {
+                projectFields(parsed, file.projection, projected);
+            }
+            const CSVParser::Fields &fields = file.projection.empty() ? parsed : projected;
+            if (file.keys) {
+                CSVKeyFilter::rowKey(fields, file.keyColumns, key);
+                if (this->m_keysSeen->contains(key) || !file.keys->insert(key)) {
+                    file.duplicates++;
+                    return;
+                }
+            }
+            if (batch->rows() && ((batch->rows() >= this->m_settings.insertBatch) || (batch->bytes() >= this->m_settings.insertSize))) {
+                writeCurrentBatch(offset);
+            }
+            if (!file.idPrefix.empty()) {
+                id = file.idPrefix + std::to_string(offset);
+            }
+            batch->add(fields, id);
+        };
+
+        csvParser.select(file.selection);
+
+        if (file.streamFile.empty()) {
+            csvParser.parse(file.data + range.next, range.end - range.next, true, [&] (const CSVParser::Fields &fields, std::size_t rowStart) {
+                importRow(fields, range.next + rowStart);
+            });
+        } else {
+            GZipStream stream(file.streamFile);
+            GZipStream::Block block;
+            std::size_t keep = 0;
+            while (stream.read(block, keep)) {
+                std::size_t start = (range.next > block.offset) ? std::min<std::uint64_t>(range.next - block.offset, block.length) : 0;
+                std::size_t parsed = csvParser.parse(block.data + start, block.length - start, block.bLast,
+                        [&] (const CSVParser::Fields &fields, std::size_t rowStart) {
+                            importRow(fields, block.offset + start + rowStart);
+                        });
+                keep = block.length - start - parsed;
+                end = block.offset + block.length;
+            }
+        }
+
+        // Write final batch and wait for it to complete
+
+        writeCurrentBatch(end);
+        writeCurrentBatch(end);
+
+        return (rowsWritten);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    CSVImport::Settings CSVImport::Settings::fromOptions(std::unordered_map<std::string, std::string> &options) {
+
+        Settings settings;
+
+        if (!options[FPE::kInsertBatchOption].empty()) {
+            settings.insertBatch = std::max(std::stoi(options[FPE::kInsertBatchOption]), 1);
+        }
+
+        if (!options[FPE::kInsertSizeOption].empty()) {
+            settings.insertSize = static_cast<std::size_t> (std::stoi(options[FPE::kInsertSizeOption])) * 1024;
+        }
+
+        if (!options[FPE::kThreadsOption].empty()) {
+            settings.threads = std::stoi(options[FPE::kThreadsOption]);
+        }
+
+        settings.schema = options[FPE::kSchemaOption];
+        settings.checkpointDirectory = options[FPE::kCheckpointOption];
+
+        settings.keyColumns = splitNames(options[FPE::kKeyColumnsOption]);
+        settings.columns = splitNames(options[FPE::kColumnsOption]);
+        settings.filter = options[FPE::kFilterOption];
+
+        if (options[FPE::kDedupOption] == "upsert") {
+            settings.dedup = Dedup::upsert;
+        } else if (!options[FPE::kDedupOption].empty() && (options[FPE::kDedupOption] != "filter")) {
+            throw Exception("Invalid de-duplication mode [" + options[FPE::kDedupOption] + "] (filter or upsert).");
+        }
+
+        return (settings);
+
+    }
+
+    CSVImport::CSVImport(CSVSink &sink, const Settings &settings) : m_sink{sink}, m_settings{settings} {
+
+        if (!this->m_settings.threads) {
+            this->m_settings.threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        this->m_settings.insertBatch = std::max<std::size_t>(this->m_settings.insertBatch, 1);
+        this->m_settings.minRangeSize = std::max<std::size_t>(this->m_settings.minRangeSize, 1);
+
+        if (!this->m_settings.keyColumns.empty() && (this->m_settings.dedup == Dedup::filter)) {
+            this->m_keysSeen.reset(new CSVKeyFilter());
+        }
+
+    }
+
+    std::uint64_t CSVImport::importFile(const std::string &fileName) {
+
+        MappedFile csvFile(fileName);
+        CSVParser csvParser;
+        CSVSink::Table table;
+        File file;
+
+        // The header and sample rows of a gzip compressed file are read from
+        // a decompressed copy of its start; the rest is streamed on import
+
+        const char *data = csvFile.data();
+        std::size_t size = csvFile.size();
+        bool bWhole = true;
+        std::string head;
+
+        if (isZstd(csvFile.data(), csvFile.size())) {
+            throw Exception("[" + fileName + "] is zstd compressed which is not supported (gzip only).");
+        }
+
+        if (GZipStream::isGZip(csvFile.data(), csvFile.size())) {
+            head = GZipStream::head(fileName, kHeadSize);
+            data = head.data();
+            size = head.size();
+            bWhole = (size < kHeadSize);
+            file.streamFile = fileName;
+        } else {
+            file.data = csvFile.data();
+        }
+
+        // First row holds the field names
+
+        std::size_t headerEnd = csvParser.rowStarts(data, size, {1}).front();
+
+        if (!bWhole && (headerEnd == size)) {
+            throw Exception("Header of [" + fileName + "] is too long.");
+        }
+
+        csvParser.parse(data, headerEnd, true, [&table] (const CSVParser::Fields &fields, std::size_t) {
+            table.fieldNames.assign(fields.begin(), fields.end());
+        });
+
+        if (table.fieldNames.empty()) {
+            return (0);
+        }
+
+        // Only the columns imported and those filtered on are parsed; the
+        // columns imported are then picked out of those parsed (in the order
+        // given) unless they are all of them in order
+
+        if (!this->m_settings.columns.empty() || !this->m_settings.filter.empty()) {
+
+            std::vector<std::size_t> columns;
+
+            for (auto &columnName : this->m_settings.columns) {
+                auto fieldName = std::find(table.fieldNames.begin(), table.fieldNames.end(), columnName);
+                if (fieldName == table.fieldNames.end()) {
+                    throw Exception("Column [" + columnName + "] not in header of [" + fileName + "].");
+                }
+                columns.push_back(fieldName - table.fieldNames.begin());
+            }
+
+            if (columns.empty()) {
+                for (std::size_t column = 0; column < table.fieldNames.size(); column++) {
+                    columns.push_back(column);
+                }
+            }
+
+            file.selection = columns;
+
+            if (!this->m_settings.filter.empty()) {
+                file.rowFilter.reset(new CSVRowFilter(table.fieldNames, this->m_settings.filter));
+                std::vector<std::size_t> filterColumns { file.rowFilter->columns() };
+                file.selection.insert(file.selection.end(), filterColumns.begin(), filterColumns.end());
+            }
+
+            std::sort(file.selection.begin(), file.selection.end());
+            file.selection.erase(std::unique(file.selection.begin(), file.selection.end()), file.selection.end());
+
+            if (file.selection.size() == table.fieldNames.size()) {
+                file.selection.clear();
+            } else if (file.rowFilter) {
+                file.rowFilter->select(file.selection);
+            }
+
+            std::vector<std::string> fieldNames;
+
+            for (auto column : columns) {
+                fieldNames.push_back(table.fieldNames[column]);
+                file.projection.push_back(file.selection.empty() ? column :
+                        std::lower_bound(file.selection.begin(), file.selection.end(), column) - file.selection.begin());
+            }
+
+            bool bIdentity = (file.projection.size() == (file.selection.empty() ? table.fieldNames.size() : file.selection.size()));
+            for (std::size_t position = 0; bIdentity && (position < file.projection.size()); position++) {
+                bIdentity = (file.projection[position] == position);
+            }
+            if (bIdentity) {
+                file.projection.clear();
+            }
+
+            table.fieldNames = fieldNames;
+
+        }
+
+        // Key columns are either filtered on here or passed to the sink to
+        // upsert on
+
+        for (auto &keyColumn : this->m_settings.keyColumns) {
+            auto fieldName = std::find(table.fieldNames.begin(), table.fieldNames.end(), keyColumn);
+            if (fieldName == table.fieldNames.end()) {
+                throw Exception("Key column [" + keyColumn + "] not in header of [" + fileName + "].");
+            }
+            file.keyColumns.push_back(fieldName - table.fieldNames.begin());
+        }
+
+        if (this->m_keysSeen) {
+            file.keys.reset(new CSVKeyFilter());
+        } else {
+            table.upsertKeys = file.keyColumns;
+        }
+
+        // Resume from checkpoint (rows given an id of file ID and offset so
+        // any re-written are recognised; upserts need no id as writing them
+        // again changes nothing)
+
+        if (!this->m_settings.checkpointDirectory.empty()) {
+            std::string fileId { CSVCheckpoint::fileId(csvFile.data(), csvFile.size(), this->m_settings.threads) };
+            file.checkpoint.reset(new CSVCheckpoint(this->m_settings.checkpointDirectory, fileId));
+            if (table.upsertKeys.empty()) {
+                file.idPrefix = fileId + ":";
+            }
+            if (file.checkpoint->load(file.ranges)) {
+                std::uint64_t rows = 0;
+                for (auto &range : file.ranges) {
+                    rows += range.rows;
+                }
+                std::cout << "Resuming import of [" << fileName << "] after " << rows << " rows." << std::endl;
+            }
+        }
+
+        // Otherwise split after header into ranges of at least minRangeSize
+        // (a compressed file being one range whose end is found on import)
+
+        if (file.ranges.empty() && !file.streamFile.empty()) {
+
+            CSVCheckpoint::Range newRange;
+            newRange.start = newRange.next = headerEnd;
+            newRange.end = std::numeric_limits<std::uint64_t>::max();
+            file.ranges.push_back(newRange);
+
+            if (file.checkpoint) {
+                file.checkpoint->start(file.ranges);
+            }
+
+        } else if (file.ranges.empty()) {
+
+            std::size_t rangeCount = std::max<std::size_t>(1, std::min<std::size_t>(this->m_settings.threads,
+                    csvFile.size() / this->m_settings.minRangeSize));
+            std::vector<std::size_t> offsets { headerEnd };
+
+            for (std::size_t range = 1; range < rangeCount; range++) {
+                offsets.push_back(std::max<std::size_t>(headerEnd, csvFile.size() / rangeCount * range));
+            }
+
+            std::vector<std::size_t> rangeStarts { csvParser.rowStarts(csvFile.data(), csvFile.size(), offsets) };
+            rangeStarts.push_back(csvFile.size());
+
+            for (std::size_t range = 0; range + 1 < rangeStarts.size(); range++) {
+                if (rangeStarts[range] < rangeStarts[range + 1]) {
+                    CSVCheckpoint::Range newRange;
+                    newRange.start = newRange.next = rangeStarts[range];
+                    newRange.end = rangeStarts[range + 1];
+                    file.ranges.push_back(newRange);
+                }
+            }
+
+            if (file.checkpoint) {
+                file.checkpoint->start(file.ranges);
+            }
+
+        }
+
+        // Keys of rows acknowledged before an interrupted import are not in
+        // the keys seen (a file's keys are only remembered once it has all
+        // been imported) so they are found again from the rows themselves
+
+        if (file.keys) {
+            std::vector<std::future<void>> rangeKeys;
+            for (std::size_t range = 0; range < file.ranges.size(); range++) {
+                if (file.ranges[range].next > file.ranges[range].start) {
+                    rangeKeys.push_back(std::async(std::launch::async, &CSVImport::rememberKeys, this, std::ref(file), range));
+                }
+            }
+            for (auto &rangeKey : rangeKeys) {
+                rangeKey.get();
+            }
+        }
+
+        // With a schema, infer any column types not given from the rows in
+        // the first kSampleSize bytes after the header
+
+        std::unique_ptr<CSVSchema> schema;
+
+        if (!this->m_settings.schema.empty()) {
+            std::size_t sampleLength = std::min(kSampleSize, size - headerEnd);
+            CSVParser sampleParser;
+            CSVParser::Fields projected;
+            schema.reset(new CSVSchema(table.fieldNames, this->m_settings.schema));
+            sampleParser.select(file.selection);
+            sampleParser.parse(data + headerEnd, sampleLength, bWhole && (headerEnd + sampleLength == size),
+                    [&schema, &file, &projected] (const CSVParser::Fields &fields, std::size_t) {
+                        if (file.projection.empty()) {
+                            schema->sample(fields);
+                        } else {
+                            projectFields(fields, file.projection, projected);
+                            schema->sample(projected);
+                        }
+                    });
+            schema->fix();
+            table.schema = schema.get();
+        }
+
+        // Writers are created up front so that any failure to reach the sink
+        // is reported before any rows are imported
+
+        std::vector<std::unique_ptr<CSVSink::Writer>> writers;
+        std::vector<std::future<std::uint64_t>> rangeImports;
+        std::uint64_t rowsWritten = 0;
+
+        for (auto &range : file.ranges) {
+            writers.push_back((range.next < range.end) ? this->m_sink.writer(table) : nullptr);
+        }
+
+        for (std::size_t range = 0; range < file.ranges.size(); range++) {
+            if (writers[range]) {
+                rangeImports.push_back(std::async(std::launch::async, &CSVImport::importRows, this,
+                        std::ref(*writers[range]), std::ref(file), range));
+            }
+        }
+
+        for (auto &rangeImport : rangeImports) {
+            rowsWritten += rangeImport.get();
+        }
+
+        if (file.checkpoint) {
+            file.checkpoint->complete();
+        }
+
+        if (file.filtered) {
+            std::cout << "Filtered out " << file.filtered << " rows from [" << fileName << "]." << std::endl;
+        }
+
+        // Keys of a file are only remembered once all its rows are written
+        // so that if it fails to import it can be imported again
+
+        if (file.keys) {
+            this->m_keysSeen->merge(*file.keys);
+            if (file.duplicates) {
+                std::cout << "Dropped " << file.duplicates << " duplicate rows from [" << fileName << "]." << std::endl;
+            }
+        }
+
+        return (rowsWritten);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,115 @@
+#ifndef FPE_CSVIMPORT_HPP
+#define FPE_CSVIMPORT_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVSink.hpp"
+#include "FPE_CSVCheckpoint.hpp"
+#include "FPE_CSVKeyFilter.hpp"
+#include "FPE_CSVRowFilter.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVImport class. Import a CSV file into a sink. The file is memory
+    // mapped and split into rows by class CSVParser; a large file is
+    // divided into ranges on row boundaries that are imported in parallel
+    // by a thread each with its own sink writer. A gzip compressed file is
+    // instead decompressed on a thread of its own by class GZipStream into
+    // a ring of buffers that are parsed as they fill. Rows are written in
+    // batches (limited by row count and size) and the next batch is built
+    // while the last is being written. Column types are given or inferred
+    // when a schema is set. With a checkpoint directory progress is
+    // recorded after each batch is acknowledged so that an interrupted
+    // import resumes where it left off (rows then being given an id from
+    // the file and their offset in it so any replayed are ignored).
+    // Given key columns, rows are de-duplicated on their values: either
+    // rows whose key has already been seen (in this or an earlier file)
+    // are dropped before reaching the sink or every row is upserted.
+    // Only a subset of columns may be imported and rows may be filtered on
+    // simple predicates; fields of columns neither imported nor filtered
+    // on are skipped by the parser without being materialised.
+    //
+
+    class CSVImport {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVImport Failure: " + message) {
+            }
+
+        };
+
+        //
+        // De-duplication of rows with the same key
+        //
+
+        enum class Dedup {
+            filter = 0, // Drop rows whose key has been seen
+            upsert // Replace rows with the same key
+        };
+
+        //
+        // Import settings
+        //
+
+        struct Settings {
+            std::size_t insertBatch { 1000 }; // Rows per batch
+            std::size_t insertSize { 8 * 1024 * 1024 }; // Bytes of rows per batch
+            std::size_t threads { 0 }; // Threads importing ranges (0 for hardware concurrency)
+            std::size_t minRangeSize { 16 * 1024 * 1024 }; // Smallest range of a file imported by a thread
+            std::string schema; // Column types (empty for all strings)
+            std::string checkpointDirectory; // Checkpoint directory (empty for none)
+            std::vector<std::string> keyColumns; // Key column names (empty for no de-duplication)
+            Dedup dedup { Dedup::filter }; // How rows with the same key are de-duplicated
+            std::vector<std::string> columns; // Column names imported in order (empty for all)
+            std::string filter; // Row filter predicates (empty for all rows)
+            static Settings fromOptions(std::unordered_map<std::string, std::string> &options);
+        };
+
+        CSVImport(CSVSink &sink, const Settings &settings);
+
+        // Import file returning the number of rows written (throws on failure).
+        // The same import may be used for several files at once.
+
+        std::uint64_t importFile(const std::string &fileName);
+
+    private:
+
+        struct File;
+
+        std::uint64_t importRows(CSVSink::Writer &writer, File &file, std::size_t rangeNo);
+        void rememberKeys(File &file, std::size_t rangeNo);
+
+        CSVSink &m_sink; // Where rows are written
+        Settings m_settings; // Import settings
+        std::unique_ptr<CSVKeyFilter> m_keysSeen; // Keys of rows of files imported (filter de-duplication)
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVIMPORT_HPP */
+
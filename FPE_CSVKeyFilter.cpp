@@ -0,0 +1,164 @@
+//
+// Module: FPE_CSVKeyFilter
+//
+// Description: Set of CSV row keys seen used to drop duplicate rows.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVKeyFilter.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr unsigned kShardBits { 4 }; // Log2 of number of shards
+    constexpr std::size_t kShards { 1u << kShardBits }; // Number of shards
+    constexpr std::size_t kBlockSize { 64 * 1024 }; // Bytes per block of key storage
+    constexpr std::size_t kLargeKeySize { kBlockSize / 4 }; // Keys stored in a block of their own
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Shard for key (top bits of its hash after a splitmix64 finaliser so
+    // that the shards do not take the same bits as the shard's hash table).
+    //
+
+    CSVKeyFilter::Shard& CSVKeyFilter::shard(std::string_view key) {
+
+        std::uint64_t hash = std::hash<std::string_view>{}(key);
+
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        hash = hash ^ (hash >> 31);
+
+        return (this->m_shards[hash >> (64 - kShardBits)]);
+
+    }
+
+    //
+    // Copy key into shard storage returning a view of the copy. A large key
+    // is given a block of its own placed before the block being filled.
+    //
+
+    std::string_view CSVKeyFilter::store(Shard &shard, std::string_view key) {
+
+        char *copy;
+
+        if (key.size() > kLargeKeySize) {
+            std::unique_ptr<char[]> block { new char[key.size()] };
+            copy = block.get();
+            shard.blocks.insert((shard.blocks.empty()) ? shard.blocks.end() : shard.blocks.end() - 1, std::move(block));
+        } else {
+            if (shard.blocks.empty() || (key.size() > (kBlockSize - shard.blockUsed))) {
+                shard.blocks.emplace_back(new char[kBlockSize]);
+                shard.blockUsed = 0;
+            }
+            copy = shard.blocks.back().get() + shard.blockUsed;
+            shard.blockUsed += key.size();
+        }
+
+        std::memcpy(copy, key.data(), key.size());
+
+        return (std::string_view(copy, key.size()));
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    CSVKeyFilter::CSVKeyFilter() : m_shards{new Shard[kShards]} {
+
+    }
+
+    bool CSVKeyFilter::insert(std::string_view key) {
+
+        Shard &keyShard = this->shard(key);
+        std::lock_guard<std::mutex> locker(keyShard.mutex);
+
+        if (keyShard.keys.count(key)) {
+            return (false);
+        }
+
+        keyShard.keys.insert(store(keyShard, key));
+
+        return (true);
+
+    }
+
+    bool CSVKeyFilter::contains(std::string_view key) {
+
+        Shard &keyShard = this->shard(key);
+        std::lock_guard<std::mutex> locker(keyShard.mutex);
+
+        return (keyShard.keys.count(key));
+
+    }
+
+    void CSVKeyFilter::merge(CSVKeyFilter &other) {
+
+        for (std::size_t shard = 0; shard < kShards; shard++) {
+            std::lock_guard<std::mutex> locker(other.m_shards[shard].mutex);
+            for (auto &key : other.m_shards[shard].keys) {
+                this->insert(key);
+            }
+        }
+
+    }
+
+    std::size_t CSVKeyFilter::size(void) {
+
+        std::size_t keys = 0;
+
+        for (std::size_t shard = 0; shard < kShards; shard++) {
+            std::lock_guard<std::mutex> locker(this->m_shards[shard].mutex);
+            keys += this->m_shards[shard].keys.size();
+        }
+
+        return (keys);
+
+    }
+
+    //
+    // Each key field is preceded by its length so that keys of different
+    // fields can never run together to look the same.
+    //
+
+    void CSVKeyFilter::rowKey(const CSVParser::Fields &fields, const std::vector<std::size_t> &keyColumns, std::string &key) {
+
+        key.clear();
+
+        for (auto column : keyColumns) {
+            std::string_view field { (column < fields.size()) ? fields[column] : std::string_view() };
+            std::uint32_t length = static_cast<std::uint32_t> (field.size());
+            key.append(reinterpret_cast<const char *> (&length), sizeof (length));
+            key.append(field.data(), field.size());
+        }
+
+    }
+
+} // namespace FPE_TaskActions
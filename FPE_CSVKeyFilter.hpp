@@ -0,0 +1,83 @@
+#ifndef FPE_CSVKEYFILTER_HPP
+#define FPE_CSVKEYFILTER_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVKeyFilter class. Set of the key column values of CSV rows seen so
+    // that rows repeating a key can be dropped before they reach the
+    // database. The set is exact so no row is ever dropped in error, and
+    // it holds every key added for as long as it lives. Keys are copied
+    // end to end into large blocks and the set holds views of them so a
+    // key costs its length plus a hash table entry, and keys are looked up
+    // as views without being copied. Keys are split between shards each
+    // with its own lock so that the threads importing ranges of a file
+    // seldom wait on each other.
+    //
+
+    class CSVKeyFilter {
+    public:
+
+        CSVKeyFilter();
+
+        // Add key (false if already present)
+
+        bool insert(std::string_view key);
+
+        // Key present
+
+        bool contains(std::string_view key);
+
+        // Add all keys of another filter
+
+        void merge(CSVKeyFilter &other);
+
+        // Number of keys
+
+        std::size_t size(void);
+
+        // Key of row formed from its key columns (a missing field being empty)
+
+        static void rowKey(const CSVParser::Fields &fields, const std::vector<std::size_t> &keyColumns, std::string &key);
+
+    private:
+
+        struct Shard {
+            std::mutex mutex; // Protects shard
+            std::vector<std::unique_ptr<char[]>> blocks; // Key storage (keys filled into last block)
+            std::size_t blockUsed { 0 }; // Bytes used of last block
+            std::unordered_set<std::string_view> keys; // Views of keys in storage
+        };
+
+        Shard& shard(std::string_view key);
+        static std::string_view store(Shard &shard, std::string_view key);
+
+        std::unique_ptr<Shard[]> m_shards; // Key shards
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVKEYFILTER_HPP */
+
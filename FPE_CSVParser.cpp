@@ -0,0 +1,488 @@
+//
+// Module: FPE_CSVParser
+//
+// Description: CSV parser. Data is scanned 64 bytes at a time producing
+// bit masks of its quotes, delimiters and newlines (using AVX2 or SSE2
+// when the CPU supports them, selected at run time, with a scalar
+// fallback). A prefix XOR of the quote mask gives the bytes that lie
+// inside quotes and the delimiters/newlines outside of them are the field
+// and row ends. Fields are passed back as string_views.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+
+//
+// Linux
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+
+//
+// SIMD intrinsics
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FPE_X86_SIMD
+#endif
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kBlockSize { 64 }; // Bytes scanned per set of masks
+
+    //
+    // Bit masks (bit n for byte n) of the characters of interest in a block
+    //
+
+    struct BlockMasks {
+        std::uint64_t quotes; // Quote characters
+        std::uint64_t delimiters; // Field delimiters
+        std::uint64_t newlines; // '\n'
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Scalar block scan.
+    //
+
+    static void findMasksNone(const char *block, char delimiter, char quote, BlockMasks &masks) {
+
+        masks = {0, 0, 0};
+
+        for (std::size_t index = 0; index < kBlockSize; index++) {
+            std::uint64_t bit = static_cast<std::uint64_t> (1) << index;
+            if (block[index] == quote) {
+                masks.quotes |= bit;
+            } else if (block[index] == delimiter) {
+                masks.delimiters |= bit;
+            } else if (block[index] == '\n') {
+                masks.newlines |= bit;
+            }
+        }
+
+    }
+
+#if defined(FPE_X86_SIMD)
+
+    //
+    // SSE2 block scan (four 16 byte compares per character).
+    //
+
+    __attribute__((target("sse2")))
+    static inline std::uint64_t matchSSE2(const __m128i *block, char character) {
+
+        const __m128i match = _mm_set1_epi8(character);
+
+        std::uint64_t mask0 = static_cast<std::uint32_t> (_mm_movemask_epi8(_mm_cmpeq_epi8(block[0], match)));
+        std::uint64_t mask1 = static_cast<std::uint32_t> (_mm_movemask_epi8(_mm_cmpeq_epi8(block[1], match)));
+        std::uint64_t mask2 = static_cast<std::uint32_t> (_mm_movemask_epi8(_mm_cmpeq_epi8(block[2], match)));
+        std::uint64_t mask3 = static_cast<std::uint32_t> (_mm_movemask_epi8(_mm_cmpeq_epi8(block[3], match)));
+
+        return (mask0 | (mask1 << 16) | (mask2 << 32) | (mask3 << 48));
+
+    }
+
+    __attribute__((target("sse2")))
+    static void findMasksSSE2(const char *block, char delimiter, char quote, BlockMasks &masks) {
+
+        const __m128i data[4] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i *> (block)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *> (block + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *> (block + 32)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *> (block + 48))
+        };
+
+        masks.quotes = matchSSE2(data, quote);
+        masks.delimiters = matchSSE2(data, delimiter);
+        masks.newlines = matchSSE2(data, '\n');
+
+    }
+
+    //
+    // AVX2 version of the above (two 32 byte compares per character).
+    //
+
+    __attribute__((target("avx2")))
+    static inline std::uint64_t matchAVX2(const __m256i *block, char character) {
+
+        const __m256i match = _mm256_set1_epi8(character);
+
+        std::uint64_t mask0 = static_cast<std::uint32_t> (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block[0], match)));
+        std::uint64_t mask1 = static_cast<std::uint32_t> (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block[1], match)));
+
+        return (mask0 | (mask1 << 32));
+
+    }
+
+    __attribute__((target("avx2")))
+    static void findMasksAVX2(const char *block, char delimiter, char quote, BlockMasks &masks) {
+
+        const __m256i data[2] = {
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *> (block)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *> (block + 32))
+        };
+
+        masks.quotes = matchAVX2(data, quote);
+        masks.delimiters = matchAVX2(data, delimiter);
+        masks.newlines = matchAVX2(data, '\n');
+
+    }
+
+#endif // FPE_X86_SIMD
+
+    //
+    // Pick best block scan for this CPU.
+    //
+
+    using FindMasksFn = void (*)(const char *, char, char, BlockMasks &);
+
+    static FindMasksFn selectFindMasks(void) {
+
+#if defined(FPE_X86_SIMD)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return (findMasksAVX2);
+        } else if (__builtin_cpu_supports("sse2")) {
+            return (findMasksSSE2);
+        }
+#endif
+
+        return (findMasksNone);
+
+    }
+
+    static const FindMasksFn findMasks { selectFindMasks() };
+
+    //
+    // Bit n of result is the XOR of bits 0..n (so with a quote mask, set for
+    // every byte from an opening quote up to but not including its closing
+    // quote).
+    //
+
+    static inline std::uint64_t prefixXOR(std::uint64_t bits) {
+
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+
+        return (bits);
+
+    }
+
+    //
+    // Remove quotes from field ("" inside quotes being a quote) appending
+    // the result to the unquoted buffer. The buffer has been reserved for the
+    // whole row so earlier fields' views stay valid.
+    //
+
+    std::string_view CSVParser::unquote(std::string_view field) {
+
+        std::size_t start = this->m_unquoted.size();
+        bool bInQuotes = false;
+
+        for (std::size_t index = 0; index < field.size(); index++) {
+            if (field[index] != this->m_quote) {
+                this->m_unquoted += field[index];
+            } else if (bInQuotes && (index + 1 < field.size()) && (field[index + 1] == this->m_quote)) {
+                this->m_unquoted += this->m_quote;
+                index++;
+            } else {
+                bInQuotes = !bInQuotes;
+            }
+        }
+
+        return (std::string_view(this->m_unquoted.data() + start, this->m_unquoted.size() - start));
+
+    }
+
+    //
+    // Pass the (selected) fields of the row just ended to the row function
+    // (dropping any \r before its newline and skipping blank lines).
+    //
+
+    void CSVParser::endRow(const char *data, bool bQuotes, const RowFn &rowFn, std::size_t rowStart, std::size_t rowEnd,
+            std::size_t columns) {
+
+        if ((columns == 1) && ((rowEnd == rowStart) || ((rowEnd == rowStart + 1) && (data[rowStart] == '\r')))) {
+            this->m_bounds.clear();
+            return;
+        }
+
+        if (!this->m_bounds.empty()) {
+            auto &lastField = this->m_bounds.back();
+            if ((lastField.second == rowEnd) && (lastField.second > lastField.first) && (data[lastField.second - 1] == '\r')) {
+                lastField.second--;
+            }
+        }
+
+        this->m_fields.clear();
+
+        if (bQuotes) {
+            this->m_unquoted.clear();
+            this->m_unquoted.reserve(rowEnd - rowStart);
+        }
+
+        for (auto &bounds : this->m_bounds) {
+            std::string_view field(data + bounds.first, bounds.second - bounds.first);
+            if (bQuotes && (field.find(this->m_quote) != std::string_view::npos)) {
+                field = this->unquote(field);
+            }
+            this->m_fields.push_back(field);
+        }
+
+        this->m_bounds.clear();
+
+        rowFn(this->m_fields, rowStart);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    CSVParser::CSVParser(char delimiter, char quote) : m_delimiter{delimiter}, m_quote{quote} {
+
+        if ((delimiter == quote) || (delimiter == '\n') || (quote == '\n')) {
+            throw Exception("Invalid delimiter/quote.");
+        }
+
+    }
+
+    //
+    // Scan data a block at a time (the last partial block copied into a
+    // padded buffer) keeping whether the previous block ended inside quotes.
+    // Each row is only checked for quotes to remove if a block it lies in
+    // contains one. Columns not selected are counted but their bounds are
+    // not recorded so they are never unquoted or passed on.
+    //
+
+    std::size_t CSVParser::parse(const char *data, std::size_t length, bool bLast, const RowFn &rowFn) {
+
+        std::size_t rowStart = 0;
+        std::size_t fieldStart = 0;
+        std::size_t column = 0;
+        std::uint64_t inQuotes = 0;
+        bool bQuotes = false;
+        char padded[kBlockSize];
+        BlockMasks masks;
+
+        this->m_bounds.clear();
+
+        for (std::size_t block = 0; block < length; block += kBlockSize) {
+
+            const char *blockData = data + block;
+
+            if (length - block < kBlockSize) {
+                std::memset(padded, 0, kBlockSize);
+                std::memcpy(padded, blockData, length - block);
+                blockData = padded;
+            }
+
+            findMasks(blockData, this->m_delimiter, this->m_quote, masks);
+
+            std::uint64_t quoted = prefixXOR(masks.quotes) ^ inQuotes;
+            std::uint64_t separators = (masks.delimiters | masks.newlines) & ~quoted;
+
+            inQuotes = static_cast<std::uint64_t> (static_cast<std::int64_t> (quoted) >> 63);
+            bQuotes = bQuotes || (masks.quotes != 0);
+
+            while (separators) {
+
+                unsigned bit = __builtin_ctzll(separators);
+                std::size_t position = block + bit;
+
+                separators &= separators - 1;
+
+                if (this->selected(column++)) {
+                    this->m_bounds.emplace_back(fieldStart, position);
+                }
+
+                fieldStart = position + 1;
+
+                if (blockData[bit] == '\n') {
+                    this->endRow(data, bQuotes, rowFn, rowStart, position, column);
+                    rowStart = fieldStart;
+                    column = 0;
+                    bQuotes = (masks.quotes & ~((static_cast<std::uint64_t> (2) << bit) - 1)) != 0;
+                }
+
+            }
+
+        }
+
+        if (bLast && (rowStart < length)) {
+            if (this->selected(column++)) {
+                this->m_bounds.emplace_back(fieldStart, length);
+            }
+            this->endRow(data, bQuotes, rowFn, rowStart, length, column);
+            rowStart = length;
+        }
+
+        this->m_bounds.clear();
+
+        return (rowStart);
+
+    }
+
+    //
+    // Blocks before the next offset only need the count of their quotes to
+    // keep track of whether a block starts inside quotes; the block holding
+    // an offset's row start is looked at in full.
+    //
+
+    std::vector<std::size_t> CSVParser::rowStarts(const char *data, std::size_t length, const std::vector<std::size_t> &offsets) const {
+
+        std::vector<std::size_t> starts;
+        std::uint64_t inQuotes = 0;
+        char padded[kBlockSize];
+        BlockMasks masks;
+        auto offset = offsets.begin();
+
+        for (; (offset != offsets.end()) && (*offset == 0); offset++) {
+            starts.push_back(0);
+        }
+
+        for (std::size_t block = 0; (block < length) && (offset != offsets.end()); block += kBlockSize) {
+
+            const char *blockData = data + block;
+
+            if (length - block < kBlockSize) {
+                std::memset(padded, 0, kBlockSize);
+                std::memcpy(padded, blockData, length - block);
+                blockData = padded;
+            }
+
+            findMasks(blockData, this->m_delimiter, this->m_quote, masks);
+
+            // Row starts after a newline at or after offset - 1
+
+            while ((offset != offsets.end()) && (*offset - 1 < block + kBlockSize)) {
+                std::uint64_t quoted = prefixXOR(masks.quotes) ^ inQuotes;
+                std::uint64_t newlines = masks.newlines & ~quoted;
+                if (*offset - 1 > block) {
+                    newlines &= ~((static_cast<std::uint64_t> (1) << (*offset - 1 - block)) - 1);
+                }
+                if (!newlines) {
+                    break;
+                }
+                std::size_t start = block + __builtin_ctzll(newlines) + 1;
+                for (; (offset != offsets.end()) && (*offset <= start); offset++) {
+                    starts.push_back(start);
+                }
+            }
+
+            if (__builtin_popcountll(masks.quotes) & 1) {
+                inQuotes = ~inQuotes;
+            }
+
+        }
+
+        starts.resize(offsets.size(), length);
+
+        return (starts);
+
+    }
+
+    //
+    // Columns are kept as a flag per column up to the last selected.
+    //
+
+    void CSVParser::select(const std::vector<std::size_t> &columns) {
+
+        this->m_selected.clear();
+
+        for (auto column : columns) {
+            if (column >= this->m_selected.size()) {
+                this->m_selected.resize(column + 1, false);
+            }
+            this->m_selected[column] = true;
+        }
+
+        this->m_bSelection = !columns.empty();
+
+    }
+
+    void CSVParser::parseFile(const std::string &fileName, const RowFn &rowFn) {
+
+        MappedFile csvFile(fileName);
+
+        this->parse(csvFile.data(), csvFile.size(), true, rowFn);
+
+    }
+
+    //
+    // Map whole file read only (an empty file is not mapped).
+    //
+
+    MappedFile::MappedFile(const std::string &fileName) {
+
+        int fileFd = ::open(fileName.c_str(), O_RDONLY);
+        struct stat fileStat {};
+
+        if (fileFd == -1) {
+            throw CSVParser::Exception("Could not open [" + fileName + "]: " + std::strerror(errno));
+        }
+
+        if (fstat(fileFd, &fileStat) == -1) {
+            int error = errno;
+            ::close(fileFd);
+            throw CSVParser::Exception("Could not stat [" + fileName + "]: " + std::strerror(error));
+        }
+
+        if (fileStat.st_size > 0) {
+            void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileFd, 0);
+            if (mapping == MAP_FAILED) {
+                int error = errno;
+                ::close(fileFd);
+                throw CSVParser::Exception("Could not map [" + fileName + "]: " + std::strerror(error));
+            }
+            madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+            this->m_data = static_cast<const char *> (mapping);
+            this->m_size = fileStat.st_size;
+        }
+
+        ::close(fileFd);
+
+    }
+
+    MappedFile::~MappedFile() {
+
+        if (this->m_data) {
+            munmap(const_cast<char *> (this->m_data), this->m_size);
+        }
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,133 @@
+#ifndef FPE_CSVPARSER_HPP
+#define FPE_CSVPARSER_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVParser class. Split CSV data into rows of fields (RFC 4180: fields
+    // may be quoted, a quoted field may contain delimiters, newlines and ""
+    // for a quote). Quotes, delimiters and newlines are found 64 bytes at a
+    // time as bit masks (AVX2 or SSE2 where the CPU supports them) and the
+    // fields passed back are views into the data (or into a buffer reused
+    // for fields that need their quotes removing) so nothing is allocated
+    // per field. Lines may end in \n or \r\n; blank lines are skipped.
+    //
+
+    class CSVParser {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVParser Failure: " + message) {
+            }
+
+        };
+
+        using Fields = std::vector<std::string_view>;
+
+        // Row function passed the fields of a row (only valid for the call)
+        // and the offset of the row from the start of the data parsed.
+
+        using RowFn = std::function<void(const Fields &, std::size_t)>;
+
+        explicit CSVParser(char delimiter = ',', char quote = '"');
+
+        // Parse complete rows of data returning the number of bytes used (the
+        // start of any incomplete last row). If bLast is set no more data
+        // follows so a last row without a newline is complete.
+
+        std::size_t parse(const char *data, std::size_t length, bool bLast, const RowFn &rowFn);
+
+        // Parse whole file (memory mapped)
+
+        void parseFile(const std::string &fileName, const RowFn &rowFn);
+
+        // Start of the first row beginning at or after each of a list of
+        // ascending offsets into data (length if there is none). Newlines
+        // inside quotes are not row ends so the data is scanned from its
+        // start, a block at a time.
+
+        std::vector<std::size_t> rowStarts(const char *data, std::size_t length, const std::vector<std::size_t> &offsets) const;
+
+        // Only pass on the fields of a set of columns (in column order; empty
+        // for all columns). Other fields are skipped over without being
+        // unquoted or given a view.
+
+        void select(const std::vector<std::size_t> &columns);
+
+    private:
+
+        CSVParser(const CSVParser&) = delete;
+        CSVParser& operator=(const CSVParser&) = delete;
+
+        void endRow(const char *data, bool bQuotes, const RowFn &rowFn, std::size_t rowStart, std::size_t rowEnd,
+                std::size_t columns);
+        std::string_view unquote(std::string_view field);
+
+        bool selected(std::size_t column) const {
+            return (!this->m_bSelection || ((column < this->m_selected.size()) && this->m_selected[column]));
+        }
+
+        char m_delimiter; // Field delimiter
+        char m_quote; // Quote character
+
+        std::vector<std::pair<std::size_t, std::size_t>> m_bounds; // Current row field start/end offsets
+        Fields m_fields; // Current row fields
+        std::string m_unquoted; // Unquoted field values of current row
+        std::vector<bool> m_selected; // Column selected (up to last selected)
+        bool m_bSelection { false }; // Only selected columns passed on
+
+    };
+
+    //
+    // MappedFile class. Read only memory mapping of a whole file.
+    //
+
+    class MappedFile {
+    public:
+
+        explicit MappedFile(const std::string &fileName);
+
+        ~MappedFile();
+
+        const char *data(void) const {
+            return (this->m_data);
+        }
+
+        std::size_t size(void) const {
+            return (this->m_size);
+        }
+
+    private:
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char *m_data { nullptr }; // Start of mapping
+        std::size_t m_size { 0 }; // File size
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVPARSER_HPP */
+
@@ -0,0 +1,198 @@
+//
+// Module: FPE_CSVRowFilter
+//
+// Description: Row filter predicates for CSV import.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <charconv>
+#include <algorithm>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVRowFilter.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Text is a number in its entirety.
+    //
+
+    static bool toNumber(std::string_view text, double &number) {
+
+        if (text.empty()) {
+            return (false);
+        }
+
+        if (text.front() == '+') {
+            text.remove_prefix(1);
+        }
+
+        auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+
+        return ((result.ec == std::errc()) && (result.ptr == text.data() + text.size()));
+
+    }
+
+    //
+    // Result of comparison (negative, zero or positive) against operator.
+    //
+
+    template <typename Operator>
+    static bool compared(int comparison, Operator comparisonOperator) {
+
+        switch (comparisonOperator) {
+            case Operator::equal:
+                return (comparison == 0);
+            case Operator::notEqual:
+                return (comparison != 0);
+            case Operator::less:
+                return (comparison < 0);
+            case Operator::lessEqual:
+                return (comparison <= 0);
+            case Operator::greater:
+                return (comparison > 0);
+            default:
+                return (comparison >= 0);
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // The operator is the first of = ! < > in a predicate (so a column name
+    // cannot contain these).
+    //
+
+    CSVRowFilter::CSVRowFilter(const std::vector<std::string> &fieldNames, const std::string &filter) {
+
+        std::size_t start = 0;
+
+        while (start < filter.size()) {
+
+            std::size_t end = filter.find(',', start);
+            std::string entry { filter.substr(start, (end == std::string::npos) ? std::string::npos : end - start) };
+            std::size_t operatorStart = entry.find_first_of("=!<>");
+            Predicate predicate;
+
+            start = (end == std::string::npos) ? filter.size() : end + 1;
+
+            if (entry.empty()) {
+                continue;
+            }
+
+            if ((operatorStart == std::string::npos) || (operatorStart == 0)) {
+                throw Exception("Invalid filter predicate [" + entry + "].");
+            }
+
+            std::string operatorText { entry.substr(operatorStart, (entry.compare(operatorStart + 1, 1, "=") == 0) ? 2 : 1) };
+
+            if (operatorText == "=" || operatorText == "==") {
+                predicate.comparison = Operator::equal;
+            } else if (operatorText == "!=") {
+                predicate.comparison = Operator::notEqual;
+            } else if (operatorText == "<") {
+                predicate.comparison = Operator::less;
+            } else if (operatorText == "<=") {
+                predicate.comparison = Operator::lessEqual;
+            } else if (operatorText == ">") {
+                predicate.comparison = Operator::greater;
+            } else if (operatorText == ">=") {
+                predicate.comparison = Operator::greaterEqual;
+            } else {
+                throw Exception("Invalid filter predicate [" + entry + "].");
+            }
+
+            std::string fieldName { entry.substr(0, operatorStart) };
+            auto column = std::find(fieldNames.begin(), fieldNames.end(), fieldName);
+
+            if (column == fieldNames.end()) {
+                throw Exception("Filter column [" + fieldName + "] not in CSV header.");
+            }
+
+            predicate.column = predicate.position = column - fieldNames.begin();
+            predicate.text = entry.substr(operatorStart + operatorText.size());
+            predicate.bNumber = toNumber(predicate.text, predicate.number);
+
+            this->m_predicates.push_back(predicate);
+
+        }
+
+    }
+
+    std::vector<std::size_t> CSVRowFilter::columns(void) const {
+
+        std::vector<std::size_t> columns;
+
+        for (auto &predicate : this->m_predicates) {
+            columns.push_back(predicate.column);
+        }
+
+        return (columns);
+
+    }
+
+    void CSVRowFilter::select(const std::vector<std::size_t> &selection) {
+
+        for (auto &predicate : this->m_predicates) {
+            predicate.position = std::lower_bound(selection.begin(), selection.end(), predicate.column) - selection.begin();
+        }
+
+    }
+
+    //
+    // A field missing from a short row is taken as empty.
+    //
+
+    bool CSVRowFilter::matches(const CSVParser::Fields &fields) const {
+
+        for (auto &predicate : this->m_predicates) {
+
+            std::string_view field { (predicate.position < fields.size()) ? fields[predicate.position] : std::string_view() };
+            int comparison;
+
+            if (predicate.bNumber) {
+                double number;
+                if (!toNumber(field, number)) {
+                    if (predicate.comparison != Operator::notEqual) {
+                        return (false);
+                    }
+                    continue;
+                }
+                comparison = (number < predicate.number) ? -1 : (number > predicate.number) ? 1 : 0;
+            } else {
+                comparison = field.compare(predicate.text);
+            }
+
+            if (!compared(comparison, predicate.comparison)) {
+                return (false);
+            }
+
+        }
+
+        return (true);
+
+    }
+
+} // namespace FPE_TaskActions
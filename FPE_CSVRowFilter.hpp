@@ -0,0 +1,87 @@
+#ifndef FPE_CSVROWFILTER_HPP
+#define FPE_CSVROWFILTER_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVRowFilter class. Simple predicates on the fields of CSV rows that
+    // a row must meet all of to be imported. A predicate compares a column
+    // with a value (=, !=, <, <=, > or >=); the comparison is numeric when
+    // the value is a number (a field that is not then fails all but !=)
+    // and of the text otherwise.
+    //
+
+    class CSVRowFilter {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVRowFilter Failure: " + message) {
+            }
+
+        };
+
+        // Filter is a comma separated list of predicates "name<op>value" on
+        // the columns named by the header
+
+        CSVRowFilter(const std::vector<std::string> &fieldNames, const std::string &filter);
+
+        // Columns tested by the predicates
+
+        std::vector<std::size_t> columns(void) const;
+
+        // Rows will be passed with only the selected columns (ascending)
+        // which must include those tested
+
+        void select(const std::vector<std::size_t> &selection);
+
+        // Row meets all predicates
+
+        bool matches(const CSVParser::Fields &fields) const;
+
+    private:
+
+        enum class Operator {
+            equal = 0, notEqual, less, lessEqual, greater, greaterEqual
+        };
+
+        struct Predicate {
+            std::size_t column { 0 }; // Column tested
+            std::size_t position { 0 }; // Position of column in fields passed
+            Operator comparison { Operator::equal }; // Comparison
+            std::string text; // Value
+            double number { 0.0 }; // Value as a number
+            bool bNumber { false }; // Value is a number
+        };
+
+        std::vector<Predicate> m_predicates; // Predicates (all must be met)
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVROWFILTER_HPP */
+
@@ -0,0 +1,428 @@
+//
+// Module: FPE_CSVSchema
+//
+// Description: Column types for CSV import, given or inferred from a
+// sample of rows, and conversion of fields to typed values.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <charconv>
+#include <cctype>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVSchema.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // Types that may be inferred in order of preference
+    //
+
+    constexpr CSVSchema::Type kInferredTypes[] {
+        CSVSchema::Type::int64, CSVSchema::Type::real, CSVSchema::Type::boolean, CSVSchema::Type::date
+    };
+
+    constexpr unsigned kAllInferredTypes {
+        (1u << static_cast<unsigned> (CSVSchema::Type::int64)) | (1u << static_cast<unsigned> (CSVSchema::Type::real)) |
+        (1u << static_cast<unsigned> (CSVSchema::Type::boolean)) | (1u << static_cast<unsigned> (CSVSchema::Type::date))
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Number from a fixed count of digits at a position in field.
+    //
+
+    static bool digits(std::string_view field, std::size_t position, std::size_t count, int &number) {
+
+        if (position + count > field.size()) {
+            return (false);
+        }
+
+        number = 0;
+
+        for (std::size_t index = position; index < position + count; index++) {
+            if (!std::isdigit(static_cast<unsigned char> (field[index]))) {
+                return (false);
+            }
+            number = number * 10 + (field[index] - '0');
+        }
+
+        return (true);
+
+    }
+
+    //
+    // Days since 1970-01-01 of a (proleptic Gregorian) date (H. Hinnant).
+    //
+
+    static std::int64_t daysFromCivil(int year, int month, int day) {
+
+        year -= (month <= 2);
+
+        const int era = ((year >= 0) ? year : year - 399) / 400;
+        const int yearOfEra = year - era * 400;
+        const int dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+        return (static_cast<std::int64_t> (era) * 146097 + dayOfEra - 719468);
+
+    }
+
+    //
+    // A number with a leading zero (other than zero itself and decimals such
+    // as 0.5) is an identifier such as a zip code so not a number.
+    //
+
+    static bool leadingZero(std::string_view field) {
+
+        if (!field.empty() && (field.front() == '-')) {
+            field.remove_prefix(1);
+        }
+
+        return ((field.size() > 1) && (field[0] == '0') && std::isdigit(static_cast<unsigned char> (field[1])));
+
+    }
+
+    //
+    // Field converts to type.
+    //
+
+    static bool fieldIsType(std::string_view field, CSVSchema::Type type) {
+
+        std::int64_t integer;
+        double real;
+
+        switch (type) {
+            case CSVSchema::Type::int64:
+                return (CSVSchema::toInt64(field, integer));
+            case CSVSchema::Type::real:
+                return (CSVSchema::toDouble(field, real));
+            case CSVSchema::Type::boolean:
+                return (CSVSchema::toBoolean(field, integer));
+            case CSVSchema::Type::date:
+                return (CSVSchema::toDate(field, integer));
+            default:
+                return (true);
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Schema is a comma separated list of "name:type" ("infer" or empty for
+    // all columns to be inferred).
+    //
+
+    CSVSchema::CSVSchema(const std::vector<std::string> &fieldNames, const std::string &schema) :
+        m_columns(fieldNames.size()) {
+
+        for (auto &column : this->m_columns) {
+            column.bInferred = true;
+            column.candidates = kAllInferredTypes;
+        }
+
+        if (schema.empty() || (schema == "infer")) {
+            return;
+        }
+
+        std::size_t start = 0;
+
+        while (start <= schema.size()) {
+
+            std::size_t end = schema.find(',', start);
+            std::string entry { schema.substr(start, (end == std::string::npos) ? std::string::npos : end - start) };
+            std::size_t colon = entry.rfind(':');
+
+            if (colon == std::string::npos) {
+                throw Exception("Invalid schema entry [" + entry + "].");
+            }
+
+            std::string fieldName { entry.substr(0, colon) };
+            std::size_t column = 0;
+
+            for (; (column < fieldNames.size()) && (fieldNames[column] != fieldName); column++) {
+            }
+
+            if (column == fieldNames.size()) {
+                throw Exception("Schema field [" + fieldName + "] not in CSV header.");
+            }
+
+            this->m_columns[column].type = typeFromName(entry.substr(colon + 1));
+            this->m_columns[column].bInferred = false;
+
+            if (end == std::string::npos) {
+                break;
+            }
+
+            start = end + 1;
+
+        }
+
+    }
+
+    //
+    // Remove types a sample value does not convert to from its column's
+    // possible types.
+    //
+
+    void CSVSchema::sample(const CSVParser::Fields &fields) {
+
+        for (std::size_t column = 0; (column < fields.size()) && (column < this->m_columns.size()); column++) {
+
+            Column &current = this->m_columns[column];
+
+            if (!current.bInferred || !current.candidates || fields[column].empty()) {
+                continue;
+            }
+
+            for (auto type : kInferredTypes) {
+                unsigned typeBit = 1u << static_cast<unsigned> (type);
+                if ((current.candidates & typeBit) && !fieldIsType(fields[column], type)) {
+                    current.candidates &= ~typeBit;
+                }
+            }
+
+        }
+
+    }
+
+    void CSVSchema::fix(void) {
+
+        for (auto &column : this->m_columns) {
+            if (column.bInferred) {
+                column.type = Type::string;
+                if (column.candidates != kAllInferredTypes) {
+                    for (auto type : kInferredTypes) {
+                        if (column.candidates & (1u << static_cast<unsigned> (type))) {
+                            column.type = type;
+                            break;
+                        }
+                    }
+                }
+                column.bInferred = false;
+            }
+        }
+
+    }
+
+    CSVSchema::Type CSVSchema::type(std::size_t column) const {
+
+        return ((column < this->m_columns.size()) ? this->m_columns[column].type : Type::string);
+
+    }
+
+    void CSVSchema::convert(std::size_t column, std::string_view field, Value &value) const {
+
+        if (field.empty()) {
+            value.type = Type::null;
+            return;
+        }
+
+        value.type = this->type(column);
+
+        switch (value.type) {
+            case Type::int64:
+                if (toInt64(field, value.integer)) {
+                    return;
+                }
+                break;
+            case Type::real:
+                if (toDouble(field, value.real)) {
+                    return;
+                }
+                break;
+            case Type::boolean:
+                if (toBoolean(field, value.integer)) {
+                    return;
+                }
+                break;
+            case Type::date:
+                if (toDate(field, value.integer)) {
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+
+        value.type = Type::string;
+        value.text = field;
+
+    }
+
+    CSVSchema::Type CSVSchema::typeFromName(const std::string &typeName) {
+
+        if (typeName == "string") {
+            return (Type::string);
+        } else if (typeName == "int64") {
+            return (Type::int64);
+        } else if (typeName == "double") {
+            return (Type::real);
+        } else if (typeName == "bool") {
+            return (Type::boolean);
+        } else if (typeName == "date") {
+            return (Type::date);
+        }
+
+        throw Exception("Invalid type [" + typeName + "] (string, int64, double, bool or date).");
+
+    }
+
+    bool CSVSchema::toInt64(std::string_view field, std::int64_t &integer) {
+
+        if (leadingZero(field)) {
+            return (false);
+        }
+
+        auto result = std::from_chars(field.data(), field.data() + field.size(), integer);
+
+        return ((result.ec == std::errc()) && (result.ptr == field.data() + field.size()));
+
+    }
+
+    bool CSVSchema::toDouble(std::string_view field, double &real) {
+
+        if (leadingZero(field) || (field.find_first_not_of("0123456789+-.eE") != std::string_view::npos) ||
+                (field.find_first_of("0123456789") == std::string_view::npos)) {
+            return (false);
+        }
+
+        auto result = std::from_chars(field.data(), field.data() + field.size(), real);
+
+        return ((result.ec == std::errc()) && (result.ptr == field.data() + field.size()));
+
+    }
+
+    bool CSVSchema::toBoolean(std::string_view field, std::int64_t &boolean) {
+
+        std::string lower;
+
+        if ((field.size() != 4) && (field.size() != 5)) {
+            return (false);
+        }
+
+        for (auto character : field) {
+            lower += std::tolower(static_cast<unsigned char> (character));
+        }
+
+        if ((lower == "true") || (lower == "false")) {
+            boolean = (lower == "true");
+            return (true);
+        }
+
+        return (false);
+
+    }
+
+    //
+    // ISO 8601 date YYYY-MM-DD optionally followed by a time (T or space
+    // separated) HH:MM[:SS[.fraction]] and a zone (Z, +HH:MM, +HHMM or +HH);
+    // a time without a zone is taken as UTC.
+    //
+
+    bool CSVSchema::toDate(std::string_view field, std::int64_t &milliseconds) {
+
+        int year, month, day, hour = 0, minute = 0, second = 0, millisecond = 0;
+        std::size_t position = 10;
+
+        if (!digits(field, 0, 4, year) || (field.size() < 10) || (field[4] != '-') || (field[7] != '-') ||
+                !digits(field, 5, 2, month) || !digits(field, 8, 2, day)) {
+            return (false);
+        }
+
+        static const int daysInMonth[] { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        bool bLeapYear = ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+
+        if ((month < 1) || (month > 12) || (day < 1) || (day > daysInMonth[month - 1]) ||
+                ((month == 2) && (day == 29) && !bLeapYear)) {
+            return (false);
+        }
+
+        if (position < field.size()) {
+
+            if (((field[position] != 'T') && (field[position] != ' ')) || !digits(field, position + 1, 2, hour) ||
+                    (position + 3 >= field.size()) || (field[position + 3] != ':') || !digits(field, position + 4, 2, minute)) {
+                return (false);
+            }
+
+            position += 6;
+
+            if ((position < field.size()) && (field[position] == ':')) {
+                if (!digits(field, position + 1, 2, second)) {
+                    return (false);
+                }
+                position += 3;
+                if ((position < field.size()) && (field[position] == '.')) {
+                    int scale = 100, digit;
+                    for (position++; (position < field.size()) && digits(field, position, 1, digit); position++) {
+                        millisecond += digit * scale;
+                        scale /= 10;
+                    }
+                }
+            }
+
+            if ((hour > 23) || (minute > 59) || (second > 60)) {
+                return (false);
+            }
+
+            if ((position < field.size()) && (field[position] == 'Z')) {
+                position++;
+            } else if ((position < field.size()) && ((field[position] == '+') || (field[position] == '-'))) {
+                int sign = (field[position] == '+') ? 1 : -1;
+                int zoneHours, zoneMinutes = 0;
+                if (!digits(field, position + 1, 2, zoneHours)) {
+                    return (false);
+                }
+                position += 3;
+                if ((position < field.size()) && (field[position] == ':')) {
+                    position++;
+                }
+                if (position < field.size()) {
+                    if (!digits(field, position, 2, zoneMinutes)) {
+                        return (false);
+                    }
+                    position += 2;
+                }
+                hour -= sign * zoneHours;
+                minute -= sign * zoneMinutes;
+            }
+
+        }
+
+        if (position != field.size()) {
+            return (false);
+        }
+
+        milliseconds = ((daysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60 + second;
+        milliseconds = milliseconds * 1000 + millisecond;
+
+        return (true);
+
+    }
+
+} // namespace FPE_TaskActions
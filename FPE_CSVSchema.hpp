@@ -0,0 +1,115 @@
+#ifndef FPE_CSVSCHEMA_HPP
+#define FPE_CSVSCHEMA_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVSchema class. Type of each column of a CSV file either given as a
+    // list of "name:type" or inferred from a sample of rows (the narrowest
+    // of int64, double, bool and ISO 8601 date that every non-empty sample
+    // value converts to, otherwise string). Fields are converted to typed
+    // values; a field that does not convert to its column's type is kept
+    // as a string and an empty field is null.
+    //
+
+    class CSVSchema {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVSchema Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Column/value types
+        //
+
+        enum class Type {
+            string = 0, int64, real, boolean, date, null
+        };
+
+        //
+        // Typed field value (text refers to the field)
+        //
+
+        struct Value {
+            Type type { Type::null }; // Value type
+            std::int64_t integer { 0 }; // int64, bool (0/1) or date (milliseconds since epoch)
+            double real { 0.0 }; // double
+            std::string_view text; // string
+        };
+
+        // Columns named by header; types from schema list (may be empty)
+        // with any not listed to be inferred
+
+        CSVSchema(const std::vector<std::string> &fieldNames, const std::string &schema);
+
+        // Narrow inferred column types to fit a sample row
+
+        void sample(const CSVParser::Fields &fields);
+
+        // Column type (string until inferred types are fixed)
+
+        Type type(std::size_t column) const;
+
+        // Fix column types (inferred columns with no sample values are strings)
+
+        void fix(void);
+
+        // Convert field of column to typed value
+
+        void convert(std::size_t column, std::string_view field, Value &value) const;
+
+        // Type name to type (throws if not valid)
+
+        static Type typeFromName(const std::string &typeName);
+
+        // Field conversions (false if field not of type)
+
+        static bool toInt64(std::string_view field, std::int64_t &integer);
+        static bool toDouble(std::string_view field, double &real);
+        static bool toBoolean(std::string_view field, std::int64_t &boolean);
+        static bool toDate(std::string_view field, std::int64_t &milliseconds);
+
+    private:
+
+        struct Column {
+            Type type { Type::string }; // Column type
+            bool bInferred { false }; // Type to be inferred
+            unsigned candidates { 0 }; // Inferred types still possible (bit per type)
+        };
+
+        std::vector<Column> m_columns; // Columns
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVSCHEMA_HPP */
+
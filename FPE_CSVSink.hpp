@@ -0,0 +1,119 @@
+#ifndef FPE_CSVSINK_HPP
+#define FPE_CSVSINK_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVParser.hpp"
+#include "FPE_CSVSchema.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // CSVSink class. Database that CSV rows are imported into. A sink
+    // hands out a writer for each thread importing part of a file; rows
+    // are added to a batch that the writer then writes to the database as
+    // a whole. A batch may be built while the last is being written.
+    //
+
+    class CSVSink {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("CSVSink Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Batch of rows
+        //
+
+        class Batch {
+        public:
+
+            virtual ~Batch() {
+            };
+
+            // Add row (with an id unless empty in which case the database
+            // assigns one). Fields beyond the number of field names are ignored.
+
+            virtual void add(const CSVParser::Fields &fields, std::string_view id) = 0;
+
+            // Rows in batch and their size in bytes once encoded
+
+            virtual std::size_t rows(void) const = 0;
+            virtual std::size_t bytes(void) const = 0;
+
+        };
+
+        //
+        // Writer of batches (one per importing thread)
+        //
+
+        class Writer {
+        public:
+
+            virtual ~Writer() {
+            };
+
+            // New empty batch (may be called while a batch is being written)
+
+            virtual std::unique_ptr<Batch> batch(void) = 0;
+
+            // Write batch returning once the database has acknowledged it
+            // (rows whose id is already present are ignored, rows with
+            // upsert keys are upserted). Throws on failure.
+
+            virtual void write(Batch &batch) = 0;
+
+        };
+
+        //
+        // Rows being written
+        //
+
+        struct Table {
+            std::vector<std::string> fieldNames; // Field names
+            const CSVSchema *schema { nullptr }; // Column types (null for all strings)
+            std::vector<std::size_t> upsertKeys; // Key columns rows are upserted on (empty to insert)
+        };
+
+        virtual ~CSVSink() {
+        };
+
+        // Writer for rows of table. When it has upsert keys a row replaces
+        // any existing row with the same key values.
+
+        virtual std::unique_ptr<Writer> writer(const Table &table) = 0;
+
+        // Description of where rows go (for messages)
+
+        virtual std::string name(void) const = 0;
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_CSVSINK_HPP */
+
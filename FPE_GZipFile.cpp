@@ -0,0 +1,146 @@
+//
+// Module: FPE_GZipFile
+//
+// Description: Gzip compress a file into a temporary directory so that it
+// can be sent in its place (for example as a smaller email attachment).
+// Only one block of the file is held in memory at a time.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// zlib               : gzip compression.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <fstream>
+#include <vector>
+#include <filesystem>
+#include <cstdlib>
+
+//
+// zlib
+//
+
+#include <zlib.h>
+
+//
+// Program components.
+//
+
+#include "FPE_GZipFile.hpp"
+
+namespace FPE_TaskActions {
+
+    // =======
+    // IMPORTS
+    // =======
+
+    namespace fs = std::filesystem;
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kBlockSize { 128 * 1024 }; // Bytes read per block
+
+    //
+    // MIME types whose content is already compressed.
+    //
+
+    static const char *kCompressedTypePrefixes[] = {
+        "image/jpeg", "image/png", "image/gif", "image/webp", "image/heic", "image/avif",
+        "video/", "audio/mpeg", "audio/mp4", "audio/aac", "audio/ogg", "audio/flac", "audio/webm",
+        "application/zip", "application/gzip", "application/x-gzip", "application/x-bzip",
+        "application/x-xz", "application/x-7z-compressed", "application/x-rar", "application/vnd.rar",
+        "application/zstd", "application/x-compress", "application/java-archive", "application/epub+zip",
+        "application/vnd.openxmlformats-officedocument.", "application/vnd.oasis.opendocument."
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Compress source file into a new temporary directory.
+    //
+
+    GZipFile::GZipFile(const std::string &sourceFile, int level) {
+
+        std::ifstream sourceStream(sourceFile, std::ios::binary);
+
+        if (!sourceStream) {
+            throw Exception("Could not open [" + sourceFile + "]");
+        }
+
+        std::string directoryTemplate { (fs::temp_directory_path() / "fpe_gzip_XXXXXX").string() };
+
+        if (mkdtemp(&directoryTemplate[0]) == nullptr) {
+            throw Exception("Could not create temporary directory.");
+        }
+
+        this->m_directory = directoryTemplate;
+        this->m_fileName = (fs::path(this->m_directory) / (fs::path(sourceFile).filename().string() + ".gz")).string();
+
+        gzFile gzipFile = gzopen(this->m_fileName.c_str(), ("wb" + std::to_string(level)).c_str());
+
+        if (gzipFile == nullptr) {
+            fs::remove_all(this->m_directory);
+            throw Exception("Could not create [" + this->m_fileName + "]");
+        }
+
+        std::vector<char> block(kBlockSize);
+        bool bWritten = true;
+
+        gzbuffer(gzipFile, kBlockSize);
+
+        while (bWritten && sourceStream) {
+            sourceStream.read(block.data(), block.size());
+            if (sourceStream.gcount() > 0) {
+                bWritten = (gzwrite(gzipFile, block.data(), static_cast<unsigned> (sourceStream.gcount())) > 0);
+            }
+        }
+
+        if ((gzclose(gzipFile) != Z_OK) || !bWritten || sourceStream.bad()) {
+            fs::remove_all(this->m_directory);
+            throw Exception("Could not compress [" + sourceFile + "]");
+        }
+
+    }
+
+    //
+    // Remove compressed file and its directory.
+    //
+
+    GZipFile::~GZipFile() {
+
+        std::error_code removeError;
+
+        fs::remove_all(this->m_directory, removeError);
+
+    }
+
+    bool GZipFile::isCompressedType(const std::string &mimeType) {
+
+        for (auto prefix : kCompressedTypePrefixes) {
+            if (mimeType.compare(0, std::char_traits<char>::length(prefix), prefix) == 0) {
+                return (true);
+            }
+        }
+
+        return (false);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,65 @@
+#ifndef FPE_GZIPFILE_HPP
+#define FPE_GZIPFILE_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // GZipFile class. A gzip compressed copy of a file written a block at a
+    // time to a private temporary directory (keeping the source file name
+    // plus ".gz") and removed again when the object is destroyed.
+    //
+
+    class GZipFile {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("GZipFile Failure: " + message) {
+            }
+
+        };
+
+        explicit GZipFile(const std::string &sourceFile, int level = kDefaultLevel);
+
+        ~GZipFile();
+
+        // Compressed file name
+
+        const std::string& fileName(void) const { return m_fileName; }
+
+        // MIME type is for content that is already compressed (images, video,
+        // audio, archives and zip based documents)
+
+        static bool isCompressedType(const std::string &mimeType);
+
+        static constexpr int kDefaultLevel { 6 }; // zlib compression level
+
+    private:
+
+        GZipFile(const GZipFile&) = delete;
+        GZipFile& operator=(const GZipFile&) = delete;
+
+        std::string m_directory; // Temporary directory
+        std::string m_fileName; // Compressed file
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_GZIPFILE_HPP */
+
@@ -0,0 +1,265 @@
+//
+// Module: FPE_GZipStream
+//
+// Description: Stream the decompressed contents of a gzip file through a
+// ring of buffers filled by a decompression thread.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// zlib               : gzip decompression.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+//
+// zlib
+//
+
+#include <zlib.h>
+
+//
+// Program components.
+//
+
+#include "FPE_GZipStream.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kCarrySize { 256 * 1024 }; // Room in front of each buffer for data carried over
+    constexpr unsigned kReadSize { 256 * 1024 }; // zlib input buffer size
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Read up to length bytes of decompressed data (less only at the end of
+    // the file) returning any error.
+    //
+
+    static std::string gzipRead(gzFile gzipFile, char *data, std::size_t length, std::size_t &bytesRead) {
+
+        int errorCode = Z_OK;
+        int readLength = 0;
+
+        bytesRead = 0;
+
+        while ((bytesRead < length) && ((readLength = gzread(gzipFile, data + bytesRead,
+                static_cast<unsigned> (std::min<std::size_t>(length - bytesRead, INT_MAX)))) > 0)) {
+            bytesRead += readLength;
+        }
+
+        const char *errorMessage = gzerror(gzipFile, &errorCode);
+
+        if ((readLength < 0) || ((errorCode != Z_OK) && (errorCode != Z_STREAM_END))) {
+            return ((errorMessage && *errorMessage) ? errorMessage : "decompression failed");
+        }
+
+        return ("");
+
+    }
+
+    //
+    // Decompress file into free buffers until it is all decompressed, it
+    // fails or the stream is stopped.
+    //
+
+    void GZipStream::decompress(void) {
+
+        gzFile gzipFile = gzopen(this->m_fileName.c_str(), "rb");
+        std::string error;
+
+        if (gzipFile == nullptr) {
+            std::lock_guard<std::mutex> locker(this->m_mutex);
+            this->m_error = "Could not open [" + this->m_fileName + "]";
+            this->m_decompressed.notify_one();
+            return;
+        }
+
+        gzbuffer(gzipFile, kReadSize);
+
+        for (;;) {
+
+            std::size_t index;
+
+            {
+                std::unique_lock<std::mutex> locker(this->m_mutex);
+                this->m_freed.wait(locker, [this] () {
+                    return (this->m_bStop || !this->m_free.empty());
+                });
+                if (this->m_bStop) {
+                    break;
+                }
+                index = this->m_free.front();
+                this->m_free.pop_front();
+            }
+
+            Buffer &buffer = this->m_buffers[index];
+
+            error = gzipRead(gzipFile, buffer.data.get() + kCarrySize, this->m_bufferSize, buffer.length);
+            buffer.bLast = (buffer.length < this->m_bufferSize);
+
+            {
+                std::lock_guard<std::mutex> locker(this->m_mutex);
+                if (error.empty()) {
+                    this->m_filled.push_back(index);
+                } else {
+                    this->m_error = "Could not decompress [" + this->m_fileName + "]: " + error;
+                }
+            }
+
+            this->m_decompressed.notify_one();
+
+            if (buffer.bLast || !error.empty()) {
+                break;
+            }
+
+        }
+
+        gzclose(gzipFile);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    GZipStream::GZipStream(const std::string &fileName, std::size_t bufferSize, std::size_t buffers)
+    : m_fileName{fileName}, m_bufferSize{std::max<std::size_t>(bufferSize, 1)}, m_buffers(std::max<std::size_t>(buffers, 2)) {
+
+        for (std::size_t index = 0; index < this->m_buffers.size(); index++) {
+            this->m_buffers[index].data.reset(new char[kCarrySize + this->m_bufferSize]);
+            this->m_free.push_back(index);
+        }
+
+        this->m_decompressThread = std::thread(&GZipStream::decompress, this);
+
+    }
+
+    GZipStream::~GZipStream() {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_mutex);
+            this->m_bStop = true;
+        }
+
+        this->m_freed.notify_all();
+        this->m_decompressThread.join();
+
+    }
+
+    //
+    // Data kept from the last block is copied into the room in front of the
+    // next buffer (or if it does not fit into a spill buffer along with the
+    // next buffer's data) before the last buffer is freed for reuse.
+    //
+
+    bool GZipStream::read(Block &block, std::size_t keep) {
+
+        if (this->m_bFinished) {
+            return (false);
+        }
+
+        if (keep > this->m_lastBlock.length) {
+            throw Exception("Cannot keep more than the whole of the last block.");
+        }
+
+        std::size_t index;
+
+        {
+            std::unique_lock<std::mutex> locker(this->m_mutex);
+            this->m_decompressed.wait(locker, [this] () {
+                return (!this->m_filled.empty() || !this->m_error.empty());
+            });
+            if (this->m_filled.empty()) {
+                throw Exception(this->m_error);
+            }
+            index = this->m_filled.front();
+            this->m_filled.pop_front();
+        }
+
+        Buffer &buffer = this->m_buffers[index];
+        const char *kept = this->m_lastBlock.data + this->m_lastBlock.length - keep;
+
+        if (keep <= kCarrySize) {
+            std::memcpy(buffer.data.get() + kCarrySize - keep, kept, keep);
+            block.data = buffer.data.get() + kCarrySize - keep;
+        } else {
+            std::string spill;
+            spill.reserve(keep + buffer.length);
+            spill.append(kept, keep);
+            spill.append(buffer.data.get() + kCarrySize, buffer.length);
+            this->m_spill = std::move(spill);
+            block.data = this->m_spill.data();
+        }
+
+        block.length = keep + buffer.length;
+        block.offset = this->m_offset - keep;
+        block.bLast = buffer.bLast;
+
+        this->m_offset += buffer.length;
+        this->m_bFinished = buffer.bLast;
+        this->m_lastBlock = block;
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_mutex);
+            if (this->m_bReading) {
+                this->m_free.push_back(this->m_reading);
+            }
+            this->m_reading = index;
+            this->m_bReading = true;
+        }
+
+        this->m_freed.notify_one();
+
+        return (true);
+
+    }
+
+    bool GZipStream::isGZip(const char *data, std::size_t length) {
+
+        return ((length >= 2) && (static_cast<unsigned char> (data[0]) == 0x1f) && (static_cast<unsigned char> (data[1]) == 0x8b));
+
+    }
+
+    std::string GZipStream::head(const std::string &fileName, std::size_t length) {
+
+        gzFile gzipFile = gzopen(fileName.c_str(), "rb");
+        std::string data(length, '\0');
+        std::size_t bytesRead = 0;
+
+        if (gzipFile == nullptr) {
+            throw Exception("Could not open [" + fileName + "]");
+        }
+
+        std::string error { gzipRead(gzipFile, &data[0], length, bytesRead) };
+
+        gzclose(gzipFile);
+
+        if (!error.empty() && (bytesRead < length)) {
+            throw Exception("Could not decompress [" + fileName + "]: " + error);
+        }
+
+        data.resize(bytesRead);
+
+        return (data);
+
+    }
+
+} // namespace FPE_TaskActions
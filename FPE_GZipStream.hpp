@@ -0,0 +1,118 @@
+#ifndef FPE_GZIPSTREAM_HPP
+#define FPE_GZIPSTREAM_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // GZipStream class. Decompress a gzip file on a thread of its own into
+    // a ring of buffers that are handed in turn to the reader so that the
+    // file is decompressed while earlier blocks are being processed and
+    // the decompressed data is never written out. Each buffer has room
+    // in front of its data so that the unprocessed end of one block (an
+    // incomplete CSV row say) can be carried over to the front of the next
+    // without copying the whole of either.
+    //
+
+    class GZipStream {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("GZipStream Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Block of decompressed data (valid until the next read)
+        //
+
+        struct Block {
+            const char *data { nullptr }; // Data
+            std::size_t length { 0 }; // Length of data
+            std::uint64_t offset { 0 }; // Offset of data in decompressed stream
+            bool bLast { false }; // Last block of stream
+        };
+
+        // Start decompressing file into a number of buffers of a size
+
+        explicit GZipStream(const std::string &fileName, std::size_t bufferSize = kDefaultBufferSize,
+                std::size_t buffers = kDefaultBuffers);
+
+        ~GZipStream();
+
+        // Next block with the last keep bytes of the previous block in front
+        // of it (false once the last block has been read, throws on failure)
+
+        bool read(Block &block, std::size_t keep = 0);
+
+        // Data is gzip compressed
+
+        static bool isGZip(const char *data, std::size_t length);
+
+        // Up to the first length bytes of decompressed file
+
+        static std::string head(const std::string &fileName, std::size_t length);
+
+        static constexpr std::size_t kDefaultBufferSize { 4 * 1024 * 1024 }; // Bytes per buffer
+        static constexpr std::size_t kDefaultBuffers { 4 }; // Buffers in ring
+
+    private:
+
+        GZipStream(const GZipStream&) = delete;
+        GZipStream& operator=(const GZipStream&) = delete;
+
+        struct Buffer {
+            std::unique_ptr<char[]> data; // Carry room followed by decompressed data
+            std::size_t length { 0 }; // Length of decompressed data
+            bool bLast { false }; // Last buffer of stream
+        };
+
+        void decompress(void);
+
+        std::string m_fileName; // Compressed file
+        std::size_t m_bufferSize { 0 }; // Bytes of decompressed data per buffer
+        std::vector<Buffer> m_buffers; // Buffer ring
+        std::deque<std::size_t> m_free; // Buffers free to decompress into
+        std::deque<std::size_t> m_filled; // Buffers decompressed and waiting to be read
+        std::size_t m_reading { 0 }; // Buffer being read
+        bool m_bReading { false }; // A buffer is being read
+        bool m_bFinished { false }; // Last buffer has been read
+        Block m_lastBlock; // Last block read
+        std::string m_spill; // Block when carried data does not fit in front of a buffer
+        std::uint64_t m_offset { 0 }; // Offset of next buffer in stream
+        std::string m_error; // Decompression error (empty for none)
+        bool m_bStop { false }; // Stop decompressing
+        std::mutex m_mutex; // Protects buffer queues, error and stop
+        std::condition_variable m_freed; // Buffer freed (or stop)
+        std::condition_variable m_decompressed; // Buffer decompressed (or error)
+        std::thread m_decompressThread; // Decompression thread
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_GZIPSTREAM_HPP */
+
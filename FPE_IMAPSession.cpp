@@ -0,0 +1,215 @@
+//
+// Module: FPE_IMAPSession
+//
+// Description: A long lived IMAP session for appending mail messages to a
+// mailbox. The session is a libcurl easy handle which keeps its connection
+// open and logged in between transfers; each message is generated by
+// MailMessage and streamed to the server as the APPEND literal is sent.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// libcurl            : IMAP transport.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Program components.
+//
+
+#include "FPE_IMAPSession.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // Message upload position
+    //
+
+    struct AppendContext {
+        MailMessage *mailMessage;
+        std::string errorMessage;
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // libcurl read callback. Generate next part of mail message into upload
+    // buffer (an exception cannot pass back through libcurl so the transfer
+    // is aborted and the error kept).
+    //
+
+    static size_t appendReader(char *buffer, size_t size, size_t nitems, void *userData) {
+
+        AppendContext *append = static_cast<AppendContext *> (userData);
+
+        try {
+            return (append->mailMessage->read(buffer, size * nitems));
+        } catch (const std::exception &e) {
+            append->errorMessage = e.what();
+        }
+
+        return (CURL_READFUNC_ABORT);
+
+    }
+
+    //
+    // libcurl write callback. Server responses (to NOOP) are not needed.
+    //
+
+    static size_t responseDiscarder(char *, size_t size, size_t nmemb, void *) {
+
+        return (size * nmemb);
+
+    }
+
+    //
+    // Send NOOP on a connection kept open since the last append to check
+    // that it is still alive (false if it has been lost).
+    //
+
+    bool IMAPSession::checkConnection(void) {
+
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_URL, this->m_serverURL.c_str());
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_CUSTOMREQUEST, "NOOP");
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_UPLOAD, 0L);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_FRESH_CONNECT, 0L);
+
+        CURLcode res = curl_easy_perform(this->m_curlHandle);
+
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_CUSTOMREQUEST, nullptr);
+
+        return (res == CURLE_OK);
+
+    }
+
+    //
+    // Append message to mailbox streaming it from the message as it is
+    // generated (libcurl sends APPEND with the message length as a literal
+    // and flags it as seen).
+    //
+
+    void IMAPSession::appendMessage(const std::string &mailBoxURL, MailMessage &mailMessage, bool bFreshConnect) {
+
+        AppendContext append { &mailMessage, "" };
+
+        mailMessage.rewind();
+
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_URL, mailBoxURL.c_str());
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_UPLOAD, 1L);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_READDATA, &append);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t> (mailMessage.length()));
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_FRESH_CONNECT, (bFreshConnect) ? 1L : 0L);
+
+        CURLcode res = curl_easy_perform(this->m_curlHandle);
+
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_READDATA, nullptr);
+
+        this->m_bConnected = (res == CURLE_OK);
+
+        if (!append.errorMessage.empty()) {
+            throw Exception(append.errorMessage);
+        }
+
+        if (res != CURLE_OK) {
+            throw Exception(curl_easy_strerror(res));
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Create session handle with the options that stay the same for every
+    // append. Only one connection is cached so that a reconnect closes the
+    // old one.
+    //
+
+    IMAPSession::IMAPSession(const std::string &serverURL, const std::string &userName,
+                             const std::string &userPassword, bool bRequireTLS) :
+        m_serverURL{serverURL}, m_userName{userName}, m_userPassword{userPassword}, m_bRequireTLS{bRequireTLS} {
+
+        while (!this->m_serverURL.empty() && (this->m_serverURL.back() == '/')) {
+            this->m_serverURL.pop_back();
+        }
+
+        this->m_curlHandle = curl_easy_init();
+        if (this->m_curlHandle == nullptr) {
+            throw Exception("Could not allocate CURL handle.");
+        }
+
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_USERNAME, this->m_userName.c_str());
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_PASSWORD, this->m_userPassword.c_str());
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_USE_SSL, (this->m_bRequireTLS) ? static_cast<long> (CURLUSESSL_ALL) : static_cast<long> (CURLUSESSL_NONE));
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_MAXCONNECTS, 1L);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_READFUNCTION, appendReader);
+        curl_easy_setopt(this->m_curlHandle, CURLOPT_WRITEFUNCTION, responseDiscarder);
+
+    }
+
+    //
+    // Closing the handle logs out and closes its connection.
+    //
+
+    IMAPSession::~IMAPSession() {
+
+        curl_easy_cleanup(this->m_curlHandle);
+
+    }
+
+    //
+    // Append messages to mailbox each with its own APPEND over the same
+    // connection. A connection kept open since the last append is checked
+    // with a NOOP first so that one dropped while idle is reconnected before
+    // anything is appended. The first failure ends the appends and is passed
+    // on with the number appended before it.
+    //
+
+    void IMAPSession::append(const std::string &mailBox, const std::vector<MailMessage *> &mailMessages) {
+
+        if (mailMessages.empty()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> locker(this->m_sessionMutex);
+
+        char *escapedMailBox = curl_easy_escape(this->m_curlHandle, mailBox.c_str(), static_cast<int> (mailBox.length()));
+
+        if (escapedMailBox == nullptr) {
+            throw Exception("Could not escape mailbox name [" + mailBox + "]");
+        }
+
+        std::string mailBoxURL { this->m_serverURL + "/" + escapedMailBox };
+
+        curl_free(escapedMailBox);
+
+        bool bFreshConnect = !(this->m_bConnected && this->checkConnection());
+        std::size_t appended = 0;
+
+        try {
+            for (auto mailMessage : mailMessages) {
+                this->appendMessage(mailBoxURL, *mailMessage, bFreshConnect);
+                bFreshConnect = false;
+                appended++;
+            }
+        } catch (Exception &e) {
+            e.appended = appended;
+            throw;
+        }
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,91 @@
+#ifndef FPE_IMAPSESSION_HPP
+#define FPE_IMAPSESSION_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+//
+// libcurl
+//
+
+#include <curl/curl.h>
+
+//
+// Program components.
+//
+
+#include "FPE_MailMessage.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // IMAPSession class. A long lived IMAP connection (a libcurl easy handle
+    // that keeps its connection open and logged in between transfers) used
+    // to append mail messages to a mailbox. Each message is streamed to the
+    // server from MailMessage as it is generated, so memory use is bounded
+    // however large its attachments are. A dropped connection is found by a
+    // NOOP sent before each append and reconnected; an append itself is
+    // never sent twice as it may have reached the server before failing.
+    // Appends from different threads are serialised.
+    //
+
+    class IMAPSession {
+    public:
+
+        //
+        // Class exception (with the number of messages appended before it)
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("IMAPSession Failure: " + message) {
+            }
+
+            std::size_t appended { 0 }; // Messages appended before failure
+
+        };
+
+        IMAPSession(const std::string &serverURL, const std::string &userName,
+                    const std::string &userPassword, bool bRequireTLS = true);
+
+        ~IMAPSession();
+
+        // Append mail messages to mailbox (marked as seen) one APPEND each.
+        // On failure the exception holds how many messages (from the front)
+        // were appended and so must not be appended again.
+
+        void append(const std::string &mailBox, const std::vector<MailMessage *> &mailMessages);
+
+    private:
+
+        IMAPSession(const IMAPSession&) = delete;
+        IMAPSession& operator=(const IMAPSession&) = delete;
+
+        bool checkConnection(void);
+        void appendMessage(const std::string &mailBoxURL, MailMessage &mailMessage, bool bFreshConnect);
+
+        std::string m_serverURL; // Server URL (no trailing slash)
+        std::string m_userName; // Account name
+        std::string m_userPassword; // Account password
+        bool m_bRequireTLS; // Session must use TLS
+
+        CURL *m_curlHandle { nullptr }; // Session handle
+        bool m_bConnected { false }; // Handle has an open connection
+        std::mutex m_sessionMutex; // One command at a time
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_IMAPSESSION_HPP */
+
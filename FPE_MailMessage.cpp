@@ -0,0 +1,514 @@
+//
+// Module: FPE_MailMessage
+//
+// Description: Generate a MIME mail message with base64 encoded file
+// attachments a chunk at a time so that it can be written straight to a
+// connection without the whole encoded message ever being held in memory.
+// Base64 encoding uses AVX2 or SSSE3 when the CPU supports them (selected
+// at run time) with a scalar fallback.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <algorithm>
+
+//
+// Program components.
+//
+
+#include "FPE_MailMessage.hpp"
+
+//
+// SIMD intrinsics
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FPE_X86_SIMD
+#endif
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // Base64 line and block sizes
+    //
+
+    constexpr std::size_t kLineBytes { 57 }; // Input bytes per 76 character line
+    constexpr std::size_t kLineLength { 78 }; // 76 characters + CRLF
+    constexpr std::size_t kBlockLines { 1024 }; // Lines encoded per block read
+
+    constexpr char const *kBase64Alphabet { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Scalar base64 encode of bytes (final group padded) returning characters written.
+    //
+
+    static std::size_t encodeScalar(const unsigned char *input, std::size_t bytes, char *output) {
+
+        char *encoded = output;
+
+        for (; bytes >= 3; bytes -= 3, input += 3) {
+            *encoded++ = kBase64Alphabet[input[0] >> 2];
+            *encoded++ = kBase64Alphabet[((input[0] & 0x03) << 4) | (input[1] >> 4)];
+            *encoded++ = kBase64Alphabet[((input[1] & 0x0f) << 2) | (input[2] >> 6)];
+            *encoded++ = kBase64Alphabet[input[2] & 0x3f];
+        }
+
+        if (bytes) {
+            *encoded++ = kBase64Alphabet[input[0] >> 2];
+            if (bytes == 1) {
+                *encoded++ = kBase64Alphabet[(input[0] & 0x03) << 4];
+                *encoded++ = '=';
+            } else {
+                *encoded++ = kBase64Alphabet[((input[0] & 0x03) << 4) | (input[1] >> 4)];
+                *encoded++ = kBase64Alphabet[(input[1] & 0x0f) << 2];
+            }
+            *encoded++ = '=';
+        }
+
+        return (encoded - output);
+
+    }
+
+    //
+    // No SIMD block encoder available.
+    //
+
+    static std::size_t encodeBlocksNone(const unsigned char *, std::size_t, char *) {
+
+        return (0);
+
+    }
+
+#if defined(FPE_X86_SIMD)
+
+    //
+    // SSSE3 base64 encoder (W. Mula / D. Lemire). Each block of 16 bytes loaded
+    // encodes 12 of them so blocks are only encoded while 16 bytes are left;
+    // returns the number of input bytes encoded.
+    //
+
+    __attribute__((target("ssse3")))
+    static inline __m128i lookupSSSE3(__m128i indices) {
+
+        const __m128i shiftLUT = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+        __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+        result = _mm_shuffle_epi8(shiftLUT, result);
+
+        return (_mm_add_epi8(result, indices));
+
+    }
+
+    __attribute__((target("ssse3")))
+    static std::size_t encodeBlocksSSSE3(const unsigned char *input, std::size_t bytes, char *output) {
+
+        const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+        std::size_t encoded = 0;
+
+        for (; encoded + 16 <= bytes; encoded += 12, output += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *> (input + encoded));
+            block = _mm_shuffle_epi8(block, shuffle);
+            const __m128i t0 = _mm_and_si128(block, _mm_set1_epi32(0x0fc0fc00));
+            const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            const __m128i t2 = _mm_and_si128(block, _mm_set1_epi32(0x003f03f0));
+            const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            _mm_storeu_si128(reinterpret_cast<__m128i *> (output), lookupSSSE3(_mm_or_si128(t1, t3)));
+        }
+
+        return (encoded);
+
+    }
+
+    //
+    // AVX2 version of the above encoding 24 bytes (two 12 byte lanes) at a time.
+    //
+
+    __attribute__((target("avx2")))
+    static inline __m256i lookupAVX2(__m256i indices) {
+
+        const __m256i shiftLUT = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_shuffle_epi8(shiftLUT, result);
+
+        return (_mm256_add_epi8(result, indices));
+
+    }
+
+    __attribute__((target("avx2")))
+    static std::size_t encodeBlocksAVX2(const unsigned char *input, std::size_t bytes, char *output) {
+
+        const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+        std::size_t encoded = 0;
+
+        for (; encoded + 28 <= bytes; encoded += 24, output += 32) {
+            __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *> (input + encoded))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *> (input + encoded + 12)), 1);
+            block = _mm256_shuffle_epi8(block, shuffle);
+            const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+            const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+            const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *> (output), lookupAVX2(_mm256_or_si256(t1, t3)));
+        }
+
+        return (encoded);
+
+    }
+
+#endif // FPE_X86_SIMD
+
+    //
+    // Pick best block encoder for this CPU.
+    //
+
+    using EncodeBlocksFn = std::size_t (*)(const unsigned char *, std::size_t, char *);
+
+    static EncodeBlocksFn selectBlockEncoder(void) {
+
+#if defined(FPE_X86_SIMD)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return (encodeBlocksAVX2);
+        } else if (__builtin_cpu_supports("ssse3")) {
+            return (encodeBlocksSSSE3);
+        }
+#endif
+
+        return (encodeBlocksNone);
+
+    }
+
+    static const EncodeBlocksFn encodeBlocks { selectBlockEncoder() };
+
+    //
+    // Size of file (throws if it cannot be opened).
+    //
+
+    static std::size_t fileSize(const std::string &fileName) {
+
+        std::ifstream fileStream(fileName, std::ios::binary | std::ios::ate);
+
+        if (!fileStream) {
+            throw MailMessage::Exception("Could not open attachment [" + fileName + "]");
+        }
+
+        return (static_cast<std::size_t> (fileStream.tellg()));
+
+    }
+
+    //
+    // Current date/time in RFC 2822 format.
+    //
+
+    static std::string currentDateTime(void) {
+
+        char dateTime[64];
+        std::time_t now = std::time(nullptr);
+        struct tm localTime;
+
+        localtime_r(&now, &localTime);
+        std::strftime(dateTime, sizeof (dateTime), "%a, %d %b %Y %H:%M:%S %z", &localTime);
+
+        return (dateTime);
+
+    }
+
+    //
+    // Build message parts: headers, body and attachment part headers as text
+    // with each attachment's file in between. Boundary contains "=_" which
+    // cannot occur in base64 encoded data.
+    //
+
+    void MailMessage::build(void) {
+
+        if (!this->m_parts.empty()) {
+            return;
+        }
+
+        std::random_device randomDevice;
+        std::string boundary { "=_FPE_" + std::to_string(randomDevice()) + std::to_string(randomDevice()) };
+        std::string text;
+
+        text = "Date: " + currentDateTime() + "\r\n";
+        text += "To: " + this->m_mailTo + "\r\n";
+        text += "From: " + this->m_mailFrom + "\r\n";
+        text += "Subject: " + this->m_mailSubject + "\r\n";
+        text += "MIME-Version: 1.0\r\n";
+        text += "Content-Type: multipart/mixed;\r\n\tboundary=\"" + boundary + "\"\r\n\r\n";
+
+        text += "--" + boundary + "\r\n";
+        text += "Content-Type: text/plain; charset=UTF-8\r\n";
+        text += "Content-Transfer-Encoding: 7bit\r\n\r\n";
+        text += this->m_body + "\r\n";
+
+        for (auto &attachment : this->m_attachments) {
+            text += "--" + boundary + "\r\n" + attachment.text;
+            this->m_parts.push_back({text, "", 0});
+            this->m_parts.push_back({"", attachment.fileName, attachment.fileSize});
+            text.clear();
+        }
+
+        text += "--" + boundary + "--\r\n";
+        this->m_parts.push_back({text, "", 0});
+
+        this->m_length = 0;
+        for (auto &part : this->m_parts) {
+            this->m_length += (part.fileName.empty()) ? part.text.length() : encodedLength(part.fileSize);
+        }
+
+    }
+
+    //
+    // Read and encode next block of current attachment. Returns false once the
+    // whole file has been encoded.
+    //
+
+    bool MailMessage::fillEncoded(void) {
+
+        Part &part = this->m_parts[this->m_partIndex];
+
+        if (!this->m_fileStream.is_open()) {
+            this->m_fileStream.open(part.fileName, std::ios::binary);
+            if (!this->m_fileStream) {
+                throw Exception("Could not open attachment [" + part.fileName + "]");
+            }
+            this->m_fileBytesLeft = part.fileSize;
+        }
+
+        if (this->m_fileBytesLeft == 0) {
+            this->m_fileStream.close();
+            return (false);
+        }
+
+        std::size_t blockBytes = std::min(this->m_fileBytesLeft, kLineBytes * kBlockLines);
+
+        this->m_fileStream.read(reinterpret_cast<char *> (this->m_fileBuffer.data()), blockBytes);
+        if (static_cast<std::size_t> (this->m_fileStream.gcount()) != blockBytes) {
+            throw Exception("Attachment [" + part.fileName + "] changed size while being sent.");
+        }
+
+        this->m_fileBytesLeft -= blockBytes;
+        this->m_encodedLength = encodeBase64(this->m_fileBuffer.data(), blockBytes, this->m_encodedBuffer.data());
+        this->m_encodedOffset = 0;
+
+        return (true);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    MailMessage::MailMessage(const std::string &mailFrom, const std::string &mailTo, const std::string &mailSubject) :
+        m_mailFrom{mailFrom}, m_mailTo{mailTo}, m_mailSubject{mailSubject} {
+
+    }
+
+    void MailMessage::setBody(const std::string &body) {
+
+        this->m_body = body;
+
+    }
+
+    //
+    // Add file attachment. Its size is taken now to give the message length.
+    //
+
+    void MailMessage::addAttachment(const std::string &fileName, const std::string &contentType) {
+
+        std::string baseName { fileName.substr(fileName.find_last_of('/') + 1) };
+        Part attachment;
+
+        attachment.text = "Content-Type: " + contentType + "; name=\"" + baseName + "\"\r\n";
+        attachment.text += "Content-Transfer-Encoding: base64\r\n";
+        attachment.text += "Content-Disposition: attachment; filename=\"" + baseName + "\"\r\n\r\n";
+        attachment.fileName = fileName;
+        attachment.fileSize = fileSize(fileName);
+
+        this->m_attachments.push_back(attachment);
+
+        if (this->m_fileBuffer.empty()) {
+            this->m_fileBuffer.resize(kLineBytes * kBlockLines);
+            this->m_encodedBuffer.resize(kLineLength * kBlockLines);
+        }
+
+    }
+
+    //
+    // Compress file to a temporary copy (kept until the message is destroyed)
+    // and attach that.
+    //
+
+    void MailMessage::addCompressedAttachment(const std::string &fileName) {
+
+        try {
+            this->m_compressedFiles.emplace_back(new GZipFile(fileName));
+        } catch (const GZipFile::Exception &e) {
+            throw Exception(e.what());
+        }
+
+        this->addAttachment(this->m_compressedFiles.back()->fileName(), "application/gzip");
+
+    }
+
+    std::size_t MailMessage::length(void) {
+
+        this->build();
+
+        return (this->m_length);
+
+    }
+
+    //
+    // Copy next part of message into buffer.
+    //
+
+    std::size_t MailMessage::read(char *buffer, std::size_t size) {
+
+        std::size_t copied = 0;
+
+        this->build();
+
+        while ((copied < size) && (this->m_partIndex < this->m_parts.size())) {
+
+            Part &part = this->m_parts[this->m_partIndex];
+            std::size_t bytesToCopy;
+
+            if (part.fileName.empty()) {
+                bytesToCopy = std::min(size - copied, part.text.length() - this->m_partOffset);
+                std::memcpy(buffer + copied, part.text.data() + this->m_partOffset, bytesToCopy);
+                this->m_partOffset += bytesToCopy;
+                if (this->m_partOffset == part.text.length()) {
+                    this->m_partIndex++;
+                    this->m_partOffset = 0;
+                }
+            } else {
+                if ((this->m_encodedOffset == this->m_encodedLength) && !this->fillEncoded()) {
+                    this->m_partIndex++;
+                    continue;
+                }
+                bytesToCopy = std::min(size - copied, this->m_encodedLength - this->m_encodedOffset);
+                std::memcpy(buffer + copied, this->m_encodedBuffer.data() + this->m_encodedOffset, bytesToCopy);
+                this->m_encodedOffset += bytesToCopy;
+            }
+
+            copied += bytesToCopy;
+
+        }
+
+        return (copied);
+
+    }
+
+    void MailMessage::rewind(void) {
+
+        if (this->m_fileStream.is_open()) {
+            this->m_fileStream.close();
+        }
+
+        this->m_partIndex = 0;
+        this->m_partOffset = 0;
+        this->m_fileBytesLeft = 0;
+        this->m_encodedOffset = 0;
+        this->m_encodedLength = 0;
+
+    }
+
+    //
+    // Append whole message to buffer (sized once from the message length).
+    //
+
+    void MailMessage::appendTo(std::string &buffer) {
+
+        std::size_t offset = buffer.length();
+        std::size_t messageLength = this->length();
+
+        buffer.resize(offset + messageLength);
+
+        this->rewind();
+
+        while (offset < buffer.length()) {
+            std::size_t bytesRead = this->read(&buffer[offset], buffer.length() - offset);
+            if (bytesRead == 0) {
+                throw Exception("Mail message shorter than expected.");
+            }
+            offset += bytesRead;
+        }
+
+    }
+
+    //
+    // Length of bytes once base64 encoded into CRLF terminated 76 character lines.
+    //
+
+    std::size_t MailMessage::encodedLength(std::size_t bytes) {
+
+        std::size_t lastLineBytes = bytes % kLineBytes;
+
+        return ((bytes / kLineBytes) * kLineLength + ((lastLineBytes) ? ((lastLineBytes + 2) / 3) * 4 + 2 : 0));
+
+    }
+
+    //
+    // Base64 encode bytes into CRLF terminated 76 character lines returning
+    // the number of characters written (see encodedLength()).
+    //
+
+    std::size_t MailMessage::encodeBase64(const unsigned char *input, std::size_t bytes, char *output) {
+
+        char *encoded = output;
+
+        while (bytes > 0) {
+
+            std::size_t lineBytes = std::min(bytes, kLineBytes);
+            std::size_t blockBytes = encodeBlocks(input, lineBytes, encoded);
+
+            encoded += (blockBytes / 3) * 4;
+            encoded += encodeScalar(input + blockBytes, lineBytes - blockBytes, encoded);
+            *encoded++ = '\r';
+            *encoded++ = '\n';
+
+            input += lineBytes;
+            bytes -= lineBytes;
+
+        }
+
+        return (encoded - output);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,114 @@
+#ifndef FPE_MAILMESSAGE_HPP
+#define FPE_MAILMESSAGE_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_GZipFile.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // MailMessage class. A MIME mail message with file attachments that is
+    // generated in chunks (attachments are read and base64 encoded a block
+    // at a time) so memory use stays bounded however large the files are.
+    // The total length is known up front from the attachment file sizes.
+    //
+
+    class MailMessage {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("MailMessage Failure: " + message) {
+            }
+
+        };
+
+        MailMessage(const std::string &mailFrom, const std::string &mailTo, const std::string &mailSubject);
+
+        // Message body text and attachments
+
+        void setBody(const std::string &body);
+        void addAttachment(const std::string &fileName, const std::string &contentType);
+
+        // Attach gzip compressed copy of file (named file.gz)
+
+        void addCompressedAttachment(const std::string &fileName);
+
+        // Total message length in bytes
+
+        std::size_t length(void);
+
+        // Copy next part of message to buffer returning bytes copied (0 at end)
+
+        std::size_t read(char *buffer, std::size_t size);
+
+        // Start reading from beginning of message again
+
+        void rewind(void);
+
+        // Append whole message to buffer
+
+        void appendTo(std::string &buffer);
+
+        // Base64 encoded length and encoding (76 character lines each ending in CRLF)
+
+        static std::size_t encodedLength(std::size_t bytes);
+        static std::size_t encodeBase64(const unsigned char *input, std::size_t bytes, char *output);
+
+    private:
+
+        struct Part {
+            std::string text; // Literal text
+            std::string fileName; // Or file to encode
+            std::size_t fileSize; // File size
+        };
+
+        void build(void);
+        bool fillEncoded(void);
+
+        std::string m_mailFrom; // From address
+        std::string m_mailTo; // To address
+        std::string m_mailSubject; // Subject
+        std::string m_body; // Body text
+        std::vector<Part> m_attachments; // Attachments (part headers and files)
+        std::vector<std::unique_ptr<GZipFile>> m_compressedFiles; // Compressed copies attached
+
+        std::vector<Part> m_parts; // Message parts (built on first use)
+        std::size_t m_length { 0 }; // Total length
+
+        std::size_t m_partIndex { 0 }; // Current part
+        std::size_t m_partOffset { 0 }; // Offset in text part
+        std::size_t m_fileBytesLeft { 0 }; // Bytes still to read from file
+        std::ifstream m_fileStream; // Current attachment
+        std::vector<unsigned char> m_fileBuffer; // Raw block read from file
+        std::vector<char> m_encodedBuffer; // Encoded block
+        std::size_t m_encodedOffset { 0 }; // Offset in encoded block
+        std::size_t m_encodedLength { 0 }; // Bytes in encoded block
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_MAILMESSAGE_HPP */
+
@@ -0,0 +1,277 @@
+//
+// Module: FPE_MongoSink
+//
+// Description: CSV import sink for a MongoDB collection. Rows are encoded
+// as BSON documents by class BSONEncoder when added to a batch and the
+// batch is written with an unordered insert_many() (or an unordered bulk
+// write of replace_one() upserts). Rows given an _id that already exists
+// (replayed after a resumed import) are ignored.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// MongoDB            : C++ driver.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstdint>
+
+//
+// Program components.
+//
+
+#include "FPE_MongoSink.hpp"
+#include "FPE_BSONEncoder.hpp"
+
+//
+// MongoDB C++ Driver
+// Note: C++ Driver not easy to install so add define
+//
+
+#if defined(MONGO_DRIVER_INSTALLED)
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/bulk_write.hpp>
+#include <mongocxx/model/replace_one.hpp>
+#include <mongocxx/options/insert.hpp>
+#include <mongocxx/options/bulk_write.hpp>
+#include <mongocxx/exception/bulk_write_exception.hpp>
+#endif // MONGO_DRIVER_INSTALLED
+
+namespace FPE_TaskActions {
+
+#if defined(MONGO_DRIVER_INSTALLED)
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::int32_t kDuplicateKeyError { 11000 }; // MongoDB duplicate key error code
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Insert failed only because documents with the same _id already exist
+    // (rows inserted before an interrupted import was resumed).
+    //
+
+    static bool onlyDuplicateKeys(const mongocxx::bulk_write_exception &e) {
+
+        if (!e.raw_server_error()) {
+            return (false);
+        }
+
+        auto serverError = e.raw_server_error()->view();
+        auto writeErrors = serverError["writeErrors"];
+
+        if (!writeErrors || serverError["writeConcernErrors"]) {
+            return (false);
+        }
+
+        for (auto writeError : writeErrors.get_array().value) {
+            if (writeError["code"].get_int32().value != kDuplicateKeyError) {
+                return (false);
+            }
+        }
+
+        return (true);
+
+    }
+
+    //
+    // Batch of rows encoded as BSON documents (or for upserts as replace
+    // models filtered on the row's key columns).
+    //
+
+    class MongoBatch : public CSVSink::Batch {
+    public:
+
+        MongoBatch(const BSONEncoder &encoder, const std::vector<std::size_t> &upsertKeys) :
+            m_encoder{encoder}, m_upsertKeys{upsertKeys} {
+        }
+
+        void add(const CSVParser::Fields &fields, std::string_view id) override {
+            this->m_encoder.encode(fields, this->m_document, id);
+            this->m_bytes += this->m_document.size();
+            this->m_bIds = this->m_bIds || !id.empty();
+            if (this->m_upsertKeys.empty()) {
+                this->m_documents.emplace_back(bsoncxx::document::view(this->m_document.data(), this->m_document.size()));
+            } else {
+                this->m_encoder.encodeKey(fields, this->m_upsertKeys, this->m_key);
+                mongocxx::model::replace_one upsert {
+                    bsoncxx::document::value(bsoncxx::document::view(this->m_key.data(), this->m_key.size())),
+                    bsoncxx::document::value(bsoncxx::document::view(this->m_document.data(), this->m_document.size()))
+                };
+                upsert.upsert(true);
+                this->m_upserts.emplace_back(upsert);
+            }
+        }
+
+        std::size_t rows(void) const override {
+            return (this->m_documents.size() + this->m_upserts.size());
+        }
+
+        std::size_t bytes(void) const override {
+            return (this->m_bytes);
+        }
+
+        const std::vector<bsoncxx::document::value>& documents(void) const {
+            return (this->m_documents);
+        }
+
+        const std::vector<mongocxx::model::write>& upserts(void) const {
+            return (this->m_upserts);
+        }
+
+        bool ids(void) const {
+            return (this->m_bIds);
+        }
+
+    private:
+
+        const BSONEncoder &m_encoder; // Row encoder
+        const std::vector<std::size_t> &m_upsertKeys; // Key columns of upserts (empty to insert)
+        std::vector<std::uint8_t> m_document; // Row being encoded
+        std::vector<std::uint8_t> m_key; // Key of row being encoded
+        std::vector<bsoncxx::document::value> m_documents; // Documents to insert
+        std::vector<mongocxx::model::write> m_upserts; // Documents to upsert
+        std::size_t m_bytes { 0 }; // Size of documents
+        bool m_bIds { false }; // Rows given _id
+
+    };
+
+    //
+    // Writer with a client from the pool. For upserts the key columns are
+    // indexed so that each upsert finds any existing document quickly.
+    //
+
+    class MongoWriter : public CSVSink::Writer {
+    public:
+
+        MongoWriter(mongocxx::pool &clientPool, const std::string &database, const std::string &collection,
+                const CSVSink::Table &table) :
+            m_encoder{table.fieldNames, table.schema}, m_upsertKeys{table.upsertKeys}, m_connection{clientPool.acquire()},
+            m_collection{(*m_connection)[database][collection]} {
+
+            this->m_insertOptions.ordered(false);
+            this->m_bulkWriteOptions.ordered(false);
+
+            if (!this->m_upsertKeys.empty()) {
+                bsoncxx::builder::basic::document keyIndex;
+                for (auto key : this->m_upsertKeys) {
+                    keyIndex.append(bsoncxx::builder::basic::kvp(table.fieldNames[key], 1));
+                }
+                this->m_collection.create_index(keyIndex.view());
+            }
+
+        }
+
+        std::unique_ptr<CSVSink::Batch> batch(void) override {
+            return (std::unique_ptr<CSVSink::Batch>(new MongoBatch(this->m_encoder, this->m_upsertKeys)));
+        }
+
+        void write(CSVSink::Batch &batch) override {
+
+            const MongoBatch &documents = static_cast<MongoBatch &> (batch);
+
+            if (!documents.upserts().empty()) {
+                auto upserts = this->m_collection.create_bulk_write(this->m_bulkWriteOptions);
+                for (auto &upsert : documents.upserts()) {
+                    upserts.append(upsert);
+                }
+                upserts.execute();
+            }
+
+            if (documents.documents().empty()) {
+                return;
+            }
+
+            try {
+                this->m_collection.insert_many(documents.documents(), this->m_insertOptions);
+            } catch (const mongocxx::bulk_write_exception &e) {
+                if (!documents.ids() || !onlyDuplicateKeys(e)) {
+                    throw;
+                }
+            }
+
+        }
+
+    private:
+
+        BSONEncoder m_encoder; // Row encoder
+        std::vector<std::size_t> m_upsertKeys; // Key columns of upserts (empty to insert)
+        mongocxx::pool::entry m_connection; // Client from pool
+        mongocxx::collection m_collection; // Collection rows are written to
+        mongocxx::options::insert m_insertOptions; // Unordered insert
+        mongocxx::options::bulk_write m_bulkWriteOptions; // Unordered upserts
+
+    };
+
+#endif // MONGO_DRIVER_INSTALLED
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Create driver instance and client pool (the pool connects to the
+    // server as clients are first needed).
+    //
+
+    MongoSink::MongoSink(const std::string &serverURL, const std::string &database, const std::string &collection) :
+        m_database{database}, m_collection{collection} {
+
+        if (this->m_database.empty() || this->m_collection.empty()) {
+            throw Exception("Database and collection must be given.");
+        }
+
+#if defined(MONGO_DRIVER_INSTALLED)
+        this->m_driverInstance.reset(new mongocxx::instance());
+        this->m_clientPool.reset(new mongocxx::pool(mongocxx::uri{serverURL}));
+#else
+        throw Exception("MongoDB driver not installed; cannot connect to [" + serverURL + "].");
+#endif // MONGO_DRIVER_INSTALLED
+
+    }
+
+    MongoSink::~MongoSink() {
+
+#if defined(MONGO_DRIVER_INSTALLED)
+        this->m_clientPool.reset();
+        this->m_driverInstance.reset();
+#endif // MONGO_DRIVER_INSTALLED
+
+    }
+
+    std::unique_ptr<CSVSink::Writer> MongoSink::writer(const Table &table) {
+
+#if defined(MONGO_DRIVER_INSTALLED)
+        return (std::unique_ptr<CSVSink::Writer>(new MongoWriter(*this->m_clientPool, this->m_database,
+                this->m_collection, table)));
+#else
+        (void) table;
+        throw Exception("MongoDB driver not installed.");
+#endif // MONGO_DRIVER_INSTALLED
+
+    }
+
+    std::string MongoSink::name(void) const {
+
+        return ("MongoDB [" + this->m_database + "." + this->m_collection + "]");
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,81 @@
+#ifndef FPE_MONGOSINK_HPP
+#define FPE_MONGOSINK_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVSink.hpp"
+
+//
+// MongoDB C++ Driver
+//
+
+#if defined(MONGO_DRIVER_INSTALLED)
+#include <mongocxx/instance.hpp>
+#include <mongocxx/pool.hpp>
+#endif // MONGO_DRIVER_INSTALLED
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // MongoSink class. Import CSV rows into a MongoDB collection. The driver
+    // instance and a client pool live for as long as the sink and each
+    // writer uses a client taken from the pool. Rows are encoded straight
+    // to BSON and each batch is sent as an unordered insert_many().
+    // Without the MongoDB C++ driver installed the sink cannot be created.
+    //
+
+    class MongoSink : public CSVSink {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("MongoSink Failure: " + message) {
+            }
+
+        };
+
+        // Server URL, database and collection
+
+        MongoSink(const std::string &serverURL, const std::string &database, const std::string &collection);
+
+        ~MongoSink() override;
+
+        std::unique_ptr<Writer> writer(const Table &table) override;
+
+        std::string name(void) const override;
+
+    private:
+
+        std::string m_database; // Database name
+        std::string m_collection; // Collection name
+
+#if defined(MONGO_DRIVER_INSTALLED)
+        std::unique_ptr<mongocxx::instance> m_driverInstance; // Driver instance
+        std::unique_ptr<mongocxx::pool> m_clientPool; // Client pool
+#endif // MONGO_DRIVER_INSTALLED
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_MONGOSINK_HPP */
+
@@ -0,0 +1,293 @@
+//
+// Module: FPE_ParallelDeflate
+//
+// Description: Multi-threaded deflate of a file. Chunks are compressed
+// independently by worker threads (each ending with a sync flush so that
+// the compressed chunks can simply be concatenated) and written out in
+// order by the calling thread. CRC32s are calculated per chunk and then
+// combined.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// zlib               : Deflate compression and CRC32.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <cstring>
+
+//
+// zlib
+//
+
+#include <zlib.h>
+
+//
+// Linux
+//
+
+#include <unistd.h>
+
+//
+// Program components.
+//
+
+#include "FPE_ParallelDeflate.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kDictionarySize { 32 * 1024 }; // Deflate window
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Read a whole chunk from file (short only at end of file).
+    //
+
+    static std::size_t readChunk(int sourceFd, std::vector<unsigned char> &buffer, std::size_t chunkSize) {
+
+        std::size_t bytesRead = 0;
+
+        buffer.resize(chunkSize);
+
+        while (bytesRead < chunkSize) {
+            ssize_t result = read(sourceFd, &buffer[bytesRead], chunkSize - bytesRead);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw ParallelDeflate::Exception(std::string("Read failed: ") + std::strerror(errno));
+            }
+            if (result == 0) {
+                break;
+            }
+            bytesRead += result;
+        }
+
+        buffer.resize(bytesRead);
+
+        return (bytesRead);
+
+    }
+
+    //
+    // Compress one chunk as a raw deflate stream primed with its dictionary.
+    // All but the last chunk end with a sync flush (byte aligned, not final).
+    //
+
+    void ParallelDeflate::compressChunk(Chunk &chunk) {
+
+        z_stream deflateStream {};
+
+        if (deflateInit2(&deflateStream, this->m_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw Exception("Could not initialise deflate.");
+        }
+
+        if (!chunk.dictionary.empty()) {
+            deflateSetDictionary(&deflateStream, chunk.dictionary.data(), static_cast<uInt> (chunk.dictionary.size()));
+        }
+
+        chunk.crc32 = crc32(crc32(0L, Z_NULL, 0), chunk.input.data(), static_cast<uInt> (chunk.input.size()));
+        chunk.output.resize(deflateBound(&deflateStream, static_cast<uLong> (chunk.input.size())) + 16);
+
+        deflateStream.next_in = chunk.input.data();
+        deflateStream.avail_in = static_cast<uInt> (chunk.input.size());
+
+        std::size_t outputLength = 0;
+        int result;
+
+        do {
+            if (outputLength == chunk.output.size()) {
+                chunk.output.resize(chunk.output.size() * 2);
+            }
+            deflateStream.next_out = &chunk.output[outputLength];
+            deflateStream.avail_out = static_cast<uInt> (chunk.output.size() - outputLength);
+            result = deflate(&deflateStream, (chunk.bLast) ? Z_FINISH : Z_SYNC_FLUSH);
+            outputLength = chunk.output.size() - deflateStream.avail_out;
+        } while ((deflateStream.avail_out == 0) || ((chunk.bLast) && (result == Z_OK)));
+
+        deflateEnd(&deflateStream);
+
+        if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR)) {
+            throw Exception("Deflate failed.");
+        }
+
+        chunk.output.resize(outputLength);
+        chunk.input.clear();
+        chunk.input.shrink_to_fit();
+        chunk.dictionary.clear();
+
+    }
+
+    //
+    // Worker thread. Compress queued chunks.
+    //
+
+    void ParallelDeflate::worker(void) {
+
+        std::unique_lock<std::mutex> locker(this->m_queueMutex);
+
+        while (true) {
+
+            this->m_queueWakeup.wait(locker, [this] {
+                return (this->m_stop || !this->m_queue.empty());
+            });
+
+            if (this->m_queue.empty()) {
+                break;
+            }
+
+            std::shared_ptr<Chunk> chunk { this->m_queue.front() };
+            this->m_queue.pop_front();
+
+            locker.unlock();
+
+            std::string error;
+
+            try {
+                this->compressChunk(*chunk);
+            } catch (const std::exception &e) {
+                error = e.what();
+            }
+
+            locker.lock();
+
+            chunk->error = error;
+            chunk->bDone = true;
+            this->m_chunkDone.notify_all();
+
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    ParallelDeflate::ParallelDeflate(std::size_t threads, int level, std::size_t chunkSize) :
+        m_level{level}, m_chunkSize{(chunkSize > kDictionarySize) ? chunkSize : kDictionarySize} {
+
+        threads = (threads) ? threads : 1;
+        this->m_maxInFlight = threads * 2;
+
+        for (std::size_t thread = 0; thread < threads; thread++) {
+            this->m_workers.emplace_back(&ParallelDeflate::worker, this);
+        }
+
+    }
+
+    ParallelDeflate::~ParallelDeflate() {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_queueMutex);
+            this->m_stop = true;
+        }
+
+        this->m_queueWakeup.notify_all();
+
+        for (auto &worker : this->m_workers) {
+            worker.join();
+        }
+
+    }
+
+    //
+    // Read file a chunk ahead (to know which chunk is last), queue chunks for
+    // the workers and write finished chunks in order, keeping no more than
+    // twice the worker count of chunks in memory.
+    //
+
+    void ParallelDeflate::deflateFile(int sourceFd, WriteFn writeFn, std::uint32_t &crc32Value, std::uint64_t &uncompressedSize) {
+
+        std::deque<std::shared_ptr<Chunk>> inFlight;
+        std::vector<unsigned char> nextInput;
+        std::vector<unsigned char> dictionary;
+        std::string error;
+
+        crc32Value = crc32(0L, Z_NULL, 0);
+        uncompressedSize = 0;
+
+        // Wait for oldest chunk then write it (unless there has been an error)
+
+        auto writeOldest = [this, &inFlight, &writeFn, &crc32Value, &error] () {
+            std::shared_ptr<Chunk> chunk { inFlight.front() };
+            {
+                std::unique_lock<std::mutex> locker(this->m_queueMutex);
+                this->m_chunkDone.wait(locker, [&chunk] {
+                    return (chunk->bDone);
+                });
+            }
+            inFlight.pop_front();
+            if (error.empty()) {
+                error = chunk->error;
+            }
+            if (error.empty()) {
+                writeFn(chunk->output.data(), chunk->output.size());
+                crc32Value = crc32_combine(crc32Value, chunk->crc32, static_cast<z_off_t> (chunk->inputLength));
+            }
+        };
+
+        try {
+
+            readChunk(sourceFd, nextInput, this->m_chunkSize);
+
+            for (bool bLast = false; !bLast;) {
+
+                std::shared_ptr<Chunk> chunk { new Chunk() };
+
+                chunk->input.swap(nextInput);
+                chunk->inputLength = chunk->input.size();
+                chunk->dictionary.swap(dictionary);
+                bLast = (chunk->inputLength < this->m_chunkSize) || (readChunk(sourceFd, nextInput, this->m_chunkSize) == 0);
+                chunk->bLast = bLast;
+
+                if (!bLast) {
+                    dictionary.assign(chunk->input.end() - kDictionarySize, chunk->input.end());
+                }
+
+                uncompressedSize += chunk->inputLength;
+
+                {
+                    std::lock_guard<std::mutex> locker(this->m_queueMutex);
+                    this->m_queue.push_back(chunk);
+                }
+
+                this->m_queueWakeup.notify_one();
+                inFlight.push_back(chunk);
+
+                while ((inFlight.size() >= this->m_maxInFlight) || (bLast && !inFlight.empty())) {
+                    writeOldest();
+                    if (!error.empty()) {
+                        throw Exception(error);
+                    }
+                }
+
+            }
+
+        } catch (const std::exception &e) {
+            if (error.empty()) {
+                error = e.what();
+            }
+            while (!inFlight.empty()) {
+                writeOldest();
+            }
+            throw;
+        }
+
+    }
+
+} // namespace FPE_TaskActions
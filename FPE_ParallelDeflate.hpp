@@ -0,0 +1,96 @@
+#ifndef FPE_PARALLELDEFLATE_HPP
+#define FPE_PARALLELDEFLATE_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ParallelDeflate class. Deflate a file in the manner of pigz: it is read
+    // in fixed size chunks each of which is compressed by a pool of worker
+    // threads as a raw deflate stream ending on a byte boundary (primed with
+    // the last 32K of the chunk before it so little ratio is lost). The
+    // caller's thread writes the compressed chunks out in order, so the
+    // result is a single valid deflate stream.
+    //
+
+    class ParallelDeflate {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("ParallelDeflate Failure: " + message) {
+            }
+
+        };
+
+        using WriteFn = std::function<void(const unsigned char *, std::size_t)>;
+
+        ParallelDeflate(std::size_t threads, int level, std::size_t chunkSize = kDefaultChunkSize);
+
+        ~ParallelDeflate();
+
+        // Deflate file passing compressed data to write function in order.
+        // Returns CRC32 and size of the uncompressed data.
+
+        void deflateFile(int sourceFd, WriteFn writeFn, std::uint32_t &crc32, std::uint64_t &uncompressedSize);
+
+        static constexpr std::size_t kDefaultChunkSize { 128 * 1024 }; // Bytes per chunk
+
+    private:
+
+        struct Chunk {
+            std::vector<unsigned char> input; // Uncompressed data
+            std::vector<unsigned char> dictionary; // End of previous chunk
+            std::vector<unsigned char> output; // Compressed data
+            std::size_t inputLength { 0 }; // Uncompressed length
+            bool bLast { false }; // Final chunk of file
+            std::uint32_t crc32 { 0 }; // CRC32 of input
+            bool bDone { false }; // Compressed
+            std::string error; // Compression error
+        };
+
+        ParallelDeflate(const ParallelDeflate&) = delete;
+        ParallelDeflate& operator=(const ParallelDeflate&) = delete;
+
+        void compressChunk(Chunk &chunk);
+        void worker(void);
+
+        int m_level; // zlib compression level
+        std::size_t m_chunkSize; // Bytes per chunk
+        std::size_t m_maxInFlight; // Chunks queued or being written
+
+        bool m_stop { false }; // Stop worker threads
+        std::mutex m_queueMutex; // Protects queue and chunk state
+        std::condition_variable m_queueWakeup; // Work available
+        std::condition_variable m_chunkDone; // A chunk has been compressed
+        std::deque<std::shared_ptr<Chunk>> m_queue; // Chunks waiting for a worker
+        std::vector<std::thread> m_workers; // Worker threads
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_PARALLELDEFLATE_HPP */
+
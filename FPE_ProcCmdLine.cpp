@@ -34,6 +34,8 @@
 
 #include "FPE.hpp"
 #include "FPE_ProcCmdLine.hpp"
+#include "FPE_Actions.hpp"
+#include "FPE_SQLiteSink.hpp"
 
 //
 // Boost  program options processing
@@ -80,7 +82,7 @@ namespace FPE_ProcCmdLine {
                 ("log,l", po::value<std::string>(&options.map[kLogOption]), "Log file")
                 ("single,s", "Run task in main thread")
                 ("killcount,k", po::value<std::string>(&options.map[kKillCountOption])->default_value("0"), "Files to process before closedown")
-                ("server,s", po::value<std::string>(&options.map[kServerOption]), "SMTP/IMAP/MongoDB server URL and port")
+                ("server,s", po::value<std::string>(&options.map[kServerOption]), "SMTP/IMAP/MongoDB server URL and port (or sqlite:file)")
                 ("user,u", po::value<std::string>(&options.map[kUserOption]), "Account username")
                 ("password,p", po::value<std::string>(&options.map[kPasswordOption]), "Account username password")
                 ("recipient,r", po::value<std::string>(&options.map[kRecipientOption]), "Recipients(s) for email with attached file")
@@ -88,7 +90,34 @@ namespace FPE_ProcCmdLine {
                 ("archive,a", po::value<std::string>(&options.map[kArchiveOption]), "ZIP destination archive")
                 ("database,b", po::value<std::string>(&options.map[kDatabaseOption]), "Database name")
                 ("collection,c", po::value<std::string>(&options.map[kCollectionOption]), "Collection/Table name")
-                ("list", "Display a list of supported tasks.");
+                ("list", "Display a list of supported tasks.")
+                ("batchsize", po::value<std::string>(&options.map[kBatchSizeOption]), "Maximum files per batch (%files% command/IMAP append/email digest)")
+                ("batchwait", po::value<std::string>(&options.map[kBatchWaitOption]), "Maximum seconds a file waits in a batch")
+                ("digestsize", po::value<std::string>(&options.map[kDigestSizeOption]), "Maximum KB of attachments per digest email")
+                ("compress", po::value<std::string>(&options.map[kCompressOption]), "Gzip email attachments of this many KB or more")
+                ("timeout", po::value<std::string>(&options.map[kTimeoutOption]), "Command timeout in seconds")
+                ("killgrace", po::value<std::string>(&options.map[kKillGraceOption]), "Seconds between SIGTERM and SIGKILL on timeout")
+                ("cpulimit", po::value<std::string>(&options.map[kCPULimitOption]), "Command CPU limit in seconds")
+                ("memlimit", po::value<std::string>(&options.map[kMemoryLimitOption]), "Command address space limit in MB")
+                ("filelimit", po::value<std::string>(&options.map[kFileLimitOption]), "Command open file limit")
+                ("nice", po::value<std::string>(&options.map[kNiceOption]), "Command niceness increment")
+                ("spool", po::value<std::string>(&options.map[kSpoolOption]), "Spool directory for undelivered files (email/import/batched command)")
+                ("retries", po::value<std::string>(&options.map[kRetriesOption]), "Delivery attempts before a spooled file is failed")
+                ("retrydelay", po::value<std::string>(&options.map[kRetryDelayOption]), "Seconds before first retry of a spooled file")
+                ("threads", po::value<std::string>(&options.map[kThreadsOption]), "Worker threads for ZIP compression/extraction and CSV import")
+                ("archiveentries", po::value<std::string>(&options.map[kArchiveEntriesOption]), "Start a new ZIP archive after this many entries")
+                ("archivesize", po::value<std::string>(&options.map[kArchiveSizeOption]), "Start a new ZIP archive before it passes this many MB")
+                ("archiveage", po::value<std::string>(&options.map[kArchiveAgeOption]), "Start a new ZIP archive after this many seconds")
+                ("shards", po::value<std::string>(&options.map[kShardsOption]), "ZIP archives written in parallel")
+                ("duplicates", po::value<std::string>(&options.map[kDuplicatesOption]), "Files already in ZIP archive (skip or version)")
+                ("insertbatch", po::value<std::string>(&options.map[kInsertBatchOption]), "Maximum CSV rows per database insert")
+                ("insertsize", po::value<std::string>(&options.map[kInsertSizeOption]), "Maximum KB of CSV rows per database insert")
+                ("schema", po::value<std::string>(&options.map[kSchemaOption]), "CSV column types (name:type,... or infer)")
+                ("checkpoint", po::value<std::string>(&options.map[kCheckpointOption]), "Directory for CSV import checkpoints (resumable import)")
+                ("keycolumns", po::value<std::string>(&options.map[kKeyColumnsOption]), "CSV key columns rows are de-duplicated on (name,...)")
+                ("dedup", po::value<std::string>(&options.map[kDedupOption]), "CSV row de-duplication (filter or upsert)")
+                ("columns", po::value<std::string>(&options.map[kColumnsOption]), "CSV columns imported (name,...)")
+                ("filter", po::value<std::string>(&options.map[kFilterOption]), "CSV rows imported (name<op>value,... where op is =,!=,<,<=,>,>=)");
                 
 
     }
@@ -242,7 +271,13 @@ namespace FPE_ProcCmdLine {
             
             // Check common integer options
             
-            checkIntegerOptions({kTaskOption, kKillCountOption, kMaxDepthOption}, configVariablesMap);
+            checkIntegerOptions({kTaskOption, kKillCountOption, kMaxDepthOption,
+                                 kBatchSizeOption, kBatchWaitOption, kDigestSizeOption, kCompressOption, kTimeoutOption,
+                                 kKillGraceOption, kCPULimitOption, kMemoryLimitOption,
+                                 kFileLimitOption, kNiceOption, kRetriesOption,
+                                 kRetryDelayOption, kThreadsOption, kArchiveEntriesOption,
+                                 kArchiveSizeOption, kArchiveAgeOption, kShardsOption,
+                                 kInsertBatchOption, kInsertSizeOption}, configVariablesMap);
                  
             // Task option validation. Options  valid to the task being
             // run are checked for and if not present an exception is thrown to
@@ -253,6 +288,12 @@ namespace FPE_ProcCmdLine {
                 options.action = TaskAction::create(stoi(configVariablesMap[kTaskOption].as<std::string>()));
                 if (options.action) {
                     checkTaskOptions(options.action->getParameters(), configVariablesMap);
+                    // A CSV import into a MongoDB server (anything but an SQLite
+                    // database file) needs a database too.
+                    if (std::dynamic_pointer_cast<ImportCSVFile>(options.action) &&
+                        !SQLiteSink::isSQLiteURL(configVariablesMap[kServerOption].as<std::string>())) {
+                        checkTaskOptions({kDatabaseOption}, configVariablesMap);
+                    }
                 } else {
                     throw po::error("Error invalid task number.");                 
                 }
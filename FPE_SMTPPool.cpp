@@ -0,0 +1,262 @@
+//
+// Module: FPE_SMTPPool
+//
+// Description: A pool of reusable SMTP sessions so that the TCP connect,
+// TLS handshake and AUTH are paid once per session and not once per email.
+// Each session is a libcurl easy handle which keeps its connection open
+// between transfers; messages are generated by MailMessage and streamed to
+// the connection as they are read.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// libcurl            : SMTP transport.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Program components.
+//
+
+#include "FPE_SMTPPool.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // Message upload position
+    //
+
+    struct UploadContext {
+        MailMessage *mailMessage;
+        std::string errorMessage;
+    };
+
+    //
+    // Recipient list (freed however the message send ends)
+    //
+
+    struct RecipientList {
+        RecipientList() = default;
+        RecipientList(const RecipientList&) = delete;
+        RecipientList& operator=(const RecipientList&) = delete;
+        ~RecipientList() {
+            curl_slist_free_all(list);
+        }
+        struct curl_slist *list { nullptr };
+    };
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // libcurl read callback. Generate next part of mail message into upload
+    // buffer (an exception cannot pass back through libcurl so the transfer
+    // is aborted and the error kept).
+    //
+
+    static size_t uploadReader(char *buffer, size_t size, size_t nitems, void *userData) {
+
+        UploadContext *upload = static_cast<UploadContext *> (userData);
+
+        try {
+            return (upload->mailMessage->read(buffer, size * nitems));
+        } catch (const std::exception &e) {
+            upload->errorMessage = e.what();
+        }
+
+        return (CURL_READFUNC_ABORT);
+
+    }
+
+    //
+    // Errors that mean a reused connection has been lost and the message
+    // should be retried on a new connection.
+    //
+
+    static bool connectionLost(CURLcode res) {
+
+        return ((res == CURLE_SEND_ERROR) || (res == CURLE_RECV_ERROR) ||
+                (res == CURLE_GOT_NOTHING) || (res == CURLE_WEIRD_SERVER_REPLY));
+
+    }
+
+    //
+    // Take an idle session from the pool or create a new one.
+    //
+
+    std::unique_ptr<SMTPPool::Session> SMTPPool::acquireSession(void) {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_poolMutex);
+            if (!this->m_idleSessions.empty()) {
+                std::unique_ptr<Session> session { std::move(this->m_idleSessions.back()) };
+                this->m_idleSessions.pop_back();
+                return (session);
+            }
+        }
+
+        std::unique_ptr<Session> session { new Session() };
+
+        session->curlHandle = curl_easy_init();
+        if (session->curlHandle == nullptr) {
+            throw Exception("Could not allocate CURL handle.");
+        }
+
+        this->setSessionOptions(*session);
+
+        return (session);
+
+    }
+
+    //
+    // Return session to the pool (closing it if the pool is full).
+    //
+
+    void SMTPPool::releaseSession(std::unique_ptr<Session> session) {
+
+        std::lock_guard<std::mutex> locker(this->m_poolMutex);
+
+        if (this->m_idleSessions.size() < this->m_maxSessions) {
+            this->m_idleSessions.push_back(std::move(session));
+        }
+
+    }
+
+    //
+    // Set options that stay the same for every message sent by a session.
+    // Only one connection is cached per handle so that a reconnect closes
+    // the old one.
+    //
+
+    void SMTPPool::setSessionOptions(Session &session) {
+
+        curl_easy_setopt(session.curlHandle, CURLOPT_URL, this->m_serverURL.c_str());
+        curl_easy_setopt(session.curlHandle, CURLOPT_USERNAME, this->m_userName.c_str());
+        curl_easy_setopt(session.curlHandle, CURLOPT_PASSWORD, this->m_userPassword.c_str());
+        curl_easy_setopt(session.curlHandle, CURLOPT_USE_SSL, (this->m_bRequireTLS) ? static_cast<long> (CURLUSESSL_ALL) : static_cast<long> (CURLUSESSL_NONE));
+        curl_easy_setopt(session.curlHandle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(session.curlHandle, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(session.curlHandle, CURLOPT_MAXCONNECTS, 1L);
+        curl_easy_setopt(session.curlHandle, CURLOPT_MAXAGE_CONN, static_cast<long> (this->m_idleTimeout.count()));
+        curl_easy_setopt(session.curlHandle, CURLOPT_READFUNCTION, uploadReader);
+
+    }
+
+    //
+    // Send RSET on a reused session to clear any previous transaction state
+    // and check that the connection is still alive.
+    //
+
+    bool SMTPPool::resetSession(Session &session) {
+
+        curl_easy_setopt(session.curlHandle, CURLOPT_CUSTOMREQUEST, "RSET");
+        curl_easy_setopt(session.curlHandle, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(session.curlHandle, CURLOPT_UPLOAD, 0L);
+        curl_easy_setopt(session.curlHandle, CURLOPT_MAIL_RCPT, nullptr);
+        curl_easy_setopt(session.curlHandle, CURLOPT_FRESH_CONNECT, 0L);
+
+        CURLcode res = curl_easy_perform(session.curlHandle);
+
+        curl_easy_setopt(session.curlHandle, CURLOPT_CUSTOMREQUEST, nullptr);
+        curl_easy_setopt(session.curlHandle, CURLOPT_NOBODY, 0L);
+
+        return (res == CURLE_OK);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    SMTPPool::SMTPPool(const std::string &serverURL, const std::string &userName,
+                       const std::string &userPassword, bool bRequireTLS) :
+        m_serverURL{serverURL}, m_userName{userName}, m_userPassword{userPassword}, m_bRequireTLS{bRequireTLS} {
+
+    }
+
+    //
+    // Idle sessions are closed as they are destroyed.
+    //
+
+    SMTPPool::~SMTPPool() {
+
+    }
+
+    //
+    // Post mail message. A session that has been idle for longer than the idle
+    // timeout or whose RSET fails is reconnected, and a message that fails
+    // because a reused connection has dropped is retried once on a new one.
+    // Should anything throw before the session is released it is closed
+    // rather than returned to the pool.
+    //
+
+    void SMTPPool::postMail(const std::string &mailFrom, const std::vector<std::string> &recipients,
+                            MailMessage &mailMessage) {
+
+        std::unique_ptr<Session> session { this->acquireSession() };
+        RecipientList recipientList;
+        bool bFreshConnect = true;
+        CURLcode res = CURLE_OK;
+        std::string errorMessage;
+
+        if (session->bConnected &&
+            (std::chrono::steady_clock::now() - session->lastUsed < this->m_idleTimeout)) {
+            bFreshConnect = !this->resetSession(*session);
+        }
+
+        for (auto &recipient : recipients) {
+            recipientList.list = curl_slist_append(recipientList.list, recipient.c_str());
+        }
+
+        for (;;) {
+
+            UploadContext upload { &mailMessage, "" };
+
+            mailMessage.rewind();
+
+            curl_easy_setopt(session->curlHandle, CURLOPT_MAIL_FROM, mailFrom.c_str());
+            curl_easy_setopt(session->curlHandle, CURLOPT_MAIL_RCPT, recipientList.list);
+            curl_easy_setopt(session->curlHandle, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt(session->curlHandle, CURLOPT_READDATA, &upload);
+            curl_easy_setopt(session->curlHandle, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t> (mailMessage.length()));
+            curl_easy_setopt(session->curlHandle, CURLOPT_FRESH_CONNECT, (bFreshConnect) ? 1L : 0L);
+
+            res = curl_easy_perform(session->curlHandle);
+
+            if (!upload.errorMessage.empty()) {
+                errorMessage = upload.errorMessage;
+                break;
+            }
+
+            if ((res == CURLE_OK) || bFreshConnect || !connectionLost(res)) {
+                errorMessage = curl_easy_strerror(res);
+                break;
+            }
+
+            bFreshConnect = true;
+
+        }
+
+        curl_easy_setopt(session->curlHandle, CURLOPT_MAIL_RCPT, nullptr);
+
+        session->bConnected = (res == CURLE_OK);
+        session->lastUsed = std::chrono::steady_clock::now();
+
+        this->releaseSession(std::move(session));
+
+        if (res != CURLE_OK) {
+            throw Exception(errorMessage);
+        }
+
+    }
+
+} // namespace FPE_TaskActions
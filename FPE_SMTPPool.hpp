@@ -0,0 +1,110 @@
+#ifndef FPE_SMTPPOOL_HPP
+#define FPE_SMTPPOOL_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <stdexcept>
+
+//
+// libcurl
+//
+
+#include <curl/curl.h>
+
+//
+// Program components.
+//
+
+#include "FPE_MailMessage.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // SMTPPool class. A pool of SMTP sessions (libcurl easy handles whose
+    // connections are kept open and authenticated between messages) shared
+    // across files and threads. Sessions are created on demand; a reused
+    // session is sent RSET before its next message and one left idle for
+    // longer than the idle timeout is reconnected.
+    //
+
+    class SMTPPool {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("SMTPPool Failure: " + message) {
+            }
+
+        };
+
+        SMTPPool(const std::string &serverURL, const std::string &userName,
+                 const std::string &userPassword, bool bRequireTLS = true);
+
+        ~SMTPPool();
+
+        // Maximum sessions kept open and idle time before reconnecting
+
+        void setMaxSessions(std::size_t maxSessions) { m_maxSessions = maxSessions; }
+        void setIdleTimeout(std::chrono::seconds idleTimeout) { m_idleTimeout = idleTimeout; }
+
+        // Send mail message to recipients (streamed from message as it is generated)
+
+        void postMail(const std::string &mailFrom, const std::vector<std::string> &recipients,
+                      MailMessage &mailMessage);
+
+    private:
+
+        struct Session {
+            Session() = default;
+            Session(const Session&) = delete;
+            Session& operator=(const Session&) = delete;
+            ~Session() {
+                if (curlHandle != nullptr) {
+                    curl_easy_cleanup(curlHandle);
+                }
+            }
+            CURL *curlHandle { nullptr }; // Session handle (closed with session)
+            bool bConnected { false }; // Handle has an open connection
+            std::chrono::steady_clock::time_point lastUsed; // Time of last message
+        };
+
+        SMTPPool(const SMTPPool&) = delete;
+        SMTPPool& operator=(const SMTPPool&) = delete;
+
+        std::unique_ptr<Session> acquireSession(void);
+        void releaseSession(std::unique_ptr<Session> session);
+        void setSessionOptions(Session &session);
+        bool resetSession(Session &session);
+
+        std::string m_serverURL; // Server URL
+        std::string m_userName; // Account name
+        std::string m_userPassword; // Account password
+        bool m_bRequireTLS; // Session must use TLS
+
+        std::size_t m_maxSessions { 4 }; // Sessions kept open
+        std::chrono::seconds m_idleTimeout { 120 }; // Reconnect after idle time
+
+        std::mutex m_poolMutex; // Protects idle session list
+        std::vector<std::unique_ptr<Session>> m_idleSessions; // Sessions not in use
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_SMTPPOOL_HPP */
+
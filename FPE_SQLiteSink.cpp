@@ -0,0 +1,369 @@
+//
+// Module: FPE_SQLiteSink
+//
+// Description: CSV import sink for an embedded SQLite database. A batch
+// keeps copies of its rows' fields in a single buffer; these are converted
+// to column types and bound to a prepared INSERT OR IGNORE (or for upserts
+// INSERT ... ON CONFLICT DO UPDATE) statement when the batch is written
+// in one BEGIN IMMEDIATE ... COMMIT transaction (the writer waiting on the
+// lock while another writes).
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// SQLite             : Embedded database.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <limits>
+#include <algorithm>
+
+//
+// SQLite
+//
+
+#include <sqlite3.h>
+
+//
+// Program components.
+//
+
+#include "FPE_SQLiteSink.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr char const *kSQLitePrefix { "sqlite:" }; // Server URL prefix
+    constexpr char const *kKeyIndexSuffix { "_upsert_key" }; // Name of upsert key index is table name and suffix
+    constexpr int kBusyTimeout { 60 * 1000 }; // Milliseconds to wait for another writer
+    constexpr std::size_t kNullField { std::numeric_limits<std::size_t>::max() }; // Field missing from row
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Identifier quoted for use in SQL.
+    //
+
+    static std::string quoteIdentifier(const std::string &identifier) {
+
+        std::string quoted { "\"" };
+
+        for (auto character : identifier) {
+            quoted += character;
+            if (character == '"') {
+                quoted += character;
+            }
+        }
+
+        return (quoted + "\"");
+
+    }
+
+    //
+    // Column type for a schema type.
+    //
+
+    static std::string columnType(CSVSchema::Type type) {
+
+        switch (type) {
+            case CSVSchema::Type::int64:
+            case CSVSchema::Type::boolean:
+            case CSVSchema::Type::date:
+                return ("INTEGER");
+            case CSVSchema::Type::real:
+                return ("REAL");
+            default:
+                return ("TEXT");
+        }
+
+    }
+
+    //
+    // Batch of rows with their fields copied to a single buffer.
+    //
+
+    class SQLiteBatch : public CSVSink::Batch {
+    public:
+
+        explicit SQLiteBatch(std::size_t columns) : m_columns{columns} {
+        }
+
+        void add(const CSVParser::Fields &fields, std::string_view id) override {
+            this->addField(id.data(), (id.empty()) ? kNullField : id.size());
+            for (std::size_t column = 0; column < this->m_columns; column++) {
+                if (column < fields.size()) {
+                    this->addField(fields[column].data(), fields[column].size());
+                } else {
+                    this->addField(nullptr, kNullField);
+                }
+            }
+            this->m_rows++;
+        }
+
+        std::size_t rows(void) const override {
+            return (this->m_rows);
+        }
+
+        std::size_t bytes(void) const override {
+            return (this->m_buffer.size());
+        }
+
+        // Field of row (0 being the id); false if null
+
+        bool field(std::size_t row, std::size_t column, std::string_view &value) const {
+            const Field &current = this->m_fields[row * (this->m_columns + 1) + column];
+            if (current.length == kNullField) {
+                return (false);
+            }
+            value = std::string_view(this->m_buffer.data() + current.offset, current.length);
+            return (true);
+        }
+
+    private:
+
+        struct Field {
+            std::size_t offset; // Offset in buffer
+            std::size_t length; // Length (kNullField if null)
+        };
+
+        void addField(const char *data, std::size_t length) {
+            this->m_fields.push_back({this->m_buffer.size(), length});
+            if (length != kNullField) {
+                this->m_buffer.append(data, length);
+            }
+        }
+
+        std::size_t m_columns; // Columns per row (excluding id)
+        std::size_t m_rows { 0 }; // Rows in batch
+        std::string m_buffer; // Field contents
+        std::vector<Field> m_fields; // Fields (id then columns for each row)
+
+    };
+
+    //
+    // Writer with its own connection and prepared insert statement.
+    //
+
+    class SQLiteWriter : public CSVSink::Writer {
+    public:
+
+        SQLiteWriter(const std::string &databaseFile, const std::string &table, const CSVSink::Table &rows) :
+            m_columns{rows.fieldNames.size()}, m_schema{rows.schema} {
+
+            if (sqlite3_open_v2(databaseFile.c_str(), &this->m_connection,
+                    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+                std::string error { (this->m_connection) ? sqlite3_errmsg(this->m_connection) : "out of memory" };
+                sqlite3_close(this->m_connection);
+                throw SQLiteSink::Exception("Could not open [" + databaseFile + "]: " + error);
+            }
+
+            try {
+
+                sqlite3_busy_timeout(this->m_connection, kBusyTimeout);
+
+                this->execute("PRAGMA journal_mode=WAL");
+                this->execute("PRAGMA synchronous=NORMAL");
+
+                std::string createTable { "CREATE TABLE IF NOT EXISTS " + quoteIdentifier(table) + " (\"_id\" TEXT UNIQUE" };
+                std::string insert { "INTO " + quoteIdentifier(table) + " (\"_id\"" };
+                std::string values { "?" };
+
+                for (std::size_t column = 0; column < rows.fieldNames.size(); column++) {
+                    std::string type { columnType((rows.schema) ? rows.schema->type(column) : CSVSchema::Type::string) };
+                    createTable += ", " + quoteIdentifier(rows.fieldNames[column]) + " " + type;
+                    insert += ", " + quoteIdentifier(rows.fieldNames[column]);
+                    values += ", ?";
+                }
+
+                this->execute(createTable + ")");
+
+                insert += ") VALUES (" + values + ")";
+
+                // Upserts need a unique index on the key columns to detect
+                // conflicts; columns other than keys are updated
+
+                if (!rows.upsertKeys.empty()) {
+                    std::string keys;
+                    std::string updates;
+                    for (auto key : rows.upsertKeys) {
+                        keys += ((keys.empty()) ? "" : ", ") + quoteIdentifier(rows.fieldNames[key]);
+                    }
+                    for (std::size_t column = 0; column < rows.fieldNames.size(); column++) {
+                        if (std::find(rows.upsertKeys.begin(), rows.upsertKeys.end(), column) == rows.upsertKeys.end()) {
+                            std::string name { quoteIdentifier(rows.fieldNames[column]) };
+                            updates += ((updates.empty()) ? "" : ", ") + name + " = excluded." + name;
+                        }
+                    }
+                    this->execute("CREATE UNIQUE INDEX IF NOT EXISTS " + quoteIdentifier(table + kKeyIndexSuffix) +
+                            " ON " + quoteIdentifier(table) + " (" + keys + ")");
+                    insert = "INSERT " + insert + " ON CONFLICT (" + keys + ") DO " +
+                            ((updates.empty()) ? "NOTHING" : "UPDATE SET " + updates);
+                } else {
+                    insert = "INSERT OR IGNORE " + insert;
+                }
+
+                if (sqlite3_prepare_v2(this->m_connection, insert.c_str(), -1, &this->m_insert, nullptr) != SQLITE_OK) {
+                    throw SQLiteSink::Exception(sqlite3_errmsg(this->m_connection));
+                }
+
+            } catch (...) {
+                sqlite3_close(this->m_connection);
+                throw;
+            }
+
+        }
+
+        ~SQLiteWriter() override {
+            sqlite3_finalize(this->m_insert);
+            sqlite3_close(this->m_connection);
+        }
+
+        std::unique_ptr<CSVSink::Batch> batch(void) override {
+            return (std::unique_ptr<CSVSink::Batch>(new SQLiteBatch(this->m_columns)));
+        }
+
+        void write(CSVSink::Batch &batch) override {
+
+            const SQLiteBatch &rows = static_cast<SQLiteBatch &> (batch);
+
+            this->execute("BEGIN IMMEDIATE");
+
+            try {
+                for (std::size_t row = 0; row < rows.rows(); row++) {
+                    this->insert(rows, row);
+                }
+                this->execute("COMMIT");
+            } catch (...) {
+                sqlite3_exec(this->m_connection, "ROLLBACK", nullptr, nullptr, nullptr);
+                throw;
+            }
+
+        }
+
+    private:
+
+        // Execute SQL statement
+
+        void execute(const std::string &sql) {
+            char *error = nullptr;
+            if (sqlite3_exec(this->m_connection, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+                std::string message { (error) ? error : sqlite3_errmsg(this->m_connection) };
+                sqlite3_free(error);
+                throw SQLiteSink::Exception(message);
+            }
+        }
+
+        // Bind fields of row to insert statement (converted to column
+        // types with a schema) and execute it
+
+        void insert(const SQLiteBatch &rows, std::size_t row) {
+
+            std::string_view field;
+            CSVSchema::Value value;
+            int result = SQLITE_OK;
+
+            sqlite3_reset(this->m_insert);
+
+            for (std::size_t column = 0; (column <= this->m_columns) && (result == SQLITE_OK); column++) {
+                int parameter = static_cast<int> (column + 1);
+                if (!rows.field(row, column, field)) {
+                    result = sqlite3_bind_null(this->m_insert, parameter);
+                    continue;
+                }
+                if (!this->m_schema || (column == 0)) {
+                    value.type = CSVSchema::Type::string;
+                    value.text = field;
+                } else {
+                    this->m_schema->convert(column - 1, field, value);
+                }
+                switch (value.type) {
+                    case CSVSchema::Type::int64:
+                    case CSVSchema::Type::boolean:
+                    case CSVSchema::Type::date:
+                        result = sqlite3_bind_int64(this->m_insert, parameter, value.integer);
+                        break;
+                    case CSVSchema::Type::real:
+                        result = sqlite3_bind_double(this->m_insert, parameter, value.real);
+                        break;
+                    case CSVSchema::Type::null:
+                        result = sqlite3_bind_null(this->m_insert, parameter);
+                        break;
+                    default:
+                        result = sqlite3_bind_text(this->m_insert, parameter, value.text.data(),
+                                static_cast<int> (value.text.size()), SQLITE_STATIC);
+                        break;
+                }
+            }
+
+            if ((result != SQLITE_OK) || (sqlite3_step(this->m_insert) != SQLITE_DONE)) {
+                std::string error { sqlite3_errmsg(this->m_connection) };
+                sqlite3_reset(this->m_insert);
+                throw SQLiteSink::Exception(error);
+            }
+
+        }
+
+        sqlite3 *m_connection { nullptr }; // Database connection
+        sqlite3_stmt *m_insert { nullptr }; // Prepared insert of a row
+        std::size_t m_columns; // Columns per row (excluding id)
+        const CSVSchema *m_schema; // Column types (null for all strings)
+
+    };
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    SQLiteSink::SQLiteSink(const std::string &databaseFile, const std::string &table) :
+        m_databaseFile{databaseFile}, m_table{table} {
+
+        if (this->m_databaseFile.empty() || this->m_table.empty()) {
+            throw Exception("Database file and table must be given.");
+        }
+
+    }
+
+    std::unique_ptr<CSVSink::Writer> SQLiteSink::writer(const Table &table) {
+
+        return (std::unique_ptr<CSVSink::Writer>(new SQLiteWriter(this->m_databaseFile, this->m_table, table)));
+
+    }
+
+    std::string SQLiteSink::name(void) const {
+
+        return ("SQLite [" + this->m_databaseFile + "] table [" + this->m_table + "]");
+
+    }
+
+    bool SQLiteSink::isSQLiteURL(const std::string &serverURL) {
+
+        return (serverURL.find(kSQLitePrefix) == 0);
+
+    }
+
+    std::string SQLiteSink::databaseFile(const std::string &serverURL) {
+
+        std::string databaseFile { serverURL.substr(std::string(kSQLitePrefix).size()) };
+
+        if (databaseFile.find("//") == 0) {
+            databaseFile.erase(0, 2);
+        }
+
+        return (databaseFile);
+
+    }
+
+} // namespace FPE_TaskActions
@@ -0,0 +1,78 @@
+#ifndef FPE_SQLITESINK_HPP
+#define FPE_SQLITESINK_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_CSVSink.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // SQLiteSink class. Import CSV rows into a table of an embedded SQLite
+    // database file (created along with the table if they do not exist).
+    // Each writer has its own connection in WAL mode so that readers are
+    // not blocked by an import, rows are inserted by a prepared statement
+    // and each batch is written in a single transaction. Column types
+    // follow any schema (bool and date being stored as integers, a date in
+    // milliseconds since the epoch) and rows have an _id column that is
+    // unique so a row whose id is already present is ignored. Rows that
+    // are upserted replace those with the same values in the key columns
+    // (which are given a unique index).
+    //
+
+    class SQLiteSink : public CSVSink {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("SQLiteSink Failure: " + message) {
+            }
+
+        };
+
+        // Database file and table name
+
+        SQLiteSink(const std::string &databaseFile, const std::string &table);
+
+        std::unique_ptr<Writer> writer(const Table &table) override;
+
+        std::string name(void) const override;
+
+        // Server URL names a SQLite database file ("sqlite:file" or "sqlite://file")
+
+        static bool isSQLiteURL(const std::string &serverURL);
+
+        // Database file of SQLite server URL
+
+        static std::string databaseFile(const std::string &serverURL);
+
+    private:
+
+        std::string m_databaseFile; // Database file
+        std::string m_table; // Table name
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_SQLITESINK_HPP */
+
@@ -0,0 +1,595 @@
+//
+// Module: FPE_ShellCommand
+//
+// Description: Parse a shell command template once into its arguments and
+// then for each file render them into an argv and fork/exec the command
+// (with an optional timeout and resource limits).
+// Quoting follows the shell: single quotes are literal, double quotes allow
+// \" \\ \$ \` escapes and placeholders, and outside of quotes a backslash
+// escapes the next character.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <system_error>
+
+//
+// Program components.
+//
+
+#include "FPE.hpp"
+#include "FPE_ShellCommand.hpp"
+
+//
+// Process wait, signals, pipes and resource limits
+//
+
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // Command placeholders
+    //
+
+    constexpr char const *kSourcePlaceholder { "%1%" };
+    constexpr char const *kDestinationPlaceholder { "%2%" };
+    constexpr char const *kFilesPlaceholder { "%files%" };
+
+    constexpr std::size_t kArgumentHeadroom { 2048 }; // As used by xargs
+    constexpr int kChildPollInterval { 100 }; // Timed wait poll (milliseconds)
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Apply resource limits in the child before exec (any failure is ignored).
+    //
+
+    static void applyLimits(const ShellCommand::Limits &limits) {
+
+        struct rlimit resourceLimit;
+
+        if (limits.cpuSeconds > 0) {
+            resourceLimit.rlim_cur = limits.cpuSeconds;
+            resourceLimit.rlim_max = limits.cpuSeconds + 1; // SIGXCPU then SIGKILL
+            setrlimit(RLIMIT_CPU, &resourceLimit);
+        }
+
+        if (limits.addressSpace > 0) {
+            resourceLimit.rlim_cur = resourceLimit.rlim_max = static_cast<rlim_t> (limits.addressSpace) * 1024 * 1024;
+            setrlimit(RLIMIT_AS, &resourceLimit);
+        }
+
+        if (limits.openFiles > 0) {
+            resourceLimit.rlim_cur = resourceLimit.rlim_max = limits.openFiles;
+            setrlimit(RLIMIT_NOFILE, &resourceLimit);
+        }
+
+        if (limits.niceness != 0) {
+            int ignore = nice(limits.niceness);
+            (void)ignore;
+        }
+
+    }
+
+    //
+    // Read any child output available on pipe (closing it on end of file).
+    //
+
+    static void readOutput(int &outputFd, std::string &output) {
+
+        char buffer[4096];
+        ssize_t bytesRead;
+
+        while ((bytesRead = read(outputFd, buffer, sizeof (buffer))) != 0) {
+            if (bytesRead > 0) {
+                output.append(buffer, bytesRead);
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                return;
+            } else {
+                break;
+            }
+        }
+
+        close(outputFd);
+        outputFd = -1;
+
+    }
+
+    //
+    // Wait for child with a wall clock timeout. Output is read while waiting and
+    // once the timeout passes the child's process group is sent SIGTERM and
+    // then SIGKILL if still running after the grace period.
+    //
+
+    static int waitForChild(pid_t pid, int &outputFd, std::string *output, const ShellCommand::Limits &limits) {
+
+        using namespace std::chrono;
+
+        int status = 0;
+        int killSignal = SIGTERM;
+        auto deadline = steady_clock::now() + seconds(limits.timeout);
+
+        if (outputFd != -1) {
+            fcntl(outputFd, F_SETFL, fcntl(outputFd, F_GETFL) | O_NONBLOCK);
+        }
+
+        for (;;) {
+
+            pid_t waitResult = waitpid(pid, &status, WNOHANG);
+            if (waitResult == pid) {
+                break;
+            } else if ((waitResult < 0) && (errno != EINTR)) {
+                throw std::system_error(std::error_code(errno, std::system_category()), "Error: waiting for child process failed:");
+            }
+
+            auto now = steady_clock::now();
+
+            if (now >= deadline) {
+                if (killSignal == SIGTERM) {
+                    std::cerr << "Command exceeded " << limits.timeout << " second timeout; terminating." << std::endl;
+                    killpg(pid, SIGTERM);
+                    killSignal = SIGKILL;
+                    deadline = now + seconds(limits.killGrace);
+                } else {
+                    killpg(pid, SIGKILL);
+                    deadline = now + hours(24);
+                }
+                continue;
+            }
+
+            int waitTime = static_cast<int> (std::min<milliseconds::rep>(duration_cast<milliseconds>(deadline - now).count() + 1, kChildPollInterval));
+
+            if (outputFd != -1) {
+                struct pollfd pollOutput { outputFd, POLLIN, 0 };
+                if (poll(&pollOutput, 1, waitTime) > 0) {
+                    readOutput(outputFd, *output);
+                }
+            } else {
+                std::this_thread::sleep_for(milliseconds(waitTime));
+            }
+
+        }
+
+        // Collect anything left in the pipe and make sure no descendants survive a kill
+
+        if (outputFd != -1) {
+            readOutput(outputFd, *output);
+        }
+
+        if (killSignal == SIGKILL) {
+            killpg(pid, SIGKILL);
+        }
+
+        return (status);
+
+    }
+
+    //
+    // Fork and execute command returning its exit status (128 + signal number
+    // if killed). If output is passed then anything the command writes to
+    // stdout is returned in it otherwise stdout is discarded. The child runs in
+    // its own process group so that on timeout all of its descendants can be
+    // killed with it.
+    //
+
+    static int forkCommand(char *const argv[], std::string *output, const ShellCommand::Limits &limits) {
+
+        pid_t pid; // Process id
+        int status = 0; // wait status
+        int exitStatus = 0; // child exit status
+        int outputPipe[2] { -1, -1 }; // child stdout pipe
+
+        if (output && (pipe(outputPipe) < 0)) {
+            throw std::system_error(std::error_code(errno, std::system_category()), "Error: creating child output pipe failed:");
+        }
+
+        if ((pid = fork()) < 0) { /* fork a child process           */
+
+            if (output) {
+                close(outputPipe[0]);
+                close(outputPipe[1]);
+            }
+            throw std::system_error(std::error_code(errno, std::system_category()), "Error: forking child process failed:");
+
+        } else if (pid == 0) { /* for the child process: */
+
+            FILE *ignore;
+            (void)ignore;
+
+            setpgid(0, 0);
+
+            // Redirect stdout (to pipe if output wanted) and stderr
+
+            if (output) {
+                dup2(outputPipe[1], STDOUT_FILENO);
+                close(outputPipe[0]);
+                close(outputPipe[1]);
+            } else {
+                ignore = freopen("/dev/null", "w", stdout);
+            }
+
+            ignore = freopen("/dev/null", "w", stderr);
+
+            applyLimits(limits);
+
+            if (execvp(*argv, argv) < 0) { /* execute the command  */
+                _exit(1);
+            }
+
+        } else { // for the parent:
+
+            setpgid(pid, pid); // Avoid race with child
+
+            if (output) {
+                close(outputPipe[1]);
+            }
+
+            if (limits.timeout > 0) {
+
+                status = waitForChild(pid, outputPipe[0], output, limits);
+
+            } else {
+
+                if (output) {
+                    readOutput(outputPipe[0], *output);
+                }
+
+                while (waitpid(pid, &status, 0) < 0) { /* wait for completion  */
+                    if (errno != EINTR) {
+                        throw std::system_error(std::error_code(errno, std::system_category()), "Error: waiting for child process failed:");
+                    }
+                }
+
+            }
+
+            if (WIFEXITED(status)) {
+                exitStatus = WEXITSTATUS(status);
+            } else if (WIFSIGNALED(status)) {
+                exitStatus = 128 + WTERMSIG(status);
+            } else {
+                exitStatus = 1;
+            }
+
+        }
+
+        return (exitStatus);
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Get child process limits from task action options.
+    //
+
+    ShellCommand::Limits ShellCommand::Limits::fromOptions(std::unordered_map<std::string, std::string> &options) {
+
+        Limits limits;
+
+        auto getLimit = [&options] (const char *option, int &limit) {
+            if (!options[option].empty()) {
+                limit = std::stoi(options[option]);
+            }
+        };
+
+        getLimit(FPE::kTimeoutOption, limits.timeout);
+        getLimit(FPE::kKillGraceOption, limits.killGrace);
+        getLimit(FPE::kCPULimitOption, limits.cpuSeconds);
+        getLimit(FPE::kMemoryLimitOption, limits.addressSpace);
+        getLimit(FPE::kFileLimitOption, limits.openFiles);
+        getLimit(FPE::kNiceOption, limits.niceness);
+
+        return (limits);
+
+    }
+
+    //
+    // Parse command into arguments made up of literal and placeholder segments.
+    //
+
+    ShellCommand::ShellCommand(const std::string &command) {
+
+        std::vector<Segment> segments;
+        std::string text;
+        bool inArgument = false;
+        char quote = 0;
+
+        auto flushText = [&segments, &text] () {
+            if (!text.empty()) {
+                segments.push_back({text, Placeholder::none});
+                text.clear();
+            }
+        };
+
+        for (std::size_t pos = 0; pos < command.length(); pos++) {
+
+            char ch = command[pos];
+
+            // Inside single quotes everything is literal
+
+            if (quote == '\'') {
+                if (ch == '\'') {
+                    quote = 0;
+                } else {
+                    text += ch;
+                }
+                continue;
+            }
+
+            // Placeholders (unquoted or double quoted)
+
+            Placeholder placeholder = Placeholder::none;
+            std::size_t placeholderLength = 0;
+
+            if (command.compare(pos, std::strlen(kSourcePlaceholder), kSourcePlaceholder) == 0) {
+                placeholder = Placeholder::source;
+                placeholderLength = std::strlen(kSourcePlaceholder);
+            } else if (command.compare(pos, std::strlen(kDestinationPlaceholder), kDestinationPlaceholder) == 0) {
+                placeholder = Placeholder::destination;
+                placeholderLength = std::strlen(kDestinationPlaceholder);
+            } else if (command.compare(pos, std::strlen(kFilesPlaceholder), kFilesPlaceholder) == 0) {
+                placeholder = Placeholder::files;
+                placeholderLength = std::strlen(kFilesPlaceholder);
+            }
+
+            if (placeholder != Placeholder::none) {
+                flushText();
+                segments.push_back({"", placeholder});
+                pos += placeholderLength - 1;
+                inArgument = true;
+                continue;
+            }
+
+            // Double quotes
+
+            if (quote == '"') {
+                if (ch == '"') {
+                    quote = 0;
+                } else if ((ch == '\\') && (pos + 1 < command.length()) &&
+                           (std::strchr("\"\\$`", command[pos + 1]) != nullptr)) {
+                    text += command[++pos];
+                } else {
+                    text += ch;
+                }
+                continue;
+            }
+
+            // Unquoted
+
+            if ((ch == ' ') || (ch == '\t') || (ch == '\n')) {
+                if (inArgument) {
+                    flushText();
+                    this->addArgument(segments);
+                    inArgument = false;
+                }
+            } else if ((ch == '\'') || (ch == '"')) {
+                quote = ch;
+                inArgument = true;
+            } else if (ch == '\\') {
+                if (++pos < command.length()) {
+                    text += command[pos];
+                }
+                inArgument = true;
+            } else {
+                text += ch;
+                inArgument = true;
+            }
+
+        }
+
+        if (quote) {
+            throw Exception("Unterminated quote in command [" + command + "]");
+        }
+
+        if (inArgument) {
+            flushText();
+            this->addArgument(segments);
+        }
+
+        if (this->m_arguments.empty()) {
+            throw Exception("Empty command.");
+        }
+
+        this->m_argv.reserve(this->m_arguments.size() + 1);
+
+    }
+
+    //
+    // Add parsed argument. Literal only arguments are rendered once here.
+    //
+
+    void ShellCommand::addArgument(std::vector<Segment> &segments) {
+
+        Argument argument;
+
+        if (segments.empty()) {
+            segments.push_back({"", Placeholder::none});
+        }
+
+        for (auto &segment : segments) {
+            switch (segment.placeholder) {
+                case Placeholder::source:
+                    this->m_hasSource = true;
+                    break;
+                case Placeholder::destination:
+                    this->m_hasDestination = true;
+                    break;
+                case Placeholder::files:
+                    if (segments.size() != 1) {
+                        throw Exception("%files% must be a separate argument.");
+                    }
+                    this->m_hasFiles = true;
+                    break;
+                case Placeholder::none:
+                    argument.rendered += segment.text;
+                    break;
+            }
+        }
+
+        argument.segments.swap(segments);
+        this->m_arguments.push_back(std::move(argument));
+
+    }
+
+    //
+    // Render argument. A lone placeholder points directly at its value and a
+    // mixed argument is built in its own (reused) buffer.
+    //
+
+    char *ShellCommand::renderArgument(Argument &argument, const std::string &source, const std::string &destination) {
+
+        if (argument.segments.size() == 1) {
+            switch (argument.segments[0].placeholder) {
+                case Placeholder::none:
+                    return (&argument.rendered[0]);
+                case Placeholder::destination:
+                    return (const_cast<char *> (destination.c_str()));
+                default:
+                    return (const_cast<char *> (source.c_str()));
+            }
+        }
+
+        argument.rendered.clear();
+
+        for (auto &segment : argument.segments) {
+            switch (segment.placeholder) {
+                case Placeholder::none:
+                    argument.rendered += segment.text;
+                    break;
+                case Placeholder::destination:
+                    argument.rendered += destination;
+                    break;
+                default:
+                    argument.rendered += source;
+                    break;
+            }
+        }
+
+        return (&argument.rendered[0]);
+
+    }
+
+    //
+    // Space left for %files% in argv once the environment, the command's own
+    // arguments and some headroom have been accounted for.
+    //
+
+    std::size_t ShellCommand::argumentSpace(void) const {
+
+        long argMax = sysconf(_SC_ARG_MAX);
+        std::size_t used = kArgumentHeadroom;
+
+        if (argMax <= 0) {
+            argMax = _POSIX_ARG_MAX;
+        }
+
+        for (char **env = environ; *env != nullptr; env++) {
+            used += std::strlen(*env) + 1 + sizeof (char *);
+        }
+
+        for (auto &argument : this->m_arguments) {
+            used += argument.rendered.length() + 1 + sizeof (char *);
+        }
+
+        return ((static_cast<std::size_t> (argMax) > used) ? argMax - used : 0);
+
+    }
+
+    //
+    // Render argv for a source/destination file (%files% is taken as the source).
+    //
+
+    char *const *ShellCommand::argv(const std::string &source, const std::string &destination) {
+
+        this->m_argv.clear();
+
+        for (auto &argument : this->m_arguments) {
+            this->m_argv.push_back(this->renderArgument(argument, source, destination));
+        }
+
+        this->m_argv.push_back(nullptr);
+
+        return (this->m_argv.data());
+
+    }
+
+    //
+    // Render argv for a batch of files (%files% replaced by the batch).
+    //
+
+    char *const *ShellCommand::argv(const std::vector<std::string> &files) {
+
+        static const std::string noFile;
+
+        this->m_argv.clear();
+
+        for (auto &argument : this->m_arguments) {
+            if ((argument.segments.size() == 1) && (argument.segments[0].placeholder == Placeholder::files)) {
+                for (auto &file : files) {
+                    this->m_argv.push_back(const_cast<char *> (file.c_str()));
+                }
+            } else {
+                this->m_argv.push_back(this->renderArgument(argument, noFile, noFile));
+            }
+        }
+
+        this->m_argv.push_back(nullptr);
+
+        return (this->m_argv.data());
+
+    }
+
+    //
+    // Run command for source/destination file.
+    //
+
+    int ShellCommand::run(const std::string &source, const std::string &destination) {
+
+        return (forkCommand(this->argv(source, destination), nullptr, this->m_limits));
+
+    }
+
+    //
+    // Run command for batch of files returning anything written to stdout.
+    //
+
+    int ShellCommand::run(const std::vector<std::string> &files, std::string &output) {
+
+        return (forkCommand(this->argv(files), &output, this->m_limits));
+
+    }
+
+} // namespace FPE_TaskActions
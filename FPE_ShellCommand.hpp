@@ -0,0 +1,118 @@
+#ifndef FPE_SHELLCOMMAND_HPP
+#define FPE_SHELLCOMMAND_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ShellCommand class. A command template parsed once (with shell like
+    // quoting) into arguments whose %1% (source), %2% (destination) and
+    // %files% (batch of files) placeholders are substituted for each run.
+    // Arguments are rendered straight into a preallocated argv so a run
+    // allocates nothing beyond the substituted paths. Not thread safe.
+    //
+
+    class ShellCommand {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("ShellCommand Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Child process limits (zero for no limit). On timeout the child's
+        // process group is sent SIGTERM and then SIGKILL after killGrace.
+        //
+
+        struct Limits {
+            int timeout { 0 }; // Wall clock seconds
+            int killGrace { 10 }; // Seconds between SIGTERM and SIGKILL
+            int cpuSeconds { 0 }; // RLIMIT_CPU
+            int addressSpace { 0 }; // RLIMIT_AS (MB)
+            int openFiles { 0 }; // RLIMIT_NOFILE
+            int niceness { 0 }; // nice() increment
+
+            static Limits fromOptions(std::unordered_map<std::string, std::string> &options);
+        };
+
+        explicit ShellCommand(const std::string &command);
+
+        // Set child process limits
+
+        void setLimits(const Limits &limits) { m_limits = limits; }
+
+        // Placeholders present in command
+
+        bool hasSource(void) const { return (m_hasSource); }
+        bool hasDestination(void) const { return (m_hasDestination); }
+        bool hasFiles(void) const { return (m_hasFiles); }
+
+        // Space left in argv for %files% once the environment and command arguments are allowed for
+
+        std::size_t argumentSpace(void) const;
+
+        // Render argv for source/destination or a batch of files
+
+        char *const *argv(const std::string &source, const std::string &destination = "");
+        char *const *argv(const std::vector<std::string> &files);
+
+        // Run command returning its exit status (and stdout for a batch)
+
+        int run(const std::string &source, const std::string &destination = "");
+        int run(const std::vector<std::string> &files, std::string &output);
+
+    private:
+
+        enum class Placeholder {
+            none = 0,
+            source,
+            destination,
+            files
+        };
+
+        struct Segment {
+            std::string text; // Literal text
+            Placeholder placeholder; // Or placeholder to substitute
+        };
+
+        struct Argument {
+            std::vector<Segment> segments; // Argument segments
+            std::string rendered; // Rendered argument buffer
+        };
+
+        void addArgument(std::vector<Segment> &segments);
+        char *renderArgument(Argument &argument, const std::string &source, const std::string &destination);
+
+        std::vector<Argument> m_arguments; // Parsed arguments
+        std::vector<char *> m_argv; // Rendered argv
+        Limits m_limits; // Child process limits
+
+        bool m_hasSource { false }; // %1% present
+        bool m_hasDestination { false }; // %2% present
+        bool m_hasFiles { false }; // %files% present
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_SHELLCOMMAND_HPP */
+
@@ -66,6 +66,9 @@ namespace FPE_TaskActions {
             case 5:
                 return (std::shared_ptr<TaskAction> (new ImportCSVFile()));
                 break;
+            case 6:
+                return (std::shared_ptr<TaskAction> (new ExtractZIPFile()));
+                break;
         }
         
         return(nullptr);
@@ -0,0 +1,1245 @@
+//
+// Module: FPE_ZIPArchive
+//
+// Description: Append files to a ZIP archive that is held open between files.
+// Adding an entry costs only the entry itself; the central directory is
+// written after the last entry when the archive is flushed and is simply
+// overwritten by the next entry added. Local headers are written once their
+// entry is complete (their space is reserved, zeroed, first) so the archive
+// can always be recovered by walking the local headers from the start.
+// ZIP64 extra fields and end records are written only for entries, offsets
+// and archives that need them. Files that will not compress (known media and
+// archive formats by extension or magic bytes, or a high entropy sample of
+// their first blocks) are stored rather than deflated. An archive opened
+// read only can have its entries extracted by several threads at once.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// zlib               : Deflate compression and CRC32.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <array>
+#include <unordered_set>
+#include <ctime>
+
+//
+// zlib
+//
+
+#include <zlib.h>
+
+//
+// Linux
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//
+// Program components.
+//
+
+#include "FPE_ZIPArchive.hpp"
+
+namespace FPE_TaskActions {
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    //
+    // ZIP record signatures and sizes
+    //
+
+    constexpr std::uint32_t kLocalHeaderSignature { 0x04034b50 };
+    constexpr std::uint32_t kCentralHeaderSignature { 0x02014b50 };
+    constexpr std::uint32_t kEndOfCentralSignature { 0x06054b50 };
+    constexpr std::uint32_t kZIP64EndOfCentralSignature { 0x06064b50 };
+    constexpr std::uint32_t kZIP64LocatorSignature { 0x07064b50 };
+
+    constexpr std::size_t kLocalHeaderSize { 30 };
+    constexpr std::size_t kCentralHeaderSize { 46 };
+    constexpr std::size_t kEndOfCentralSize { 22 };
+    constexpr std::size_t kZIP64EndOfCentralSize { 56 };
+    constexpr std::size_t kZIP64LocatorSize { 20 };
+    constexpr std::size_t kMaxCommentSize { 0xffff };
+
+    constexpr std::uint16_t kVersionNeeded { 20 }; // Deflate
+    constexpr std::uint16_t kVersionZIP64 { 45 }; // ZIP64 extensions
+    constexpr std::uint16_t kVersionMadeBy { (3 << 8) | 63 }; // Unix, spec 6.3
+    constexpr std::uint16_t kMethodStore { 0 };
+    constexpr std::uint16_t kMethodDeflate { 8 };
+    constexpr std::uint16_t kFlagEncrypted { 0x0001 }; // Entry is encrypted
+    constexpr std::uint16_t kFlagUTF8 { 0x0800 }; // Entry name is UTF-8
+    constexpr std::uint16_t kFlagDataDescriptor { 0x0008 }; // Sizes follow data
+    constexpr std::uint16_t kZIP64ExtraId { 0x0001 }; // ZIP64 extended information
+
+    constexpr std::uint64_t kMax32 { 0xffffffff };
+    constexpr std::size_t kMax16 { 0xffff };
+
+    // Files this size or larger get a ZIP64 local header (sizes are only
+    // known once the entry is written, so leave room for deflate growth).
+
+    constexpr std::uint64_t kZIP64Threshold { 0xf0000000 };
+
+    constexpr std::size_t kBlockSize { 256 * 1024 }; // Bytes read/compressed at a time
+
+    //
+    // Incompressible content detection. Extensions and magic bytes of formats
+    // that are already compressed; otherwise a sample of the start of the file
+    // whose byte entropy is this close to 8 bits will not deflate.
+    //
+
+    static const std::unordered_set<std::string> kStoredExtensions {
+        "jpg", "jpeg", "png", "gif", "webp", "heic", "avif", "jp2",
+        "mp3", "m4a", "aac", "ogg", "oga", "opus", "flac", "wma",
+        "mp4", "m4v", "mov", "mkv", "webm", "avi", "wmv", "flv", "3gp", "mpg", "mpeg", "ts",
+        "gz", "tgz", "bz2", "tbz2", "xz", "txz", "zst", "lz4", "lzma", "z", "7z", "rar", "zip", "jar", "apk",
+        "docx", "xlsx", "pptx", "odt", "ods", "odp", "epub", "cab", "deb", "rpm"
+    };
+
+    static const std::vector<std::pair<std::size_t, std::string>> kStoredMagic {
+        {0, "\x1f\x8b"}, // gzip
+        {0, std::string("PK\x03\x04", 4)}, // ZIP (and Office/Java formats)
+        {0, "BZh"}, // bzip2
+        {0, std::string("\xfd" "7zXZ\x00", 6)}, // xz
+        {0, "\x28\xb5\x2f\xfd"}, // zstd
+        {0, "7z\xbc\xaf\x27\x1c"}, // 7-Zip
+        {0, "Rar!"}, // RAR
+        {0, "\x89PNG"}, // PNG
+        {0, "\xff\xd8\xff"}, // JPEG
+        {0, "GIF8"}, // GIF
+        {8, "WEBP"}, // WebP
+        {4, "ftyp"}, // MP4/MOV/HEIC
+        {0, "\x1a\x45\xdf\xa3"}, // Matroska/WebM
+        {0, "OggS"}, // Ogg
+        {0, "fLaC"}, // FLAC
+        {0, "ID3"} // MP3
+    };
+
+    constexpr std::size_t kSampleSize { 64 * 1024 }; // Bytes sampled from start of file
+    constexpr std::size_t kMinEntropySample { 4096 }; // Smaller samples are not judged on entropy
+    constexpr double kStoredEntropy { 7.5 }; // Bits per byte
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Little endian field access.
+    //
+
+    static void put16(std::string &buffer, std::uint16_t value) {
+        buffer += static_cast<char> (value & 0xff);
+        buffer += static_cast<char> ((value >> 8) & 0xff);
+    }
+
+    static void put32(std::string &buffer, std::uint32_t value) {
+        put16(buffer, static_cast<std::uint16_t> (value & 0xffff));
+        put16(buffer, static_cast<std::uint16_t> (value >> 16));
+    }
+
+    static void put64(std::string &buffer, std::uint64_t value) {
+        put32(buffer, static_cast<std::uint32_t> (value & kMax32));
+        put32(buffer, static_cast<std::uint32_t> (value >> 32));
+    }
+
+    static std::uint16_t get16(const unsigned char *buffer) {
+        return (static_cast<std::uint16_t> (buffer[0] | (buffer[1] << 8)));
+    }
+
+    static std::uint32_t get32(const unsigned char *buffer) {
+        return (static_cast<std::uint32_t> (get16(buffer)) | (static_cast<std::uint32_t> (get16(buffer + 2)) << 16));
+    }
+
+    static std::uint64_t get64(const unsigned char *buffer) {
+        return (static_cast<std::uint64_t> (get32(buffer)) | (static_cast<std::uint64_t> (get32(buffer + 4)) << 32));
+    }
+
+    //
+    // Take 64 bit sizes (and header offset) from a ZIP64 extra field. Only
+    // values whose 32 bit field is 0xffffffff are present, in this order.
+    //
+
+    static void readZIP64Extra(const unsigned char *extra, std::size_t extraLength, ZIPArchive::Entry &entry) {
+
+        for (std::size_t offset = 0; offset + 4 <= extraLength;) {
+
+            std::uint16_t id = get16(extra + offset);
+            std::size_t length = get16(extra + offset + 2);
+            const unsigned char *field = extra + offset + 4;
+            const unsigned char *fieldEnd = field + std::min(length, extraLength - offset - 4);
+
+            if (id == kZIP64ExtraId) {
+                if ((entry.uncompressedSize == kMax32) && (field + 8 <= fieldEnd)) {
+                    entry.uncompressedSize = get64(field);
+                    field += 8;
+                }
+                if ((entry.compressedSize == kMax32) && (field + 8 <= fieldEnd)) {
+                    entry.compressedSize = get64(field);
+                    field += 8;
+                }
+                if ((entry.headerOffset == kMax32) && (field + 8 <= fieldEnd)) {
+                    entry.headerOffset = get64(field);
+                }
+                break;
+            }
+
+            offset += 4 + length;
+
+        }
+
+    }
+
+    //
+    // Write all of buffer to file.
+    //
+
+    static void writeFile(int fileFd, const unsigned char *buffer, std::size_t length, const std::string &fileName) {
+
+        while (length > 0) {
+            ssize_t written = write(fileFd, buffer, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw ZIPArchive::Exception("Write to [" + fileName + "] failed: " + std::strerror(errno));
+            }
+            buffer += written;
+            length -= written;
+        }
+
+    }
+
+    //
+    // Version of entry name: name~version.ext
+    //
+
+    static std::string versionedName(const std::string &entryName, std::size_t version) {
+
+        std::size_t nameStart = entryName.rfind('/');
+        std::size_t extension = entryName.rfind('.');
+
+        nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+
+        if ((extension == std::string::npos) || (extension <= nameStart)) {
+            extension = entryName.length();
+        }
+
+        return (entryName.substr(0, extension) + "~" + std::to_string(version) + entryName.substr(extension));
+
+    }
+
+    //
+    // CRC32 of whole file (read without moving its file offset).
+    //
+
+    static std::uint32_t fileCRC32(int sourceFd) {
+
+        std::vector<unsigned char> readBuffer(kBlockSize);
+        std::uint32_t crc32Value = crc32(0L, Z_NULL, 0);
+        std::uint64_t offset = 0;
+        ssize_t bytesRead;
+
+        while ((bytesRead = pread(sourceFd, readBuffer.data(), readBuffer.size(), static_cast<off_t> (offset))) > 0) {
+            crc32Value = crc32(crc32Value, readBuffer.data(), static_cast<uInt> (bytesRead));
+            offset += bytesRead;
+        }
+
+        return (crc32Value);
+
+    }
+
+    //
+    // Shannon entropy of data in bits per byte.
+    //
+
+    static double entropy(const unsigned char *data, std::size_t length) {
+
+        std::array<std::size_t, 256> counts {};
+        double bits = 0.0;
+
+        for (std::size_t index = 0; index < length; index++) {
+            counts[data[index]]++;
+        }
+
+        for (auto count : counts) {
+            if (count) {
+                double probability = static_cast<double> (count) / length;
+                bits -= probability * std::log2(probability);
+            }
+        }
+
+        return (bits);
+
+    }
+
+    //
+    // Local header for entry. A ZIP64 header always carries both sizes in
+    // its extra field.
+    //
+
+    static std::string localHeader(const ZIPArchive::Entry &entry, bool bZIP64) {
+
+        std::string header;
+
+        put32(header, kLocalHeaderSignature);
+        put16(header, (bZIP64) ? kVersionZIP64 : kVersionNeeded);
+        put16(header, entry.flags);
+        put16(header, entry.method);
+        put16(header, entry.modTime);
+        put16(header, entry.modDate);
+        put32(header, entry.crc32);
+        put32(header, (bZIP64) ? kMax32 : static_cast<std::uint32_t> (entry.compressedSize));
+        put32(header, (bZIP64) ? kMax32 : static_cast<std::uint32_t> (entry.uncompressedSize));
+        put16(header, static_cast<std::uint16_t> (entry.name.length()));
+        put16(header, (bZIP64) ? 20 : 0);
+        header += entry.name;
+
+        if (bZIP64) {
+            put16(header, kZIP64ExtraId);
+            put16(header, 16);
+            put64(header, entry.uncompressedSize);
+            put64(header, entry.compressedSize);
+        }
+
+        return (header);
+
+    }
+
+    //
+    // MS-DOS date and time for a file modification time.
+    //
+
+    static void dosDateTime(std::time_t modified, ZIPArchive::Entry &entry) {
+
+        struct tm localTime {};
+
+        localtime_r(&modified, &localTime);
+
+        if (localTime.tm_year < 80) {
+            localTime = {};
+            localTime.tm_year = 80;
+            localTime.tm_mday = 1;
+        }
+
+        entry.modTime = static_cast<std::uint16_t> ((localTime.tm_hour << 11) | (localTime.tm_min << 5) | (localTime.tm_sec / 2));
+        entry.modDate = static_cast<std::uint16_t> (((localTime.tm_year - 80) << 9) | ((localTime.tm_mon + 1) << 5) | localTime.tm_mday);
+
+    }
+
+    //
+    // Write data at offset in archive.
+    //
+
+    void ZIPArchive::writeAt(std::uint64_t offset, const void *data, std::size_t length) {
+
+        const char *buffer = static_cast<const char *> (data);
+
+        while (length > 0) {
+            ssize_t written = pwrite(this->m_archiveFd, buffer, length, static_cast<off_t> (offset));
+            if (written < 0) {
+                throw Exception("Write to archive [" + this->m_archiveName + "] failed: " + std::strerror(errno));
+            }
+            buffer += written;
+            offset += written;
+            length -= written;
+        }
+
+    }
+
+    //
+    // Read data at offset in archive (false if not all there).
+    //
+
+    bool ZIPArchive::readAt(std::uint64_t offset, void *data, std::size_t length) {
+
+        char *buffer = static_cast<char *> (data);
+
+        while (length > 0) {
+            ssize_t bytesRead = pread(this->m_archiveFd, buffer, length, static_cast<off_t> (offset));
+            if (bytesRead <= 0) {
+                return (false);
+            }
+            buffer += bytesRead;
+            offset += bytesRead;
+            length -= bytesRead;
+        }
+
+        return (true);
+
+    }
+
+    //
+    // Read central directory located by the end of central directory record.
+    // Returns false if it is missing or damaged (for example partly overwritten
+    // by an entry added after it was written).
+    //
+
+    bool ZIPArchive::readCentralDirectory(std::uint64_t fileSize) {
+
+        std::size_t tailSize = static_cast<std::size_t> (std::min<std::uint64_t>(fileSize, kEndOfCentralSize + kMaxCommentSize));
+        std::vector<unsigned char> tail(tailSize);
+
+        if ((tailSize < kEndOfCentralSize) || !this->readAt(fileSize - tailSize, tail.data(), tailSize)) {
+            return (false);
+        }
+
+        std::size_t endOfCentral = tailSize - kEndOfCentralSize + 1;
+
+        do {
+            endOfCentral--;
+        } while ((endOfCentral > 0) && (get32(&tail[endOfCentral]) != kEndOfCentralSignature));
+
+        if (get32(&tail[endOfCentral]) != kEndOfCentralSignature) {
+            return (false);
+        }
+
+        std::uint64_t entryCount = get16(&tail[endOfCentral + 10]);
+        std::uint64_t centralSize = get32(&tail[endOfCentral + 12]);
+        std::uint64_t centralOffset = get32(&tail[endOfCentral + 16]);
+        std::uint64_t centralEnd = fileSize - tailSize + endOfCentral;
+
+        // ZIP64 end record (its locator immediately precedes the end record)
+
+        unsigned char locator[kZIP64LocatorSize];
+
+        if ((centralEnd >= kZIP64LocatorSize) && this->readAt(centralEnd - kZIP64LocatorSize, locator, kZIP64LocatorSize) &&
+                (get32(locator) == kZIP64LocatorSignature)) {
+            unsigned char zip64End[kZIP64EndOfCentralSize];
+            centralEnd = get64(locator + 8);
+            if (!this->readAt(centralEnd, zip64End, kZIP64EndOfCentralSize) || (get32(zip64End) != kZIP64EndOfCentralSignature)) {
+                return (false);
+            }
+            entryCount = get64(zip64End + 32);
+            centralSize = get64(zip64End + 40);
+            centralOffset = get64(zip64End + 48);
+        }
+
+        if (centralOffset + centralSize != centralEnd) {
+            return (false);
+        }
+
+        std::vector<unsigned char> central(centralSize);
+        std::vector<Entry> entries;
+
+        if (!this->readAt(centralOffset, central.data(), central.size())) {
+            return (false);
+        }
+
+        for (std::size_t offset = 0; entries.size() < entryCount;) {
+
+            if ((offset + kCentralHeaderSize > central.size()) || (get32(&central[offset]) != kCentralHeaderSignature)) {
+                return (false);
+            }
+
+            const unsigned char *header = &central[offset];
+            std::size_t nameLength = get16(header + 28);
+            std::size_t extraLength = get16(header + 30);
+            std::size_t commentLength = get16(header + 32);
+            Entry entry;
+
+            if (offset + kCentralHeaderSize + nameLength + extraLength + commentLength > central.size()) {
+                return (false);
+            }
+
+            entry.flags = get16(header + 8);
+            entry.method = get16(header + 10);
+            entry.modTime = get16(header + 12);
+            entry.modDate = get16(header + 14);
+            entry.crc32 = get32(header + 16);
+            entry.compressedSize = get32(header + 20);
+            entry.uncompressedSize = get32(header + 24);
+            entry.externalAttributes = get32(header + 38);
+            entry.headerOffset = get32(header + 42);
+            entry.name.assign(reinterpret_cast<const char *> (header + kCentralHeaderSize), nameLength);
+            readZIP64Extra(header + kCentralHeaderSize + nameLength, extraLength, entry);
+
+            entries.push_back(entry);
+            offset += kCentralHeaderSize + nameLength + extraLength + commentLength;
+
+        }
+
+        this->m_entries = std::move(entries);
+        this->m_dataEnd = centralOffset;
+
+        return (true);
+
+    }
+
+    //
+    // Rebuild entry list by walking local headers from the start of the archive.
+    // Stops at the first header that is missing, incomplete or has its sizes in
+    // a data descriptor; anything after that point is discarded on next flush.
+    //
+
+    void ZIPArchive::recoverEntries(std::uint64_t fileSize) {
+
+        std::uint64_t offset = 0;
+        unsigned char header[kLocalHeaderSize];
+
+        this->m_entries.clear();
+
+        while (this->readAt(offset, header, kLocalHeaderSize) && (get32(header) == kLocalHeaderSignature)) {
+
+            std::size_t nameLength = get16(header + 26);
+            std::size_t extraLength = get16(header + 28);
+            Entry entry;
+
+            entry.flags = get16(header + 6);
+            entry.method = get16(header + 8);
+            entry.modTime = get16(header + 10);
+            entry.modDate = get16(header + 12);
+            entry.crc32 = get32(header + 14);
+            entry.compressedSize = get32(header + 18);
+            entry.uncompressedSize = get32(header + 22);
+            entry.headerOffset = offset;
+            entry.externalAttributes = 0100644u << 16;
+            entry.name.resize(nameLength);
+
+            std::vector<unsigned char> extra(extraLength);
+
+            if ((entry.flags & kFlagDataDescriptor) || !this->readAt(offset + kLocalHeaderSize, &entry.name[0], nameLength) ||
+                    !this->readAt(offset + kLocalHeaderSize + nameLength, extra.data(), extraLength)) {
+                break;
+            }
+
+            readZIP64Extra(extra.data(), extraLength, entry);
+
+            std::uint64_t entryEnd = offset + kLocalHeaderSize + nameLength + extraLength + entry.compressedSize;
+
+            if (entryEnd > fileSize) {
+                break;
+            }
+
+            this->m_entries.push_back(entry);
+            offset = entryEnd;
+
+        }
+
+        if (this->m_entries.empty()) {
+            throw Exception("Archive [" + this->m_archiveName + "] has no readable central directory or entries.");
+        }
+
+        this->m_dataEnd = offset;
+        this->m_bDirty = true;
+
+        std::cerr << "Archive [" << this->m_archiveName << "] central directory rebuilt; "
+                << this->m_entries.size() << " entries recovered." << std::endl;
+
+    }
+
+    //
+    // Load central directory of an existing archive or recover it.
+    //
+
+    void ZIPArchive::loadCentralDirectory(void) {
+
+        struct stat fileStat;
+
+        if (fstat(this->m_archiveFd, &fileStat) != 0) {
+            throw Exception("Could not stat archive [" + this->m_archiveName + "]");
+        }
+
+        this->m_entries.clear();
+        this->m_dataEnd = 0;
+        this->m_bDirty = false;
+
+        std::uint64_t fileSize = static_cast<std::uint64_t> (fileStat.st_size);
+
+        if (fileSize == 0) {
+            this->m_bDirty = true;
+        } else if (!this->readCentralDirectory(fileSize)) {
+            this->recoverEntries(fileSize);
+        }
+
+        this->m_index.clear();
+        this->m_index.reserve(this->m_entries.size());
+
+        for (std::size_t index = 0; index < this->m_entries.size(); index++) {
+            this->m_index[this->m_entries[index].name] = index;
+        }
+
+    }
+
+    //
+    // Name to add a file under given the duplicate handling. Empty if an entry
+    // of that name (or in version mode any version of it) has the same size
+    // and CRC; the file's CRC is only calculated if a size matches.
+    //
+
+    std::string ZIPArchive::uniqueName(int sourceFd, std::uint64_t sourceSize, const std::string &entryName) {
+
+        if ((this->m_duplicates == Duplicates::add) || (this->m_index.count(entryName) == 0)) {
+            return (entryName);
+        }
+
+        std::string name { entryName };
+        std::uint32_t sourceCRC32 = 0;
+        bool bCRC32 = false;
+
+        for (std::size_t version = 2;; version++) {
+
+            auto found = this->m_index.find(name);
+
+            if (found == this->m_index.end()) {
+                return (name);
+            }
+
+            const Entry &entry = this->m_entries[found->second];
+
+            if (entry.uncompressedSize == sourceSize) {
+                if (!bCRC32) {
+                    sourceCRC32 = fileCRC32(sourceFd);
+                    bCRC32 = true;
+                }
+                if (entry.crc32 == sourceCRC32) {
+                    return ("");
+                }
+            }
+
+            if (this->m_duplicates == Duplicates::skip) {
+                return (entryName);
+            }
+
+            name = versionedName(entryName, version);
+
+        }
+
+    }
+
+    //
+    // Write central directory and end record after the last entry then cut the
+    // archive off after them.
+    //
+
+    void ZIPArchive::writeCentralDirectory(void) {
+
+        std::string central;
+
+        for (auto &entry : this->m_entries) {
+
+            std::string zip64Extra;
+
+            if (entry.uncompressedSize >= kMax32) {
+                put64(zip64Extra, entry.uncompressedSize);
+            }
+            if (entry.compressedSize >= kMax32) {
+                put64(zip64Extra, entry.compressedSize);
+            }
+            if (entry.headerOffset >= kMax32) {
+                put64(zip64Extra, entry.headerOffset);
+            }
+
+            put32(central, kCentralHeaderSignature);
+            put16(central, kVersionMadeBy);
+            put16(central, (zip64Extra.empty()) ? kVersionNeeded : kVersionZIP64);
+            put16(central, entry.flags);
+            put16(central, entry.method);
+            put16(central, entry.modTime);
+            put16(central, entry.modDate);
+            put32(central, entry.crc32);
+            put32(central, static_cast<std::uint32_t> (std::min(entry.compressedSize, kMax32)));
+            put32(central, static_cast<std::uint32_t> (std::min(entry.uncompressedSize, kMax32)));
+            put16(central, static_cast<std::uint16_t> (entry.name.length()));
+            put16(central, static_cast<std::uint16_t> ((zip64Extra.empty()) ? 0 : zip64Extra.length() + 4));
+            put16(central, 0);
+            put16(central, 0);
+            put16(central, 0);
+            put32(central, entry.externalAttributes);
+            put32(central, static_cast<std::uint32_t> (std::min(entry.headerOffset, kMax32)));
+            central += entry.name;
+
+            if (!zip64Extra.empty()) {
+                put16(central, kZIP64ExtraId);
+                put16(central, static_cast<std::uint16_t> (zip64Extra.length()));
+                central += zip64Extra;
+            }
+
+        }
+
+        std::uint64_t centralSize = central.length();
+        std::uint64_t entryCount = this->m_entries.size();
+
+        // ZIP64 end record and locator when a count, size or offset overflows
+
+        if ((entryCount >= kMax16) || (centralSize >= kMax32) || (this->m_dataEnd >= kMax32)) {
+            put32(central, kZIP64EndOfCentralSignature);
+            put64(central, kZIP64EndOfCentralSize - 12);
+            put16(central, kVersionMadeBy);
+            put16(central, kVersionZIP64);
+            put32(central, 0);
+            put32(central, 0);
+            put64(central, entryCount);
+            put64(central, entryCount);
+            put64(central, centralSize);
+            put64(central, this->m_dataEnd);
+            put32(central, kZIP64LocatorSignature);
+            put32(central, 0);
+            put64(central, this->m_dataEnd + centralSize);
+            put32(central, 1);
+        }
+
+        put32(central, kEndOfCentralSignature);
+        put16(central, 0);
+        put16(central, 0);
+        put16(central, static_cast<std::uint16_t> (std::min<std::uint64_t>(entryCount, kMax16)));
+        put16(central, static_cast<std::uint16_t> (std::min<std::uint64_t>(entryCount, kMax16)));
+        put32(central, static_cast<std::uint32_t> (std::min(centralSize, kMax32)));
+        put32(central, static_cast<std::uint32_t> (std::min(this->m_dataEnd, kMax32)));
+        put16(central, 0);
+
+        this->writeAt(this->m_dataEnd, central.data(), central.length());
+
+        if (ftruncate(this->m_archiveFd, static_cast<off_t> (this->m_dataEnd + central.length())) != 0) {
+            throw Exception("Could not truncate archive [" + this->m_archiveName + "]");
+        }
+
+        fdatasync(this->m_archiveFd);
+
+        this->m_bDirty = false;
+        this->m_unflushed = 0;
+
+    }
+
+    //
+    // Copy file into archive at data offset as is.
+    //
+
+    void ZIPArchive::storeEntry(int sourceFd, Entry &entry, std::uint64_t dataOffset) {
+
+        std::vector<unsigned char> readBuffer(kBlockSize);
+        ssize_t bytesRead;
+
+        entry.crc32 = crc32(0L, Z_NULL, 0);
+
+        while ((bytesRead = read(sourceFd, readBuffer.data(), readBuffer.size())) != 0) {
+            if (bytesRead < 0) {
+                throw Exception("Read of [" + entry.name + "] failed: " + std::strerror(errno));
+            }
+            entry.crc32 = crc32(entry.crc32, readBuffer.data(), static_cast<uInt> (bytesRead));
+            this->writeAt(dataOffset + entry.compressedSize, readBuffer.data(), bytesRead);
+            entry.compressedSize += bytesRead;
+            entry.uncompressedSize += bytesRead;
+        }
+
+    }
+
+    //
+    // Deflate file into archive at data offset on the calling thread.
+    //
+
+    void ZIPArchive::deflateEntry(int sourceFd, Entry &entry, std::uint64_t dataOffset) {
+
+        z_stream deflateStream {};
+        std::vector<unsigned char> readBuffer(kBlockSize);
+        std::vector<unsigned char> deflateBuffer(kBlockSize);
+
+        if (deflateInit2(&deflateStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw Exception("Could not initialise deflate.");
+        }
+
+        try {
+
+            int flush = Z_NO_FLUSH;
+
+            entry.crc32 = crc32(0L, Z_NULL, 0);
+
+            do {
+
+                ssize_t bytesRead = read(sourceFd, readBuffer.data(), readBuffer.size());
+                if (bytesRead < 0) {
+                    throw Exception("Read of [" + entry.name + "] failed: " + std::strerror(errno));
+                }
+
+                flush = (bytesRead == 0) ? Z_FINISH : Z_NO_FLUSH;
+                entry.crc32 = crc32(entry.crc32, readBuffer.data(), static_cast<uInt> (bytesRead));
+                entry.uncompressedSize += bytesRead;
+
+                deflateStream.next_in = readBuffer.data();
+                deflateStream.avail_in = static_cast<uInt> (bytesRead);
+
+                do {
+                    deflateStream.next_out = deflateBuffer.data();
+                    deflateStream.avail_out = static_cast<uInt> (deflateBuffer.size());
+                    deflate(&deflateStream, flush);
+                    std::size_t deflated = deflateBuffer.size() - deflateStream.avail_out;
+                    this->writeAt(dataOffset + entry.compressedSize, deflateBuffer.data(), deflated);
+                    entry.compressedSize += deflated;
+                } while (deflateStream.avail_out == 0);
+
+            } while (flush != Z_FINISH);
+
+        } catch (...) {
+            deflateEnd(&deflateStream);
+            throw;
+        }
+
+        deflateEnd(&deflateStream);
+
+    }
+
+    //
+    // Idle flush thread. Write central directory once no entry has been added
+    // for the idle time.
+    //
+
+    void ZIPArchive::idleFlush(void) {
+
+        std::unique_lock<std::mutex> locker(this->m_archiveMutex);
+
+        while (!this->m_stop) {
+
+            if (!this->m_bDirty || (this->m_archiveFd == -1)) {
+                this->m_flushWakeup.wait(locker);
+                continue;
+            }
+
+            auto deadline = this->m_lastAdd + this->m_idleFlush;
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                try {
+                    this->writeCentralDirectory();
+                } catch (const std::exception &e) {
+                    std::cerr << e.what() << std::endl;
+                    this->m_flushWakeup.wait(locker);
+                }
+            } else {
+                this->m_flushWakeup.wait_until(locker, deadline);
+            }
+
+        }
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    ZIPArchive::ZIPArchive(const std::string &archiveName) : m_archiveName{archiveName} {
+
+    }
+
+    ZIPArchive::~ZIPArchive() {
+
+        try {
+            this->close();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+
+    }
+
+    //
+    // Open archive creating it if it does not exist.
+    //
+
+    void ZIPArchive::open(bool bReadOnly) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        if (this->m_archiveFd != -1) {
+            throw Exception("Archive [" + this->m_archiveName + "] already open.");
+        }
+
+        this->m_bReadOnly = bReadOnly;
+        this->m_archiveFd = ::open(this->m_archiveName.c_str(), (bReadOnly) ? O_RDONLY | O_CLOEXEC : O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (this->m_archiveFd == -1) {
+            throw Exception("Could not open archive [" + this->m_archiveName + "]: " + std::strerror(errno));
+        }
+
+        try {
+            this->loadCentralDirectory();
+            if (bReadOnly) {
+                this->m_bDirty = false;
+            }
+        } catch (...) {
+            ::close(this->m_archiveFd);
+            this->m_archiveFd = -1;
+            throw;
+        }
+
+    }
+
+    //
+    // Flush and close archive (stopping idle flush thread).
+    //
+
+    void ZIPArchive::close(void) {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+            this->m_stop = true;
+        }
+
+        this->m_flushWakeup.notify_one();
+        if (this->m_flushThread.joinable()) {
+            this->m_flushThread.join();
+        }
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        if (this->m_archiveFd != -1) {
+            int archiveFd = this->m_archiveFd;
+            try {
+                if (this->m_bDirty) {
+                    this->writeCentralDirectory();
+                }
+            } catch (...) {
+                ::close(archiveFd);
+                this->m_archiveFd = -1;
+                throw;
+            }
+            ::close(archiveFd);
+            this->m_archiveFd = -1;
+        }
+
+    }
+
+    //
+    // Add file to end of archive deflating it a block at a time (or storing
+    // it if it will not compress). The local
+    // header's space is zeroed first (which also invalidates any central
+    // directory written there) and the header written once sizes and CRC are
+    // known.
+    //
+
+    std::string ZIPArchive::add(const std::string &fileName, const std::string &entryName) {
+
+        int sourceFd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        if (sourceFd == -1) {
+            throw Exception("Could not open [" + fileName + "]: " + std::strerror(errno));
+        }
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        try {
+
+            struct stat sourceStat;
+            Entry entry;
+
+            if (this->m_archiveFd == -1) {
+                throw Exception("Archive [" + this->m_archiveName + "] not open.");
+            }
+
+            if (this->m_bReadOnly) {
+                throw Exception("Archive [" + this->m_archiveName + "] opened read only.");
+            }
+
+            if (fstat(sourceFd, &sourceStat) != 0) {
+                throw Exception("Could not stat [" + fileName + "]");
+            }
+
+            entry.name = this->uniqueName(sourceFd, static_cast<std::uint64_t> (sourceStat.st_size), entryName);
+
+            if (entry.name.empty()) {
+                ::close(sourceFd);
+                return (entry.name);
+            }
+
+            if (entry.name.length() > kMax16) {
+                throw Exception("Entry name too long [" + entry.name + "]");
+            }
+
+            std::vector<unsigned char> sample(kSampleSize);
+            ssize_t sampleLength = pread(sourceFd, sample.data(), sample.size(), 0);
+
+            entry.flags = kFlagUTF8;
+            entry.method = (isIncompressible(entryName, sample.data(), (sampleLength > 0) ? sampleLength : 0)) ? kMethodStore : kMethodDeflate;
+            entry.headerOffset = this->m_dataEnd;
+            entry.externalAttributes = static_cast<std::uint32_t> (sourceStat.st_mode & 0xffff) << 16;
+            dosDateTime(sourceStat.st_mtime, entry);
+
+            bool bZIP64 = static_cast<std::uint64_t> (sourceStat.st_size) >= kZIP64Threshold;
+            std::string header { localHeader(entry, bZIP64) };
+            std::string reserved(header.length(), '\0');
+            std::uint64_t dataOffset = entry.headerOffset + header.length();
+
+            this->writeAt(entry.headerOffset, reserved.data(), reserved.length());
+            this->m_bDirty = true;
+
+            if (entry.method == kMethodStore) {
+                this->storeEntry(sourceFd, entry, dataOffset);
+            } else if (this->m_parallelDeflate && (sourceStat.st_size > static_cast<off_t> (ParallelDeflate::kDefaultChunkSize))) {
+                this->m_parallelDeflate->deflateFile(sourceFd, [this, &entry, dataOffset] (const unsigned char *data, std::size_t length) {
+                    this->writeAt(dataOffset + entry.compressedSize, data, length);
+                    entry.compressedSize += length;
+                }, entry.crc32, entry.uncompressedSize);
+            } else {
+                this->deflateEntry(sourceFd, entry, dataOffset);
+            }
+
+            if (!bZIP64 && ((entry.uncompressedSize >= kMax32) || (entry.compressedSize >= kMax32))) {
+                throw Exception("File [" + fileName + "] grew past 4GB while being added.");
+            }
+
+            header = localHeader(entry, bZIP64);
+            this->writeAt(entry.headerOffset, header.data(), header.length());
+
+            this->m_entries.push_back(entry);
+            this->m_index[entry.name] = this->m_entries.size() - 1;
+            this->m_dataEnd = dataOffset + entry.compressedSize;
+            this->m_lastAdd = std::chrono::steady_clock::now();
+
+            if (this->m_flushEntries && (++this->m_unflushed >= this->m_flushEntries)) {
+                this->writeCentralDirectory();
+            }
+
+            ::close(sourceFd);
+
+            this->m_flushWakeup.notify_one();
+
+            return (entry.name);
+
+        } catch (...) {
+            ::close(sourceFd);
+            throw;
+        }
+
+    }
+
+    //
+    // Extract entry to file checking its size and CRC (the file is removed if
+    // either is wrong). The archive is only read with pread() so entries may
+    // be extracted by several threads at once while it is open.
+    //
+
+    void ZIPArchive::extract(const Entry &entry, const std::string &fileName) {
+
+        unsigned char header[kLocalHeaderSize];
+
+        if (this->m_archiveFd == -1) {
+            throw Exception("Archive [" + this->m_archiveName + "] not open.");
+        }
+
+        if (!this->readAt(entry.headerOffset, header, kLocalHeaderSize) || (get32(header) != kLocalHeaderSignature)) {
+            throw Exception("Local header for [" + entry.name + "] missing.");
+        }
+
+        if (entry.flags & kFlagEncrypted) {
+            throw Exception("Entry [" + entry.name + "] is encrypted.");
+        }
+
+        if ((entry.method != kMethodStore) && (entry.method != kMethodDeflate)) {
+            throw Exception("Entry [" + entry.name + "] has unsupported compression method " + std::to_string(entry.method) + ".");
+        }
+
+        std::uint64_t dataOffset = entry.headerOffset + kLocalHeaderSize + get16(header + 26) + get16(header + 28);
+        mode_t mode = (entry.externalAttributes >> 16) & 0777;
+
+        // Never write over (or through a link at) an existing file; a file
+        // that fails its check is only removed because it was created here
+
+        int destinationFd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, (mode) ? mode : 0644);
+        if (destinationFd == -1) {
+            throw Exception("Could not create [" + fileName + "]: " + std::strerror(errno));
+        }
+
+        z_stream inflateStream {};
+        std::vector<unsigned char> readBuffer(kBlockSize);
+        std::vector<unsigned char> inflateBuffer(kBlockSize);
+        std::uint32_t crc32Value = crc32(0L, Z_NULL, 0);
+        std::uint64_t uncompressedSize = 0;
+        int result = Z_STREAM_END;
+
+        if ((entry.method == kMethodDeflate) && (inflateInit2(&inflateStream, -MAX_WBITS) != Z_OK)) {
+            ::close(destinationFd);
+            throw Exception("Could not initialise inflate.");
+        }
+
+        try {
+
+            for (std::uint64_t offset = 0; offset < entry.compressedSize;) {
+
+                std::size_t length = static_cast<std::size_t> (std::min<std::uint64_t>(readBuffer.size(), entry.compressedSize - offset));
+
+                if (!this->readAt(dataOffset + offset, readBuffer.data(), length)) {
+                    throw Exception("Entry [" + entry.name + "] is truncated.");
+                }
+
+                offset += length;
+
+                if (entry.method == kMethodStore) {
+                    crc32Value = crc32(crc32Value, readBuffer.data(), static_cast<uInt> (length));
+                    uncompressedSize += length;
+                    writeFile(destinationFd, readBuffer.data(), length, fileName);
+                    continue;
+                }
+
+                inflateStream.next_in = readBuffer.data();
+                inflateStream.avail_in = static_cast<uInt> (length);
+
+                do {
+                    inflateStream.next_out = inflateBuffer.data();
+                    inflateStream.avail_out = static_cast<uInt> (inflateBuffer.size());
+                    result = inflate(&inflateStream, Z_NO_FLUSH);
+                    if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR)) {
+                        throw Exception("Entry [" + entry.name + "] is corrupt.");
+                    }
+                    std::size_t inflated = inflateBuffer.size() - inflateStream.avail_out;
+                    crc32Value = crc32(crc32Value, inflateBuffer.data(), static_cast<uInt> (inflated));
+                    uncompressedSize += inflated;
+                    writeFile(destinationFd, inflateBuffer.data(), inflated, fileName);
+                } while ((inflateStream.avail_out == 0) && (result != Z_STREAM_END));
+
+            }
+
+            if (entry.method == kMethodDeflate) {
+                if (entry.compressedSize == 0) {
+                    result = Z_BUF_ERROR;
+                }
+                inflateEnd(&inflateStream);
+            }
+
+            if ((result != Z_STREAM_END) || (uncompressedSize != entry.uncompressedSize) || (crc32Value != entry.crc32)) {
+                throw Exception("Entry [" + entry.name + "] failed CRC/size check.");
+            }
+
+        } catch (...) {
+            if (entry.method == kMethodDeflate) {
+                inflateEnd(&inflateStream);
+            }
+            ::close(destinationFd);
+            unlink(fileName.c_str());
+            throw;
+        }
+
+        if (::close(destinationFd) != 0) {
+            unlink(fileName.c_str());
+            throw Exception("Could not write [" + fileName + "]: " + std::strerror(errno));
+        }
+
+    }
+
+    void ZIPArchive::flush(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        if ((this->m_archiveFd != -1) && this->m_bDirty) {
+            this->writeCentralDirectory();
+        }
+
+    }
+
+    //
+    // Set flush interval starting idle flush thread if needed.
+    //
+
+    void ZIPArchive::setFlushInterval(std::size_t flushEntries, std::chrono::seconds idleFlush) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        this->m_flushEntries = flushEntries;
+        this->m_idleFlush = idleFlush;
+
+        if ((idleFlush.count() > 0) && !this->m_flushThread.joinable()) {
+            this->m_stop = false;
+            this->m_flushThread = std::thread(&ZIPArchive::idleFlush, this);
+        }
+
+    }
+
+    //
+    // Deflate files larger than a chunk on a pool of threads (1 for none).
+    //
+
+    void ZIPArchive::setThreads(std::size_t threads) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        this->m_parallelDeflate.reset((threads > 1) ? new ParallelDeflate(threads, Z_DEFAULT_COMPRESSION) : nullptr);
+
+    }
+
+    //
+    // Entry will not compress: a compressed format by extension or magic bytes
+    // or a sample of its start with near random byte values.
+    //
+
+    bool ZIPArchive::isIncompressible(const std::string &entryName, const unsigned char *sample, std::size_t sampleLength) {
+
+        std::size_t extensionStart = entryName.rfind('.');
+
+        if ((extensionStart != std::string::npos) && (entryName.find('/', extensionStart) == std::string::npos)) {
+            std::string extension { entryName.substr(extensionStart + 1) };
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (kStoredExtensions.count(extension)) {
+                return (true);
+            }
+        }
+
+        for (auto &magic : kStoredMagic) {
+            if ((sampleLength >= magic.first + magic.second.length()) &&
+                    (std::memcmp(sample + magic.first, magic.second.data(), magic.second.length()) == 0)) {
+                return (true);
+            }
+        }
+
+        return ((sampleLength >= kMinEntropySample) && (entropy(sample, sampleLength) >= kStoredEntropy));
+
+    }
+
+    void ZIPArchive::setDuplicates(Duplicates duplicates) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        this->m_duplicates = duplicates;
+
+    }
+
+    bool ZIPArchive::find(const std::string &entryName, Entry &entry) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        auto found = this->m_index.find(entryName);
+
+        if (found != this->m_index.end()) {
+            entry = this->m_entries[found->second];
+            return (true);
+        }
+
+        return (false);
+
+    }
+
+    std::size_t ZIPArchive::entryCount(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        return (this->m_entries.size());
+
+    }
+
+    std::uint64_t ZIPArchive::size(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        return (this->m_dataEnd);
+
+    }
+
+    std::vector<ZIPArchive::Entry> ZIPArchive::entries(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_archiveMutex);
+
+        return (this->m_entries);
+
+    }
+
+} // namespace FPE_TaskActions
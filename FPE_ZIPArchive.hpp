@@ -0,0 +1,177 @@
+#ifndef FPE_ZIPARCHIVE_HPP
+#define FPE_ZIPARCHIVE_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_ParallelDeflate.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ZIPArchive class. A ZIP archive that is kept open while files are
+    // appended to it. Entries are written after the last entry and the
+    // central directory is only rewritten (after the entries) on a flush:
+    // every so many entries, after the archive has been idle for a time and
+    // on close. Each local header is written only once its entry is complete
+    // so if FPE stops before a flush the central directory is rebuilt from
+    // the local headers when the archive is next opened. ZIP64 is used once
+    // an archive passes 65535 entries or 4GB. Entries that will not compress
+    // are stored. Entry names are indexed so that a file already in the
+    // archive can be skipped (or added under a new version name) without
+    // searching the central directory.
+    //
+
+    class ZIPArchive {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("ZIPArchive Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Archive entry (central directory details)
+        //
+
+        struct Entry {
+            std::string name; // Entry name
+            std::uint16_t flags { 0 }; // General purpose flags
+            std::uint16_t method { 0 }; // Compression method (0 store, 8 deflate)
+            std::uint32_t crc32 { 0 }; // CRC32 of uncompressed data
+            std::uint64_t compressedSize { 0 }; // Compressed size
+            std::uint64_t uncompressedSize { 0 }; // Uncompressed size
+            std::uint64_t headerOffset { 0 }; // Offset of local header
+            std::uint16_t modTime { 0 }; // MS-DOS modification time
+            std::uint16_t modDate { 0 }; // MS-DOS modification date
+            std::uint32_t externalAttributes { 0 }; // Unix mode (high 16 bits)
+        };
+
+        //
+        // What to do when adding an entry whose name is already in archive
+        //
+
+        enum class Duplicates {
+            add = 0, // Add entry again under same name
+            skip, // Skip if same size and CRC as the last entry of that name
+            version // Skip if same as any version, else add as name~2.ext, name~3.ext ...
+        };
+
+        explicit ZIPArchive(const std::string &archiveName);
+
+        ~ZIPArchive();
+
+        // Open archive (creating it if needed unless read only) and close it
+
+        void open(bool bReadOnly = false);
+        void close(void);
+
+        // Add file to archive as entry name. Returns name of entry added
+        // (empty if the file was skipped as a duplicate).
+
+        std::string add(const std::string &fileName, const std::string &entryName);
+
+        // Extract entry to a new file (may be called from several threads
+        // for different files; throws if the file already exists)
+
+        void extract(const Entry &entry, const std::string &fileName);
+
+        // Write central directory if entries have been added since last flush
+
+        void flush(void);
+
+        // Flush after a number of entries and after idle time (0 for never)
+
+        void setFlushInterval(std::size_t flushEntries, std::chrono::seconds idleFlush);
+
+        // Threads used to deflate large files (1 deflates on caller's thread)
+
+        void setThreads(std::size_t threads);
+
+        // Handling of entry names already in archive
+
+        void setDuplicates(Duplicates duplicates);
+
+        // Find last entry with name (false if none)
+
+        bool find(const std::string &entryName, Entry &entry);
+
+        // Entry should be stored not deflated (judged on its name and a
+        // sample of its first bytes)
+
+        static bool isIncompressible(const std::string &entryName, const unsigned char *sample, std::size_t sampleLength);
+
+        // Archive entries, their number and bytes of entry data
+
+        std::vector<Entry> entries(void);
+        std::size_t entryCount(void);
+        std::uint64_t size(void);
+
+    private:
+
+        ZIPArchive(const ZIPArchive&) = delete;
+        ZIPArchive& operator=(const ZIPArchive&) = delete;
+
+        void loadCentralDirectory(void);
+        std::string uniqueName(int sourceFd, std::uint64_t sourceSize, const std::string &entryName);
+        bool readCentralDirectory(std::uint64_t fileSize);
+        void recoverEntries(std::uint64_t fileSize);
+        void writeCentralDirectory(void);
+        void storeEntry(int sourceFd, Entry &entry, std::uint64_t dataOffset);
+        void deflateEntry(int sourceFd, Entry &entry, std::uint64_t dataOffset);
+        void writeAt(std::uint64_t offset, const void *data, std::size_t length);
+        bool readAt(std::uint64_t offset, void *data, std::size_t length);
+        void idleFlush(void);
+
+        std::string m_archiveName; // Archive file name
+        int m_archiveFd { -1 }; // Archive file descriptor
+        bool m_bReadOnly { false }; // Opened read only
+        std::vector<Entry> m_entries; // Entries in archive
+        std::unordered_map<std::string, std::size_t> m_index; // Entry name to its last entry
+        Duplicates m_duplicates { Duplicates::add }; // Duplicate entry name handling
+        std::uint64_t m_dataEnd { 0 }; // Offset after last entry
+        std::size_t m_unflushed { 0 }; // Entries added since last flush
+        bool m_bDirty { false }; // Central directory needs writing
+        std::unique_ptr<ParallelDeflate> m_parallelDeflate; // Deflate worker pool (null for none)
+
+        std::size_t m_flushEntries { 0 }; // Flush after this many entries
+        std::chrono::seconds m_idleFlush { 0 }; // Flush after idle for
+        std::chrono::steady_clock::time_point m_lastAdd; // Time of last add
+
+        bool m_stop { false }; // Stop idle flush thread
+        std::mutex m_archiveMutex; // Protects archive
+        std::condition_variable m_flushWakeup; // Idle flush thread wakeup
+        std::thread m_flushThread; // Idle flush thread
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_ZIPARCHIVE_HPP */
+
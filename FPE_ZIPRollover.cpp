@@ -0,0 +1,434 @@
+//
+// Module: FPE_ZIPRollover
+//
+// Description: Rolling ZIP archive series. Each archive name is produced
+// from a pattern (strftime() plus %n sequence and %i shard numbers) and a
+// new archive is started on an entry count, byte size or age limit or when
+// the time part of the name changes. Sharded series are written in
+// parallel, one thread per shard.
+//
+// Dependencies:
+//
+// C11++              : Use of C11++ features.
+// Linux              : Target platform
+//
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// C++ STL
+//
+
+#include <iostream>
+#include <filesystem>
+#include <functional>
+
+//
+// Program components.
+//
+
+#include "FPE_ZIPRollover.hpp"
+
+namespace FPE_TaskActions {
+
+    // =======
+    // IMPORTS
+    // =======
+
+    namespace fs = std::filesystem;
+
+    // ===============
+    // LOCAL VARIABLES
+    // ===============
+
+    constexpr std::size_t kQueuedPerShard { 16 }; // Files waiting per shard before add() blocks
+
+    // ===============
+    // LOCAL FUNCTIONS
+    // ===============
+
+    //
+    // Insert "-token" before the extension of a pattern's file name if the
+    // pattern does not already contain the token.
+    //
+
+    static std::string insertToken(const std::string &pattern, const std::string &token) {
+
+        if (pattern.find(token) != std::string::npos) {
+            return (pattern);
+        }
+
+        std::size_t nameStart = pattern.rfind('/');
+        std::size_t extension = pattern.rfind('.');
+
+        nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+
+        if ((extension == std::string::npos) || (extension <= nameStart)) {
+            return (pattern + "-" + token);
+        }
+
+        return (pattern.substr(0, extension) + "-" + token + pattern.substr(extension));
+
+    }
+
+    //
+    // Open current archive (and its directory) for the time, moving on to the
+    // highest sequence number already on disk.
+    //
+
+    void ZIPRollover::openArchive(std::time_t now) {
+
+        this->m_period = archiveName(this->m_pattern, now, 0, this->m_shard);
+
+        if (archiveName(this->m_pattern, now, 1, this->m_shard) != archiveName(this->m_pattern, now, 2, this->m_shard)) {
+            while (fs::exists(archiveName(this->m_pattern, now, this->m_sequence + 1, this->m_shard))) {
+                this->m_sequence++;
+            }
+        }
+
+        this->m_archiveName = archiveName(this->m_pattern, now, this->m_sequence, this->m_shard);
+
+        fs::path parentPath { fs::path(this->m_archiveName).parent_path() };
+
+        if (!parentPath.empty() && !fs::exists(parentPath)) {
+            fs::create_directories(parentPath);
+            std::cout << "Created : " << parentPath.string() << std::endl;
+        }
+
+        if (!fs::exists(this->m_archiveName)) {
+            std::cout << "Creating archive " << this->m_archiveName << std::endl;
+        }
+
+        this->m_archive.reset(new ZIPArchive(this->m_archiveName));
+        this->m_archive->setThreads(this->m_threads);
+        this->m_archive->setDuplicates(this->m_duplicates);
+        this->m_archive->open();
+        this->m_archive->setFlushInterval(this->m_flushEntries, this->m_idleFlush);
+        this->m_opened = std::chrono::steady_clock::now();
+
+    }
+
+    //
+    // Current archive is full (an empty archive never is).
+    //
+
+    bool ZIPRollover::rolloverDue(std::uint64_t fileSize) {
+
+        std::size_t entryCount = this->m_archive->entryCount();
+
+        if (entryCount == 0) {
+            return (false);
+        }
+
+        if ((this->m_limits.maxEntries) && (entryCount >= this->m_limits.maxEntries)) {
+            return (true);
+        }
+
+        if ((this->m_limits.maxBytes) && (this->m_archive->size() + fileSize > this->m_limits.maxBytes)) {
+            return (true);
+        }
+
+        return ((this->m_limits.maxAge.count() > 0) && (std::chrono::steady_clock::now() - this->m_opened >= this->m_limits.maxAge));
+
+    }
+
+    // ================
+    // PUBLIC FUNCTIONS
+    // ================
+
+    //
+    // Rollover limits need a sequence number and shards a shard number in the
+    // archive name so add them to the pattern if missing.
+    //
+
+    ZIPRollover::ZIPRollover(const std::string &pattern, const Limits &limits, std::size_t shard) :
+        m_pattern{pattern}, m_limits{limits}, m_shard{shard} {
+
+        if (shard != kNoShard) {
+            this->m_pattern = insertToken(this->m_pattern, "%i");
+        }
+
+        if ((limits.maxEntries) || (limits.maxBytes) || (limits.maxAge.count() > 0)) {
+            this->m_pattern = insertToken(this->m_pattern, "%n");
+        }
+
+    }
+
+    ZIPRollover::~ZIPRollover() {
+
+        try {
+            this->close();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+
+    }
+
+    void ZIPRollover::setFlushInterval(std::size_t flushEntries, std::chrono::seconds idleFlush) {
+
+        this->m_flushEntries = flushEntries;
+        this->m_idleFlush = idleFlush;
+
+        if (this->m_archive) {
+            this->m_archive->setFlushInterval(flushEntries, idleFlush);
+        }
+
+    }
+
+    void ZIPRollover::setThreads(std::size_t threads) {
+
+        this->m_threads = threads;
+
+        if (this->m_archive) {
+            this->m_archive->setThreads(threads);
+        }
+
+    }
+
+    void ZIPRollover::setDuplicates(ZIPArchive::Duplicates duplicates) {
+
+        this->m_duplicates = duplicates;
+
+        if (this->m_archive) {
+            this->m_archive->setDuplicates(duplicates);
+        }
+
+    }
+
+    void ZIPRollover::open(void) {
+
+        if (this->m_archive) {
+            throw Exception("Archive [" + this->m_archiveName + "] already open.");
+        }
+
+        this->m_sequence = 1;
+        this->openArchive(std::time(nullptr));
+
+    }
+
+    void ZIPRollover::close(void) {
+
+        if (this->m_archive) {
+            std::unique_ptr<ZIPArchive> archive { std::move(this->m_archive) };
+            archive->close();
+        }
+
+    }
+
+    //
+    // Add file rolling over to a new archive first if the time part of the
+    // name has changed (sequence restarts) or a limit has been reached.
+    //
+
+    std::string ZIPRollover::add(const std::string &fileName, const std::string &entryName) {
+
+        if (!this->m_archive) {
+            throw Exception("Archive series [" + this->m_pattern + "] not open.");
+        }
+
+        std::time_t now = std::time(nullptr);
+        std::error_code errorCode;
+        std::uint64_t fileSize = fs::file_size(fileName, errorCode);
+
+        if (errorCode) {
+            fileSize = 0;
+        }
+
+        if (archiveName(this->m_pattern, now, 0, this->m_shard) != this->m_period) {
+            this->close();
+            this->m_sequence = 1;
+            this->openArchive(now);
+        } else if (this->rolloverDue(fileSize)) {
+            this->close();
+            this->m_sequence++;
+            this->openArchive(now);
+        }
+
+        return (this->m_archive->add(fileName, entryName));
+
+    }
+
+    std::string ZIPRollover::currentArchive(void) const {
+
+        return (this->m_archiveName);
+
+    }
+
+    //
+    // Expand %n and %i then pass the rest of the pattern to strftime().
+    //
+
+    std::string ZIPRollover::archiveName(const std::string &pattern, std::time_t when, std::size_t sequence, std::size_t shard) {
+
+        std::string format;
+        struct tm localTime {};
+
+        for (std::size_t index = 0; index < pattern.length(); index++) {
+            if ((pattern[index] != '%') || (index + 1 == pattern.length())) {
+                format += pattern[index];
+            } else if (pattern[index + 1] == 'n') {
+                format += std::to_string(sequence);
+                index++;
+            } else if (pattern[index + 1] == 'i') {
+                format += (shard != kNoShard) ? std::to_string(shard) : "";
+                index++;
+            } else {
+                format += pattern.substr(index, 2);
+                index++;
+            }
+        }
+
+        localtime_r(&when, &localTime);
+
+        std::vector<char> name(format.length() + 256);
+        std::size_t nameLength = std::strftime(name.data(), name.size(), format.c_str(), &localTime);
+
+        return ((nameLength) ? std::string(name.data(), nameLength) : format);
+
+    }
+
+    //
+    // Open each shard's archive series and start its worker (deflate threads
+    // are shared out between the shards).
+    //
+
+    ZIPShards::ZIPShards(const std::string &pattern, const ZIPRollover::Limits &limits, std::size_t shards, std::size_t threads,
+                         std::size_t flushEntries, std::chrono::seconds idleFlush, ZIPArchive::Duplicates duplicates) {
+
+        shards = (shards) ? shards : 1;
+        threads = (threads > shards) ? threads / shards : 1;
+
+        this->m_maxQueued = shards * kQueuedPerShard;
+
+        for (std::size_t shardNo = 1; shardNo <= shards; shardNo++) {
+            std::unique_ptr<Shard> shard { new Shard() };
+            shard->archive.reset(new ZIPRollover(pattern, limits, shardNo));
+            shard->archive->setThreads(threads);
+            shard->archive->setFlushInterval(flushEntries, idleFlush);
+            shard->archive->setDuplicates(duplicates);
+            shard->archive->open();
+            this->m_shards.push_back(std::move(shard));
+        }
+
+        for (auto &shard : this->m_shards) {
+            shard->worker = std::thread(&ZIPShards::worker, this, std::ref(*shard));
+        }
+
+    }
+
+    ZIPShards::~ZIPShards() {
+
+        try {
+            this->close();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+
+    }
+
+    //
+    // Shard worker. Add files queued to the shard until stopped and empty.
+    //
+
+    void ZIPShards::worker(Shard &shard) {
+
+        std::unique_lock<std::mutex> locker(this->m_queueMutex);
+
+        while (true) {
+
+            this->m_queueWakeup.wait(locker, [this, &shard] {
+                return (this->m_stop || !shard.queue.empty());
+            });
+
+            if (shard.queue.empty()) {
+                break;
+            }
+
+            auto file = shard.queue.front();
+            bool failed = false;
+            shard.queue.pop_front();
+            shard.bBusy = true;
+
+            locker.unlock();
+            this->m_queueSpace.notify_one();
+
+            try {
+                std::string entryName { shard.archive->add(file.first, file.second) };
+                if (!entryName.empty()) {
+                    std::cout << ("Appended [" + entryName + "] to archive [" + shard.archive->currentArchive() + "]\n") << std::flush;
+                } else {
+                    std::cout << ("Skipped [" + file.second + "] already in archive [" + shard.archive->currentArchive() + "]\n") << std::flush;
+                }
+            } catch (const std::exception &e) {
+                std::cerr << ("Could not add [" + file.first + "]: " + e.what() + "\n") << std::flush;
+                failed = true;
+            }
+
+            locker.lock();
+            shard.bBusy = false;
+            if (failed) {
+                this->m_failed++;
+            }
+
+        }
+
+    }
+
+    //
+    // Queue file on the shard for its entry name (waiting if the queues are
+    // full).
+    //
+
+    void ZIPShards::add(const std::string &fileName, const std::string &entryName) {
+
+        std::unique_lock<std::mutex> locker(this->m_queueMutex);
+
+        this->m_queueSpace.wait(locker, [this] {
+            std::size_t queued = 0;
+            for (auto &shard : this->m_shards) {
+                queued += shard->queue.size();
+            }
+            return (queued < this->m_maxQueued);
+        });
+
+        Shard &shard = *this->m_shards[std::hash<std::string>{}(entryName) % this->m_shards.size()];
+
+        shard.queue.emplace_back(fileName, entryName);
+
+        locker.unlock();
+        this->m_queueWakeup.notify_all();
+
+    }
+
+    void ZIPShards::close(void) {
+
+        {
+            std::lock_guard<std::mutex> locker(this->m_queueMutex);
+            this->m_stop = true;
+        }
+
+        this->m_queueWakeup.notify_all();
+
+        for (auto &shard : this->m_shards) {
+            if (shard->worker.joinable()) {
+                shard->worker.join();
+            }
+        }
+
+        for (auto &shard : this->m_shards) {
+            shard->archive->close();
+        }
+
+    }
+
+    std::size_t ZIPShards::failed(void) {
+
+        std::lock_guard<std::mutex> locker(this->m_queueMutex);
+
+        return (this->m_failed);
+
+    }
+
+} // namespace FPE_TaskActions
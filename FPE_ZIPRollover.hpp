@@ -0,0 +1,178 @@
+#ifndef FPE_ZIPROLLOVER_HPP
+#define FPE_ZIPROLLOVER_HPP
+
+//
+// C++ STL
+//
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+//
+// Program components.
+//
+
+#include "FPE_ZIPArchive.hpp"
+
+// =========
+// NAMESPACE
+// =========
+
+namespace FPE_TaskActions {
+
+    //
+    // ZIPRollover class. Files are added to the current archive of a series
+    // named by a pattern: strftime() conversions plus %n (sequence number,
+    // from 1) and %i (shard number). A new archive is started when the
+    // current one reaches an entry or byte limit, has been open for a
+    // maximum time or the pattern's date/time part changes. Duplicates are
+    // only looked for in the current archive.
+    //
+
+    class ZIPRollover {
+    public:
+
+        //
+        // Class exception
+        //
+
+        struct Exception : public std::runtime_error {
+
+            Exception(std::string const& message)
+            : std::runtime_error("ZIPRollover Failure: " + message) {
+            }
+
+        };
+
+        //
+        // Archive limits (0 for none)
+        //
+
+        struct Limits {
+            std::size_t maxEntries { 0 }; // Entries per archive
+            std::uint64_t maxBytes { 0 }; // Bytes per archive
+            std::chrono::seconds maxAge { 0 }; // Time an archive is written to
+        };
+
+        static constexpr std::size_t kNoShard { static_cast<std::size_t> (-1) };
+
+        ZIPRollover(const std::string &pattern, const Limits &limits, std::size_t shard = kNoShard);
+
+        ~ZIPRollover();
+
+        // Flush interval, deflate threads and duplicate handling for each
+        // archive opened
+
+        void setFlushInterval(std::size_t flushEntries, std::chrono::seconds idleFlush);
+        void setThreads(std::size_t threads);
+        void setDuplicates(ZIPArchive::Duplicates duplicates);
+
+        // Open current archive of series and close it
+
+        void open(void);
+        void close(void);
+
+        // Add file to current archive (rolling over first if due). Returns
+        // name of entry added (empty if skipped as a duplicate).
+
+        std::string add(const std::string &fileName, const std::string &entryName);
+
+        // Name of current archive
+
+        std::string currentArchive(void) const;
+
+        // Archive name for pattern, time, sequence number and shard
+
+        static std::string archiveName(const std::string &pattern, std::time_t when, std::size_t sequence, std::size_t shard);
+
+    private:
+
+        ZIPRollover(const ZIPRollover&) = delete;
+        ZIPRollover& operator=(const ZIPRollover&) = delete;
+
+        void openArchive(std::time_t now);
+        bool rolloverDue(std::uint64_t fileSize);
+
+        std::string m_pattern; // Archive name pattern
+        Limits m_limits; // Rollover limits
+        std::size_t m_shard; // Shard number (kNoShard for none)
+
+        std::size_t m_flushEntries { 0 }; // Archive flush entries
+        std::chrono::seconds m_idleFlush { 0 }; // Archive idle flush time
+        std::size_t m_threads { 1 }; // Archive deflate threads
+        ZIPArchive::Duplicates m_duplicates { ZIPArchive::Duplicates::add }; // Archive duplicate handling
+
+        std::unique_ptr<ZIPArchive> m_archive; // Current archive
+        std::string m_archiveName; // Current archive name
+        std::string m_period; // Pattern expanded for time alone
+        std::size_t m_sequence { 1 }; // Current sequence number
+        std::chrono::steady_clock::time_point m_opened; // Time current archive opened
+
+    };
+
+    //
+    // ZIPShards class. Several rolling archive series (one per shard) each
+    // written by its own thread. Files are queued to a shard picked by a
+    // hash of their entry name so that a name always goes to the same
+    // shard (and duplicates of it are found there). Files that fail to be
+    // added are counted.
+    //
+
+    class ZIPShards {
+    public:
+
+        ZIPShards(const std::string &pattern, const ZIPRollover::Limits &limits, std::size_t shards, std::size_t threads,
+                  std::size_t flushEntries, std::chrono::seconds idleFlush,
+                  ZIPArchive::Duplicates duplicates = ZIPArchive::Duplicates::add);
+
+        ~ZIPShards();
+
+        // Queue file to be added to a shard
+
+        void add(const std::string &fileName, const std::string &entryName);
+
+        // Add all queued files then close archives
+
+        void close(void);
+
+        // Number of queued files that could not be added
+
+        std::size_t failed(void);
+
+    private:
+
+        struct Shard {
+            std::unique_ptr<ZIPRollover> archive; // Shard archive series
+            std::deque<std::pair<std::string, std::string>> queue; // Files (and entry names) waiting
+            bool bBusy { false }; // File being added
+            std::thread worker; // Shard worker thread
+        };
+
+        ZIPShards(const ZIPShards&) = delete;
+        ZIPShards& operator=(const ZIPShards&) = delete;
+
+        void worker(Shard &shard);
+
+        std::vector<std::unique_ptr<Shard>> m_shards; // Shards
+        std::size_t m_maxQueued; // Files waiting before add() blocks
+        std::size_t m_failed { 0 }; // Files that could not be added
+
+        bool m_stop { false }; // Stop workers once queues empty
+        std::mutex m_queueMutex; // Protects queues
+        std::condition_variable m_queueWakeup; // File queued or stopping
+        std::condition_variable m_queueSpace; // File taken from a queue
+
+    };
+
+} // namespace FPE_TaskActions
+#endif /* FPE_ZIPROLLOVER_HPP */
+
@@ -0,0 +1,211 @@
+#include "HOST.hpp"
+/*
+ * File:   CSVCheckpointTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE CSV import checkpoints.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_CSVCheckpoint.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL
+//
+
+#include <fstream>
+#include <filesystem>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class CSVCheckpointTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    CSVCheckpointTests() {
+    }
+
+    // Empty destructor
+
+    ~CSVCheckpointTests() override {
+    }
+
+    void SetUp() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    static std::vector<CSVCheckpoint::Range> createRanges(void);
+
+    static const std::string kTestDirectory; // Checkpoint directory
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string CSVCheckpointTests::kTestDirectory("/tmp/fpe_csvcheckpoint_test");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Two ranges of a file with nothing yet acknowledged.
+//
+
+std::vector<CSVCheckpoint::Range> CSVCheckpointTests::createRanges(void) {
+
+    std::vector<CSVCheckpoint::Range> ranges(2);
+
+    ranges[0].start = ranges[0].next = 10;
+    ranges[0].end = 1000;
+    ranges[1].start = ranges[1].next = 1000;
+    ranges[1].end = 2000;
+
+    return (ranges);
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Acknowledged progress is there when the checkpoint is next loaded.
+//
+
+TEST_F(CSVCheckpointTests, ResumeFromCheckpoint) {
+
+    std::vector<CSVCheckpoint::Range> ranges;
+
+    {
+        CSVCheckpoint checkpoint(kTestDirectory, "file");
+        EXPECT_FALSE(checkpoint.load(ranges));
+        checkpoint.start(createRanges());
+        checkpoint.acknowledge(0, 500, 50);
+        checkpoint.acknowledge(0, 600, 10);
+        checkpoint.acknowledge(1, 1500, 40);
+        EXPECT_THROW(checkpoint.acknowledge(2, 0, 0), CSVCheckpoint::Exception);
+    }
+
+    CSVCheckpoint checkpoint(kTestDirectory, "file");
+
+    ASSERT_TRUE(checkpoint.load(ranges));
+    ASSERT_EQ(2, ranges.size());
+    EXPECT_EQ(10, ranges[0].start);
+    EXPECT_EQ(600, ranges[0].next);
+    EXPECT_EQ(60, ranges[0].rows);
+    EXPECT_EQ(1500, ranges[1].next);
+    EXPECT_EQ(40, ranges[1].rows);
+
+    checkpoint.acknowledge(1, 2000, 60);
+
+    CSVCheckpoint otherFile(kTestDirectory, "other");
+    EXPECT_FALSE(otherFile.load(ranges));
+
+    checkpoint.complete();
+    EXPECT_FALSE(checkpoint.load(ranges));
+    EXPECT_TRUE(std::filesystem::is_empty(kTestDirectory));
+
+}
+
+//
+// A checkpoint file that is not valid is ignored.
+//
+
+TEST_F(CSVCheckpointTests, InvalidCheckpoint) {
+
+    std::vector<CSVCheckpoint::Range> ranges;
+    CSVCheckpoint checkpoint(kTestDirectory, "file");
+
+    std::ofstream(kTestDirectory + "/file.checkpoint") << "not a checkpoint\n";
+    EXPECT_FALSE(checkpoint.load(ranges));
+
+    std::ofstream(kTestDirectory + "/file.checkpoint") << "FPE CSV checkpoint 1\n10 1000 2000 5\n";
+    EXPECT_FALSE(checkpoint.load(ranges));
+    EXPECT_TRUE(ranges.empty());
+
+}
+
+//
+// File ID depends on contents and size not name.
+//
+
+TEST_F(CSVCheckpointTests, FileId) {
+
+    std::string csv(100000, 'x');
+
+    EXPECT_EQ(CSVCheckpoint::fileId(csv.data(), csv.size()), CSVCheckpoint::fileId(std::string(csv).data(), csv.size()));
+    EXPECT_NE(CSVCheckpoint::fileId(csv.data(), csv.size()), CSVCheckpoint::fileId(csv.data(), csv.size() - 1));
+
+    std::string changed { csv };
+    changed[10] = 'y';
+
+    EXPECT_NE(CSVCheckpoint::fileId(csv.data(), csv.size()), CSVCheckpoint::fileId(changed.data(), changed.size()));
+
+    changed = csv;
+    changed[csv.size() - 1] = 'y';
+
+    EXPECT_NE(CSVCheckpoint::fileId(csv.data(), csv.size()), CSVCheckpoint::fileId(changed.data(), changed.size()));
+
+}
+
+//
+// File ID is the same however many threads hash it, and covers every
+// segment of a file larger than one segment.
+//
+
+TEST_F(CSVCheckpointTests, FileIdThreaded) {
+
+    std::string csv(130 * 1024 * 1024, 'x');
+    std::string fileId { CSVCheckpoint::fileId(csv.data(), csv.size()) };
+
+    EXPECT_EQ(fileId, CSVCheckpoint::fileId(csv.data(), csv.size(), 2));
+    EXPECT_EQ(fileId, CSVCheckpoint::fileId(csv.data(), csv.size(), 8));
+
+    csv[70 * 1024 * 1024] = 'y';
+
+    EXPECT_NE(fileId, CSVCheckpoint::fileId(csv.data(), csv.size(), 4));
+
+    csv[70 * 1024 * 1024] = 'x';
+    csv[csv.size() - 1] = 'y';
+
+    EXPECT_NE(fileId, CSVCheckpoint::fileId(csv.data(), csv.size(), 4));
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
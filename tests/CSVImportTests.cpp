@@ -0,0 +1,615 @@
+#include "HOST.hpp"
+/*
+ * File:   CSVImportTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE CSV import into an SQLite sink.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_CSVImport.hpp"
+#include "FPE_SQLiteSink.hpp"
+#include "FPE_GZipStream.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL / SQLite
+//
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+#include <sqlite3.h>
+#include <zlib.h>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class CSVImportTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    CSVImportTests() {
+    }
+
+    // Empty destructor
+
+    ~CSVImportTests() override {
+    }
+
+    void SetUp() override {
+        std::filesystem::remove_all(kTestDirectory);
+        std::filesystem::create_directories(kTestDirectory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    static std::string createCSV(std::size_t rows, std::vector<std::size_t> &rowOffsets);
+    static std::string query(const std::string &sql);
+    static void gzipFile(const std::string &data, const std::string &fileName);
+
+    static const std::string kTestDirectory; // Test files
+    static const std::string kCSVFile; // CSV file imported
+    static const std::string kDatabaseFile; // SQLite database
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string CSVImportTests::kTestDirectory("/tmp/fpe_csvimport_test");
+const std::string CSVImportTests::kCSVFile(kTestDirectory + "/test.csv");
+const std::string CSVImportTests::kDatabaseFile(kTestDirectory + "/test.db");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// CSV of a number of rows written to kCSVFile (returning contents and
+// the offset of each row).
+//
+
+std::string CSVImportTests::createCSV(std::size_t rows, std::vector<std::size_t> &rowOffsets) {
+
+    std::ostringstream csv;
+
+    csv << "id,name,amount,when,comment\n";
+
+    for (std::size_t row = 0; row < rows; row++) {
+        rowOffsets.push_back(csv.tellp());
+        csv << row << ",\"name, " << (row * 7919) % 1000 << "\"," << (row * 31) % 1000 << ".5,"
+                << "2020-01-" << 10 + row % 20 << "," << ((row % 4) ? "comment" : "") << "\n";
+    }
+
+    std::ofstream(kCSVFile) << csv.str();
+
+    return (csv.str());
+
+}
+
+//
+// First column of first row of query on test database.
+//
+
+std::string CSVImportTests::query(const std::string &sql) {
+
+    sqlite3 *connection = nullptr;
+    sqlite3_stmt *statement = nullptr;
+    std::string result;
+
+    sqlite3_open(kDatabaseFile.c_str(), &connection);
+
+    if (sqlite3_prepare_v2(connection, sql.c_str(), -1, &statement, nullptr) == SQLITE_OK) {
+        if ((sqlite3_step(statement) == SQLITE_ROW) && sqlite3_column_text(statement, 0)) {
+            result = reinterpret_cast<const char *> (sqlite3_column_text(statement, 0));
+        }
+    } else {
+        result = sqlite3_errmsg(connection);
+    }
+
+    sqlite3_finalize(statement);
+    sqlite3_close(connection);
+
+    return (result);
+
+}
+
+//
+// Write data to a gzip compressed file.
+//
+
+void CSVImportTests::gzipFile(const std::string &data, const std::string &fileName) {
+
+    gzFile gzipFile = gzopen(fileName.c_str(), "wb");
+
+    gzwrite(gzipFile, data.data(), static_cast<unsigned> (data.size()));
+    gzclose(gzipFile);
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Rows imported in batches with column types inferred.
+//
+
+TEST_F(CSVImportTests, ImportRows) {
+
+    std::vector<std::size_t> rowOffsets;
+    createCSV(1000, rowOffsets);
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.insertBatch = 64;
+    settings.schema = "infer";
+
+    EXPECT_EQ(1000, CSVImport(sink, settings).importFile(kCSVFile));
+
+    EXPECT_EQ("1000", query("SELECT COUNT(*) FROM imported"));
+    EXPECT_EQ("wal", query("PRAGMA journal_mode"));
+    EXPECT_EQ("integer real integer", query("SELECT typeof(id) || ' ' || typeof(amount) || ' ' || typeof(\"when\") "
+            "FROM imported WHERE id = 7"));
+    EXPECT_EQ("name, 433", query("SELECT name FROM imported WHERE id = 7"));
+    EXPECT_EQ("250", query("SELECT COUNT(*) FROM imported WHERE comment IS NULL"));
+    EXPECT_EQ("0", query("SELECT COUNT(_id) FROM imported"));
+
+    std::ofstream(kCSVFile, std::ios::trunc);
+    EXPECT_EQ(0, CSVImport(sink, settings).importFile(kCSVFile));
+
+    EXPECT_THROW(CSVImport(sink, settings).importFile(kTestDirectory + "/missing.csv"), std::exception);
+    CSVSink::Table table;
+    table.fieldNames = {"a"};
+    EXPECT_THROW(SQLiteSink(kTestDirectory + "/missing/test.db", "imported").writer(table), SQLiteSink::Exception);
+
+}
+
+//
+// File split into ranges imported by several threads.
+//
+
+TEST_F(CSVImportTests, ParallelRanges) {
+
+    std::vector<std::size_t> rowOffsets;
+    std::string csv { createCSV(5000, rowOffsets) };
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.threads = 4;
+    settings.minRangeSize = csv.size() / 8;
+    settings.insertBatch = 100;
+
+    EXPECT_EQ(5000, CSVImport(sink, settings).importFile(kCSVFile));
+
+    EXPECT_EQ("5000", query("SELECT COUNT(DISTINCT id) FROM imported"));
+    EXPECT_EQ("12497500", query("SELECT SUM(id) FROM imported"));
+
+}
+
+//
+// Import resumed from a checkpoint replays rows after it which are
+// ignored as their ids are already present.
+//
+
+TEST_F(CSVImportTests, ResumeFromCheckpoint) {
+
+    std::vector<std::size_t> rowOffsets;
+    std::string csv { createCSV(1000, rowOffsets) };
+    std::string fileId { CSVCheckpoint::fileId(csv.data(), csv.size()) };
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.insertBatch = 50;
+    settings.checkpointDirectory = kTestDirectory + "/checkpoint";
+
+    EXPECT_EQ(1000, CSVImport(sink, settings).importFile(kCSVFile));
+    EXPECT_EQ(fileId + ":" + std::to_string(rowOffsets[7]), query("SELECT _id FROM imported WHERE id = 7"));
+
+    CSVCheckpoint checkpoint(settings.checkpointDirectory, fileId);
+    CSVCheckpoint::Range range;
+
+    range.start = range.next = rowOffsets[0];
+    range.end = csv.size();
+
+    checkpoint.start({range});
+    checkpoint.acknowledge(0, rowOffsets[400], 400);
+
+    EXPECT_EQ(600, CSVImport(sink, settings).importFile(kCSVFile));
+    EXPECT_EQ("1000", query("SELECT COUNT(*) FROM imported"));
+    EXPECT_TRUE(std::filesystem::is_empty(settings.checkpointDirectory));
+
+}
+
+//
+// Keys (short and long) found exactly and keys of different fields kept apart.
+//
+
+TEST_F(CSVImportTests, KeyFilter) {
+
+    CSVKeyFilter keys;
+    CSVKeyFilter moreKeys;
+    std::string key;
+
+    for (std::size_t row = 0; row < 10000; row++) {
+        CSVKeyFilter::rowKey({std::to_string(row), "x"}, {0, 1}, key);
+        EXPECT_TRUE(keys.insert(key));
+    }
+
+    for (std::size_t row = 0; row < 20000; row++) {
+        CSVKeyFilter::rowKey({std::to_string(row), "x"}, {0, 1}, key);
+        EXPECT_EQ(row < 10000, keys.contains(key));
+        if (row >= 10000) {
+            EXPECT_TRUE(moreKeys.insert(key));
+        }
+    }
+
+    CSVKeyFilter::rowKey({"1x", ""}, {0, 1}, key);
+    EXPECT_FALSE(keys.contains(key));
+    CSVKeyFilter::rowKey({"1"}, {0, 1}, key);
+    EXPECT_FALSE(keys.contains(key));
+
+    std::string longKey(100000, 'k');
+    EXPECT_TRUE(keys.insert(longKey));
+    EXPECT_FALSE(keys.insert(longKey));
+    longKey.back() = 'x';
+    EXPECT_FALSE(keys.contains(longKey));
+
+    keys.merge(moreKeys);
+    EXPECT_EQ(20001, keys.size());
+
+}
+
+//
+// Row filter predicates compare numerically against numbers and as text
+// otherwise and all must be met.
+//
+
+TEST_F(CSVImportTests, RowFilter) {
+
+    std::vector<std::string> fieldNames { "id", "name", "amount" };
+
+    CSVRowFilter numeric(fieldNames, "amount>=10,amount<20.5");
+
+    EXPECT_TRUE(numeric.matches({"1", "a", "10"}));
+    EXPECT_TRUE(numeric.matches({"1", "a", "2e1"}));
+    EXPECT_FALSE(numeric.matches({"1", "a", "9.99"}));
+    EXPECT_FALSE(numeric.matches({"1", "a", "20.5"}));
+    EXPECT_FALSE(numeric.matches({"1", "a", "x"}));
+    EXPECT_FALSE(numeric.matches({"1", "a"}));
+
+    CSVRowFilter text(fieldNames, "name!=bob,name>a,id!=3");
+
+    EXPECT_TRUE(text.matches({"1", "alice"}));
+    EXPECT_TRUE(text.matches({"x", "carol"}));
+    EXPECT_FALSE(text.matches({"1", "bob"}));
+    EXPECT_FALSE(text.matches({"1", "a"}));
+    EXPECT_FALSE(text.matches({"3", "alice"}));
+    EXPECT_EQ(std::vector<std::size_t>({1, 1, 0}), text.columns());
+
+    text.select({0, 1});
+    EXPECT_TRUE(text.matches({"1", "alice"}));
+    numeric.select({2});
+    EXPECT_TRUE(numeric.matches({"15"}));
+
+    EXPECT_THROW(CSVRowFilter(fieldNames, "missing=1"), CSVRowFilter::Exception);
+    EXPECT_THROW(CSVRowFilter(fieldNames, "name"), CSVRowFilter::Exception);
+    EXPECT_THROW(CSVRowFilter(fieldNames, "=1"), CSVRowFilter::Exception);
+    EXPECT_THROW(CSVRowFilter(fieldNames, "name!1"), CSVRowFilter::Exception);
+
+}
+
+//
+// Rows whose key was in an earlier file (or earlier in the same one) are
+// dropped.
+//
+
+TEST_F(CSVImportTests, DedupFilter) {
+
+    std::vector<std::size_t> rowOffsets;
+    createCSV(1000, rowOffsets);
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.keyColumns = {"id"};
+    settings.insertBatch = 64;
+
+    CSVImport csvImport(sink, settings);
+
+    EXPECT_EQ(1000, csvImport.importFile(kCSVFile));
+
+    rowOffsets.clear();
+    createCSV(1500, rowOffsets);
+    std::ofstream(kCSVFile, std::ios::app) << "1499,again,,,\n1500,new,,,\n";
+
+    EXPECT_EQ(501, csvImport.importFile(kCSVFile));
+    EXPECT_EQ("1501", query("SELECT COUNT(*) FROM imported"));
+    EXPECT_EQ("1501", query("SELECT COUNT(DISTINCT id) FROM imported"));
+
+    settings.keyColumns = {"missing"};
+    EXPECT_THROW(CSVImport(sink, settings).importFile(kCSVFile), CSVImport::Exception);
+
+}
+
+//
+// An import resumed from a checkpoint still drops rows repeating the keys
+// of rows acknowledged before it was interrupted (mapped and compressed).
+//
+
+TEST_F(CSVImportTests, DedupFilterResumed) {
+
+    std::ostringstream csv;
+    std::size_t acknowledged = 0;
+
+    csv << "id,name\n";
+
+    for (std::size_t row = 0; row < 600; row++) {
+        if (row == 400) {
+            acknowledged = csv.tellp();
+        }
+        csv << ((row < 400) ? row : (row % 2) ? row : row - 400) << ",name\n";
+    }
+
+    std::string compressedFile { kCSVFile + ".gz" };
+
+    std::ofstream(kCSVFile, std::ios::trunc) << csv.str();
+    gzipFile(csv.str(), compressedFile);
+
+    for (auto &fileName : { kCSVFile, compressedFile }) {
+
+        std::ifstream fileStream(fileName, std::ios::binary);
+        std::string data { std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>() };
+
+        SQLiteSink sink(kDatabaseFile, fileName == kCSVFile ? "mapped" : "compressed");
+        CSVImport::Settings settings;
+
+        settings.keyColumns = {"id"};
+        settings.checkpointDirectory = kTestDirectory + "/checkpoint";
+
+        CSVCheckpoint checkpoint(settings.checkpointDirectory, CSVCheckpoint::fileId(data.data(), data.size()));
+        CSVCheckpoint::Range range;
+
+        range.start = range.next = std::string("id,name\n").size();
+        range.end = (fileName == kCSVFile) ? csv.str().size() : std::numeric_limits<std::uint64_t>::max();
+
+        checkpoint.start({range});
+        checkpoint.acknowledge(0, acknowledged, 400);
+
+        EXPECT_EQ(100, CSVImport(sink, settings).importFile(fileName));
+
+    }
+
+}
+
+//
+// Rows upserted on their key columns replace existing rows.
+//
+
+TEST_F(CSVImportTests, DedupUpsert) {
+
+    std::vector<std::size_t> rowOffsets;
+    createCSV(1000, rowOffsets);
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.keyColumns = {"id"};
+    settings.dedup = CSVImport::Dedup::upsert;
+    settings.checkpointDirectory = kTestDirectory + "/checkpoint";
+
+    EXPECT_EQ(1000, CSVImport(sink, settings).importFile(kCSVFile));
+
+    std::ofstream(kCSVFile, std::ios::trunc) << "id,name,amount,when,comment\n7,changed,1,,\n2000,new,2,,\n";
+
+    EXPECT_EQ(2, CSVImport(sink, settings).importFile(kCSVFile));
+    EXPECT_EQ("1001", query("SELECT COUNT(*) FROM imported"));
+    EXPECT_EQ("changed", query("SELECT name FROM imported WHERE id = '7'"));
+    EXPECT_EQ("0", query("SELECT COUNT(_id) FROM imported"));
+
+}
+
+//
+// Only the columns given are imported (in the order given) and only rows
+// meeting the filter, with keys and types on the columns imported.
+//
+
+TEST_F(CSVImportTests, ColumnsAndFilter) {
+
+    std::vector<std::size_t> rowOffsets;
+    createCSV(1000, rowOffsets);
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+    std::size_t expected = 0;
+
+    for (std::size_t row = 0; row < 1000; row++) {
+        expected += ((row % 20 == 1) && ((row * 31) % 1000 < 500) && (row % 4));
+    }
+
+    settings.columns = {"amount", "id"};
+    settings.filter = "when=2020-01-11,amount<500,comment!=";
+    settings.schema = "infer";
+    settings.keyColumns = {"id"};
+    settings.minRangeSize = 1024;
+    settings.threads = 4;
+
+    EXPECT_EQ(expected, CSVImport(sink, settings).importFile(kCSVFile));
+    EXPECT_EQ("_id,amount,id", query("SELECT group_concat(name) FROM pragma_table_info('imported')"));
+    EXPECT_EQ(std::to_string(expected), query("SELECT COUNT(*) FROM imported WHERE id % 20 = 1 AND amount < 500"));
+    EXPECT_EQ("real integer", query("SELECT typeof(amount) || ' ' || typeof(id) FROM imported LIMIT 1"));
+    EXPECT_EQ("271.5", query("SELECT amount FROM imported WHERE id = 41"));
+
+    settings.columns = {"id", "missing"};
+    EXPECT_THROW(CSVImport(sink, settings).importFile(kCSVFile), CSVImport::Exception);
+    settings.columns = {"id"};
+    settings.keyColumns = {"name"};
+    EXPECT_THROW(CSVImport(sink, settings).importFile(kCSVFile), CSVImport::Exception);
+
+}
+
+//
+// Decompressed blocks (with data kept from the last in front, even when
+// it does not fit in front of a buffer) match the original data.
+//
+
+TEST_F(CSVImportTests, GZipStream) {
+
+    std::string data;
+    std::string compressedFile { kTestDirectory + "/stream.gz" };
+
+    for (std::size_t line = 0; line < 100000; line++) {
+        data += std::to_string(line * 7919) + " line\n";
+    }
+
+    gzipFile(data, compressedFile);
+
+    std::string head { GZipStream::head(compressedFile, 100) };
+    EXPECT_EQ(data.substr(0, 100), head);
+    EXPECT_EQ(data, GZipStream::head(compressedFile, data.size() + 1));
+    EXPECT_TRUE(GZipStream::isGZip("\x1f\x8b", 2));
+    EXPECT_FALSE(GZipStream::isGZip("id", 2));
+
+    for (bool bKeepAll : {false, true}) {
+        GZipStream stream(compressedFile, (bKeepAll) ? 200000 : 1000, 3);
+        GZipStream::Block block;
+        std::size_t keep = 0;
+        std::size_t blocks = 0;
+        while (stream.read(block, keep)) {
+            ASSERT_EQ(data.substr(block.offset, block.length), std::string(block.data, block.length));
+            keep = (bKeepAll) ? block.length : block.length % 300;
+            blocks++;
+        }
+        EXPECT_EQ(data.size(), block.offset + block.length);
+        EXPECT_TRUE(block.bLast);
+        if (bKeepAll) {
+            EXPECT_EQ(0, block.offset);
+        }
+        EXPECT_LT(2, blocks);
+    }
+
+    std::ifstream compressedStream(compressedFile, std::ios::binary);
+    std::string compressed { std::istreambuf_iterator<char>(compressedStream), std::istreambuf_iterator<char>() };
+    std::ofstream(compressedFile, std::ios::trunc | std::ios::binary) << compressed.substr(0, compressed.size() / 2);
+
+    EXPECT_THROW({
+        GZipStream stream(compressedFile, 1000, 3);
+        GZipStream::Block block;
+        while (stream.read(block)) {
+        }
+    }, GZipStream::Exception);
+
+    EXPECT_THROW(GZipStream::head(kTestDirectory + "/missing.gz", 100), GZipStream::Exception);
+
+}
+
+//
+// A gzip compressed file is streamed through the parser (rows across
+// blocks) with row offsets those in the decompressed data so that an
+// interrupted import resumes; zstd is rejected.
+//
+
+TEST_F(CSVImportTests, ImportGZip) {
+
+    std::vector<std::size_t> rowOffsets;
+    std::string csv { createCSV(200000, rowOffsets) };
+    std::string compressedFile { kCSVFile + ".gz" };
+
+    gzipFile(csv, compressedFile);
+
+    std::ifstream compressedStream(compressedFile, std::ios::binary);
+    std::string compressed { std::istreambuf_iterator<char>(compressedStream), std::istreambuf_iterator<char>() };
+    std::string fileId { CSVCheckpoint::fileId(compressed.data(), compressed.size()) };
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.schema = "infer";
+    settings.checkpointDirectory = kTestDirectory + "/checkpoint";
+
+    EXPECT_EQ(200000, CSVImport(sink, settings).importFile(compressedFile));
+    EXPECT_EQ("200000", query("SELECT COUNT(DISTINCT id) FROM imported"));
+    EXPECT_EQ("19999900000", query("SELECT SUM(id) FROM imported"));
+    EXPECT_EQ("name, 433", query("SELECT name FROM imported WHERE id = 7"));
+    EXPECT_EQ(fileId + ":" + std::to_string(rowOffsets[150000]), query("SELECT _id FROM imported WHERE id = 150000"));
+
+    CSVCheckpoint checkpoint(settings.checkpointDirectory, fileId);
+    CSVCheckpoint::Range range;
+
+    range.start = range.next = rowOffsets[0];
+    range.end = std::numeric_limits<std::uint64_t>::max();
+
+    checkpoint.start({range});
+    checkpoint.acknowledge(0, rowOffsets[120000], 120000);
+
+    EXPECT_EQ(80000, CSVImport(sink, settings).importFile(compressedFile));
+    EXPECT_EQ("200000", query("SELECT COUNT(*) FROM imported"));
+    EXPECT_TRUE(std::filesystem::is_empty(settings.checkpointDirectory));
+
+    std::ofstream(kCSVFile, std::ios::trunc | std::ios::binary) << std::string("\x28\xb5\x2f\xfd", 4) << "data";
+    EXPECT_THROW(CSVImport(sink, settings).importFile(kCSVFile), CSVImport::Exception);
+
+}
+
+//
+// Rows per second imported into SQLite. Disabled so that it is only run
+// when asked for (with the option --gtest_also_run_disabled_tests).
+//
+
+TEST_F(CSVImportTests, DISABLED_Benchmark) {
+
+    std::vector<std::size_t> rowOffsets;
+    createCSV(200000, rowOffsets);
+
+    SQLiteSink sink(kDatabaseFile, "imported");
+    CSVImport::Settings settings;
+
+    settings.schema = "infer";
+
+    auto start = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(200000, CSVImport(sink, settings).importFile(kCSVFile));
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "SQLite import : " << 200000 / std::max(seconds, 1e-9) << " rows/s" << std::endl;
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
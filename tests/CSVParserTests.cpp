@@ -0,0 +1,432 @@
+#include "HOST.hpp"
+/*
+ * File:   CSVParserTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE CSV parser.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_CSVParser.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL / Boost
+//
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+#include <boost/tokenizer.hpp>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class CSVParserTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    CSVParserTests() {
+    }
+
+    // Empty destructor
+
+    ~CSVParserTests() override {
+    }
+
+    void SetUp() override {
+        std::filesystem::create_directories(kTestDirectory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    static std::vector<std::vector<std::string>> parseAll(const std::string &csv);
+    static std::string createCSV(std::size_t rows);
+
+    static const std::string kTestDirectory; // Test files
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string CSVParserTests::kTestDirectory("/tmp/fpe_csvparser_test");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Parse whole CSV string returning copies of its rows.
+//
+
+std::vector<std::vector<std::string>> CSVParserTests::parseAll(const std::string &csv) {
+
+    CSVParser parser;
+    std::vector<std::vector<std::string>> rows;
+
+    parser.parse(csv.data(), csv.size(), true, [&rows] (const CSVParser::Fields &fields, std::size_t) {
+        rows.emplace_back(fields.begin(), fields.end());
+    });
+
+    return (rows);
+
+}
+
+//
+// CSV of a number of rows with fields of varying length (some quoted).
+//
+
+std::string CSVParserTests::createCSV(std::size_t rows) {
+
+    std::ostringstream csv;
+
+    csv << "id,name,city,amount,comment\n";
+
+    for (std::size_t row = 0; row < rows; row++) {
+        csv << row << ",name" << (row * 7919) % 1000 << ",City " << row % 37 << ","
+                << (row * 31) % 100000 << "." << row % 100 << ",";
+        if (row % 3 == 0) {
+            csv << "\"quoted, comment " << row << "\"";
+        } else {
+            csv << "comment " << std::string(row % 40, 'x');
+        }
+        csv << "\n";
+    }
+
+    return (csv.str());
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Plain rows with and without a final newline.
+//
+
+TEST_F(CSVParserTests, SimpleRows) {
+
+    auto rows = parseAll("a,b,c\n1,2,3\n4,,6");
+
+    ASSERT_EQ(3, rows.size());
+    EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), rows[0]);
+    EXPECT_EQ(std::vector<std::string>({"1", "2", "3"}), rows[1]);
+    EXPECT_EQ(std::vector<std::string>({"4", "", "6"}), rows[2]);
+
+}
+
+//
+// Quoted fields containing delimiters, escaped quotes and newlines.
+//
+
+TEST_F(CSVParserTests, QuotedFields) {
+
+    auto rows = parseAll("\"a,b\",\"say \"\"hi\"\"\",\"line 1\nline 2\",\"\"\nx,\"\"\"\",y\n");
+
+    ASSERT_EQ(2, rows.size());
+    EXPECT_EQ(std::vector<std::string>({"a,b", "say \"hi\"", "line 1\nline 2", ""}), rows[0]);
+    EXPECT_EQ(std::vector<std::string>({"x", "\"", "y"}), rows[1]);
+
+}
+
+//
+// \r\n line endings (a \r inside quotes is kept) and blank lines.
+//
+
+TEST_F(CSVParserTests, LineEndings) {
+
+    auto rows = parseAll("a,b\r\n\r\n\"c\r\",d\r\n\ne,\"f\"\r\n");
+
+    ASSERT_EQ(3, rows.size());
+    EXPECT_EQ(std::vector<std::string>({"a", "b"}), rows[0]);
+    EXPECT_EQ(std::vector<std::string>({"c\r", "d"}), rows[1]);
+    EXPECT_EQ(std::vector<std::string>({"e", "f"}), rows[2]);
+
+}
+
+//
+// Incomplete last row is left for the next call.
+//
+
+TEST_F(CSVParserTests, IncompleteRow) {
+
+    CSVParser parser;
+    std::string csv { "a,b\n\"c\nd\",e\n" };
+    std::vector<std::size_t> offsets;
+
+    auto rowFn = [&offsets] (const CSVParser::Fields &, std::size_t offset) {
+        offsets.push_back(offset);
+    };
+
+    EXPECT_EQ(4, parser.parse(csv.data(), 7, false, rowFn));
+    ASSERT_EQ(1, offsets.size());
+    EXPECT_EQ(csv.size(), parser.parse(csv.data(), csv.size(), false, rowFn));
+    ASSERT_EQ(3, offsets.size());
+    EXPECT_EQ(4, offsets[2]);
+
+}
+
+//
+// Fields and quotes falling across 64 byte blocks.
+//
+
+TEST_F(CSVParserTests, BlockBoundaries) {
+
+    std::string csv;
+    std::vector<std::vector<std::string>> expected;
+
+    for (std::size_t row = 0; row < 200; row++) {
+        std::vector<std::string> fields;
+        for (std::size_t field = 0; field < (row % 5) + 1; field++) {
+            std::string value((row * 13 + field * 7) % 70, static_cast<char> ('a' + field));
+            fields.push_back(value);
+            csv += (field) ? "," : "";
+            if ((row + field) % 4 == 0) {
+                csv += "\"" + value + ",\"\"\n\"";
+                fields.back() += ",\"\n";
+            } else {
+                csv += value;
+            }
+        }
+        csv += (row % 2) ? "\r\n" : "\n";
+        if ((fields.size() > 1) || !fields[0].empty()) {
+            expected.push_back(fields);
+        }
+    }
+
+    EXPECT_EQ(expected, parseAll(csv));
+
+}
+
+//
+// Row starts at or after offsets (newlines in quotes not being row ends)
+// match those found a byte at a time.
+//
+
+TEST_F(CSVParserTests, RowStarts) {
+
+    std::string csv;
+
+    for (std::size_t row = 0; row < 300; row++) {
+        csv += std::to_string(row) + "," + std::string(row % 90, 'x') + ",";
+        csv += (row % 3) ? "plain" : "\"quoted\nnewline, \"\"\n\"";
+        csv += "\n";
+    }
+
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> expected;
+    bool bInQuotes = false;
+
+    for (std::size_t offset = 0; offset <= csv.size() + 1; offset += 7) {
+        offsets.push_back(offset);
+    }
+
+    for (auto offset : offsets) {
+        std::size_t start = csv.size();
+        bInQuotes = false;
+        for (std::size_t index = 0; index < csv.size(); index++) {
+            if (((index == 0) || ((csv[index - 1] == '\n') && !bInQuotes)) && (index >= offset)) {
+                start = index;
+                break;
+            }
+            bInQuotes = (csv[index] == '"') ? !bInQuotes : bInQuotes;
+        }
+        expected.push_back(start);
+    }
+
+    CSVParser parser;
+
+    EXPECT_EQ(expected, parser.rowStarts(csv.data(), csv.size(), offsets));
+
+}
+
+//
+// Only selected columns passed on (quoted fields of others skipped, a
+// missing selected column being absent) and matching a full parse.
+//
+
+TEST_F(CSVParserTests, SelectColumns) {
+
+    CSVParser parser;
+    std::vector<std::vector<std::string>> rows;
+
+    auto rowFn = [&rows] (const CSVParser::Fields &fields, std::size_t) {
+        rows.emplace_back(fields.begin(), fields.end());
+    };
+
+    std::string csv { "a,\"b,\"\"x\"\"\nb\",c\r\n\r\n\"d\",e,\"f\"\"\"\r\ng,\"h\"\ni\n" };
+
+    parser.select({0, 2});
+    parser.parse(csv.data(), csv.size(), true, rowFn);
+
+    ASSERT_EQ(4, rows.size());
+    EXPECT_EQ(std::vector<std::string>({"a", "c"}), rows[0]);
+    EXPECT_EQ(std::vector<std::string>({"d", "f\""}), rows[1]);
+    EXPECT_EQ(std::vector<std::string>({"g"}), rows[2]);
+    EXPECT_EQ(std::vector<std::string>({"i"}), rows[3]);
+
+    rows.clear();
+    parser.select({1});
+    parser.parse(csv.data(), csv.size(), true, rowFn);
+
+    ASSERT_EQ(4, rows.size());
+    EXPECT_EQ(std::vector<std::string>({"b,\"x\"\nb"}), rows[0]);
+    EXPECT_EQ(std::vector<std::string>({"h"}), rows[2]);
+    EXPECT_TRUE(rows[3].empty());
+
+    csv = createCSV(2000);
+    auto allRows = parseAll(csv);
+
+    rows.clear();
+    parser.select({1, 4});
+    parser.parse(csv.data(), csv.size(), true, rowFn);
+
+    ASSERT_EQ(allRows.size(), rows.size());
+    for (std::size_t row = 0; row < rows.size(); row++) {
+        EXPECT_EQ(std::vector<std::string>({allRows[row][1], allRows[row][4]}), rows[row]);
+    }
+
+    rows.clear();
+    parser.select({});
+    parser.parse(csv.data(), csv.size(), true, rowFn);
+
+    EXPECT_EQ(allRows, rows);
+
+}
+
+//
+// Whole file parsed through a memory mapping.
+//
+
+TEST_F(CSVParserTests, ParseFile) {
+
+    std::string file { kTestDirectory + "/test.csv" };
+    std::string csv { createCSV(1000) };
+    std::size_t rows = 0;
+
+    std::ofstream(file) << csv;
+
+    CSVParser parser;
+
+    parser.parseFile(file, [&rows] (const CSVParser::Fields &fields, std::size_t) {
+        EXPECT_EQ(5, fields.size());
+        rows++;
+    });
+
+    EXPECT_EQ(1001, rows);
+
+    std::ofstream(file, std::ios::trunc);
+    parser.parseFile(file, [] (const CSVParser::Fields &, std::size_t) {
+        FAIL();
+    });
+
+    EXPECT_THROW(parser.parseFile(kTestDirectory + "/missing.csv", [] (const CSVParser::Fields &, std::size_t) {
+    }), CSVParser::Exception);
+
+}
+
+//
+// Compare with getline()/boost tokenizer (as used by the import task
+// before) checking both give the same fields and reporting the speed of
+// each. Disabled so that it is only run when asked for (with the option
+// --gtest_also_run_disabled_tests).
+//
+
+TEST_F(CSVParserTests, DISABLED_Benchmark) {
+
+    std::string csv { createCSV(200000) };
+    std::size_t tokenizerFields = 0;
+    std::size_t parserFields = 0;
+    std::size_t tokenizerBytes = 0;
+    std::size_t parserBytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::istringstream csvStream(csv);
+    std::string csvLine;
+
+    while (getline(csvStream, csvLine)) {
+        boost::tokenizer< boost::escaped_list_separator<char> > csvTokenizer(csvLine);
+        std::vector<std::string> csvTokens;
+        csvTokens.assign(csvTokenizer.begin(), csvTokenizer.end());
+        for (auto &token : csvTokens) {
+            tokenizerBytes += token.size();
+        }
+        tokenizerFields += csvTokens.size();
+    }
+
+    auto tokenizerTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+
+    CSVParser parser;
+
+    parser.parse(csv.data(), csv.size(), true, [&] (const CSVParser::Fields &fields, std::size_t) {
+        for (auto &field : fields) {
+            parserBytes += field.size();
+        }
+        parserFields += fields.size();
+    });
+
+    auto parserTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+
+    std::size_t selectedFields = 0;
+
+    parser.select({0});
+    parser.parse(csv.data(), csv.size(), true, [&] (const CSVParser::Fields &fields, std::size_t) {
+        selectedFields += fields.size();
+    });
+
+    auto selectTime = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(parserFields / 5, selectedFields);
+    EXPECT_EQ(tokenizerFields, parserFields);
+    EXPECT_EQ(tokenizerBytes, parserBytes);
+
+    auto megabytesPerSecond = [&csv] (std::chrono::steady_clock::duration time) {
+        return (csv.size() / std::max(std::chrono::duration<double>(time).count(), 1e-9) / (1024 * 1024));
+    };
+
+    std::cout << "getline()/tokenizer : " << megabytesPerSecond(tokenizerTime) << " MB/s" << std::endl;
+    std::cout << "CSVParser           : " << megabytesPerSecond(parserTime) << " MB/s" << std::endl;
+    std::cout << "CSVParser (1 column): " << megabytesPerSecond(selectTime) << " MB/s" << std::endl;
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
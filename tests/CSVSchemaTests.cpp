@@ -0,0 +1,207 @@
+#include "HOST.hpp"
+/*
+ * File:   CSVSchemaTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE CSV column types and BSON encoding.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_CSVSchema.hpp"
+#include "FPE_BSONEncoder.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL
+//
+
+#include <cstring>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class CSVSchemaTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    CSVSchemaTests() {
+    }
+
+    // Empty destructor
+
+    ~CSVSchemaTests() override {
+    }
+
+    void SetUp() override {
+    }
+
+    void TearDown() override {
+    }
+
+};
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Field conversions.
+//
+
+TEST_F(CSVSchemaTests, Conversions) {
+
+    std::int64_t integer;
+    double real;
+
+    EXPECT_TRUE(CSVSchema::toInt64("-42", integer));
+    EXPECT_EQ(-42, integer);
+    EXPECT_FALSE(CSVSchema::toInt64("007", integer));
+    EXPECT_FALSE(CSVSchema::toInt64("4.2", integer));
+    EXPECT_FALSE(CSVSchema::toInt64("99999999999999999999", integer));
+
+    EXPECT_TRUE(CSVSchema::toDouble("4.25e2", real));
+    EXPECT_EQ(425.0, real);
+    EXPECT_TRUE(CSVSchema::toDouble("0.5", real));
+    EXPECT_FALSE(CSVSchema::toDouble("nan", real));
+    EXPECT_FALSE(CSVSchema::toDouble("1.2.3", real));
+
+    EXPECT_TRUE(CSVSchema::toBoolean("TRUE", integer));
+    EXPECT_EQ(1, integer);
+    EXPECT_TRUE(CSVSchema::toBoolean("false", integer));
+    EXPECT_EQ(0, integer);
+    EXPECT_FALSE(CSVSchema::toBoolean("yes", integer));
+
+    EXPECT_TRUE(CSVSchema::toDate("1970-01-02", integer));
+    EXPECT_EQ(86400000, integer);
+    EXPECT_TRUE(CSVSchema::toDate("2000-02-29T12:30:15.250Z", integer));
+    EXPECT_EQ(951827415250, integer);
+    EXPECT_TRUE(CSVSchema::toDate("2000-02-29 14:30:15.250+02:00", integer));
+    EXPECT_EQ(951827415250, integer);
+    EXPECT_FALSE(CSVSchema::toDate("2001-02-29", integer));
+    EXPECT_FALSE(CSVSchema::toDate("2001-02-28T25:00", integer));
+    EXPECT_FALSE(CSVSchema::toDate("2001-02-28x", integer));
+
+}
+
+//
+// Types inferred from sample rows (and given by schema).
+//
+
+TEST_F(CSVSchemaTests, Inference) {
+
+    std::vector<std::string> fieldNames { "id", "price", "flag", "when", "zip", "note", "empty" };
+    CSVSchema schema(fieldNames, "note:int64");
+
+    schema.sample({"1", "2", "true", "2020-01-01", "01234", "5", ""});
+    schema.sample({"2", "2.5", "False", "2020-01-02T10:00Z", "12345", "x", ""});
+    schema.sample({"", "", "", "", "", "", ""});
+    schema.fix();
+
+    EXPECT_EQ(CSVSchema::Type::int64, schema.type(0));
+    EXPECT_EQ(CSVSchema::Type::real, schema.type(1));
+    EXPECT_EQ(CSVSchema::Type::boolean, schema.type(2));
+    EXPECT_EQ(CSVSchema::Type::date, schema.type(3));
+    EXPECT_EQ(CSVSchema::Type::string, schema.type(4));
+    EXPECT_EQ(CSVSchema::Type::int64, schema.type(5));
+    EXPECT_EQ(CSVSchema::Type::string, schema.type(6));
+    EXPECT_EQ(CSVSchema::Type::string, schema.type(7));
+
+    CSVSchema::Value value;
+
+    schema.convert(5, "x", value);
+    EXPECT_EQ(CSVSchema::Type::string, value.type);
+    EXPECT_EQ("x", value.text);
+    schema.convert(0, "", value);
+    EXPECT_EQ(CSVSchema::Type::null, value.type);
+
+    EXPECT_THROW(CSVSchema(fieldNames, "missing:int64"), CSVSchema::Exception);
+    EXPECT_THROW(CSVSchema(fieldNames, "id:number"), CSVSchema::Exception);
+    EXPECT_THROW(CSVSchema(fieldNames, "id"), CSVSchema::Exception);
+
+}
+
+//
+// Row encoded as BSON with native types.
+//
+
+TEST_F(CSVSchemaTests, EncodeBSON) {
+
+    std::vector<std::string> fieldNames { "a", "b", "c", "d", "e" };
+    CSVSchema schema(fieldNames, "a:int64,b:double,c:bool,d:string,e:date");
+    BSONEncoder encoder(fieldNames, &schema);
+    std::vector<std::uint8_t> document;
+
+    encoder.encode({"1", "0.5", "true", "hi", ""}, document);
+
+    const std::uint8_t expected[] {
+        0x2c, 0, 0, 0,
+        0x12, 'a', 0, 1, 0, 0, 0, 0, 0, 0, 0,
+        0x01, 'b', 0, 0, 0, 0, 0, 0, 0, 0xe0, 0x3f,
+        0x08, 'c', 0, 1,
+        0x02, 'd', 0, 3, 0, 0, 0, 'h', 'i', 0,
+        0x0a, 'e', 0,
+        0
+    };
+
+    ASSERT_EQ(sizeof (expected), document.size());
+    EXPECT_EQ(0, std::memcmp(expected, document.data(), document.size()));
+
+    BSONEncoder stringEncoder(fieldNames);
+
+    stringEncoder.encode({"1", "extra", "fields", "beyond", "names", "ignored"}, document);
+    EXPECT_EQ(4 + 5 * (1 + 2 + 4) + 2 + 6 + 7 + 7 + 6 + 1, document.size());
+
+    encoder.encode({"2"}, document, "id:0");
+
+    const std::uint8_t expectedWithId[] {
+        0x1e, 0, 0, 0,
+        0x02, '_', 'i', 'd', 0, 5, 0, 0, 0, 'i', 'd', ':', '0', 0,
+        0x12, 'a', 0, 2, 0, 0, 0, 0, 0, 0, 0,
+        0
+    };
+
+    ASSERT_EQ(sizeof (expectedWithId), document.size());
+    EXPECT_EQ(0, std::memcmp(expectedWithId, document.data(), document.size()));
+
+    encoder.encodeKey({"3", "0.5", "true", "hi"}, {0, 4}, document);
+
+    const std::uint8_t expectedKey[] {
+        0x13, 0, 0, 0,
+        0x12, 'a', 0, 3, 0, 0, 0, 0, 0, 0, 0,
+        0x0a, 'e', 0,
+        0
+    };
+
+    ASSERT_EQ(sizeof (expectedKey), document.size());
+    EXPECT_EQ(0, std::memcmp(expectedKey, document.data(), document.size()));
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,390 @@
+#include "HOST.hpp"
+/*
+ * File:   IMAPSessionTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE IMAP session run against a
+ * local stand-in IMAP server.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_IMAPSession.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL / Sockets
+//
+
+#include <atomic>
+#include <thread>
+#include <list>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// ==========================
+// STAND-IN IMAP SERVER CLASS
+// ==========================
+
+//
+// Minimal IMAP server on localhost that counts connections and NOOPs and
+// keeps the messages appended. It can be told to drop each connection after
+// an append to test reconnects.
+//
+
+class StandInIMAPServer {
+public:
+
+    StandInIMAPServer() {
+        struct sockaddr_in address {};
+        socklen_t addressLength = sizeof (address);
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listenSocket, reinterpret_cast<struct sockaddr *> (&address), sizeof (address));
+        listen(m_listenSocket, 8);
+        getsockname(m_listenSocket, reinterpret_cast<struct sockaddr *> (&address), &addressLength);
+        m_port = ntohs(address.sin_port);
+        m_acceptThread = std::thread(&StandInIMAPServer::acceptConnections, this);
+    }
+
+    ~StandInIMAPServer() {
+        m_bStop = true;
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+        for (auto &sessionThread : m_sessionThreads) {
+            sessionThread.join();
+        }
+    }
+
+    std::string url() const {
+        return ("imap://127.0.0.1:" + std::to_string(m_port));
+    }
+
+    std::vector<std::string> messages() {
+        std::lock_guard<std::mutex> locker(m_messagesMutex);
+        return (m_messages);
+    }
+
+    std::atomic<int> connections { 0 };
+    std::atomic<int> noops { 0 };
+    std::atomic<bool> bDropAfterAppend { false };
+    std::atomic<int> failAppend { 0 }; // APPEND refused (counting from 1, 0 for none)
+
+private:
+
+    void acceptConnections() {
+        int sessionSocket;
+        while ((sessionSocket = accept(m_listenSocket, nullptr, nullptr)) >= 0) {
+            connections++;
+            m_sessionThreads.emplace_back(&StandInIMAPServer::session, this, sessionSocket);
+        }
+    }
+
+    static void reply(int sessionSocket, const std::string &response) {
+        if (send(sessionSocket, response.data(), response.length(), MSG_NOSIGNAL) < 0) {
+            return;
+        }
+    }
+
+    void session(int sessionSocket) {
+        std::string buffer;
+        std::string literal;
+        std::string appendTag;
+        std::size_t literalLeft = 0;
+        bool bLiteralDone = false;
+        char readBuffer[65536];
+        ssize_t bytesRead;
+        reply(sessionSocket, "* OK stand-in IMAP4rev1 ready\r\n");
+        while (!m_bStop && ((bytesRead = recv(sessionSocket, readBuffer, sizeof (readBuffer), 0)) > 0)) {
+            buffer.append(readBuffer, bytesRead);
+            for (;;) {
+                if (literalLeft) {
+                    std::size_t take = std::min(literalLeft, buffer.size());
+                    literal.append(buffer, 0, take);
+                    buffer.erase(0, take);
+                    literalLeft -= take;
+                    if (literalLeft) {
+                        break;
+                    }
+                    bLiteralDone = true;
+                }
+                std::size_t lineEnd = buffer.find("\r\n");
+                if (lineEnd == std::string::npos) {
+                    break;
+                }
+                std::string line { buffer.substr(0, lineEnd) };
+                buffer.erase(0, lineEnd + 2);
+                if (bLiteralDone) {
+                    bLiteralDone = false;
+                    {
+                        std::lock_guard<std::mutex> locker(m_messagesMutex);
+                        m_messages.push_back(literal);
+                    }
+                    literal.clear();
+                    reply(sessionSocket, appendTag + " OK APPEND completed\r\n");
+                    if (bDropAfterAppend) {
+                        close(sessionSocket);
+                        return;
+                    }
+                    continue;
+                }
+                std::string tag { line.substr(0, line.find(' ')) };
+                std::string command { (line.find(' ') != std::string::npos) ? line.substr(line.find(' ') + 1) : "" };
+                if (command.compare(0, 10, "CAPABILITY") == 0) {
+                    reply(sessionSocket, "* CAPABILITY IMAP4rev1\r\n" + tag + " OK CAPABILITY completed\r\n");
+                } else if (command.compare(0, 4, "NOOP") == 0) {
+                    noops++;
+                    reply(sessionSocket, tag + " OK NOOP completed\r\n");
+                } else if ((command.compare(0, 6, "APPEND") == 0) && (++m_appends == failAppend)) {
+                    reply(sessionSocket, tag + " NO APPEND refused\r\n");
+                } else if (command.compare(0, 6, "APPEND") == 0) {
+                    literalLeft = std::stoul(command.substr(command.rfind('{') + 1));
+                    appendTag = tag;
+                    reply(sessionSocket, "+ Ready for literal data\r\n");
+                } else if (command.compare(0, 6, "LOGOUT") == 0) {
+                    reply(sessionSocket, "* BYE\r\n" + tag + " OK LOGOUT completed\r\n");
+                    break;
+                } else {
+                    reply(sessionSocket, tag + " OK completed\r\n");
+                }
+            }
+        }
+        close(sessionSocket);
+    }
+
+    int m_listenSocket { -1 };
+    int m_port { 0 };
+    std::atomic<bool> m_bStop { false };
+    std::thread m_acceptThread;
+    std::list<std::thread> m_sessionThreads;
+    std::atomic<int> m_appends { 0 };
+    std::mutex m_messagesMutex;
+    std::vector<std::string> m_messages;
+
+};
+
+// =======================
+// UNIT TEST FIXTURE CLASS
+// =======================
+
+class IMAPSessionTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    IMAPSessionTests() {
+    }
+
+    // Empty destructor
+
+    ~IMAPSessionTests() override {
+    }
+
+    void SetUp() override {
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    void TearDown() override {
+        curl_global_cleanup();
+    }
+
+    static void appendMessages(IMAPSession &session, int count);
+
+};
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Append a number of test messages in one call.
+//
+
+void IMAPSessionTests::appendMessages(IMAPSession &session, int count) {
+
+    std::vector<std::unique_ptr<MailMessage>> mailMessages;
+    std::vector<MailMessage *> appendMessages;
+
+    for (int message = 0; message < count; message++) {
+        mailMessages.emplace_back(new MailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File"));
+        mailMessages.back()->setBody("TEST TEXT");
+        appendMessages.push_back(mailMessages.back().get());
+    }
+
+    session.append("INBOX", appendMessages);
+
+}
+
+// ======================
+// IMAP SESSION UNIT TESTS
+// ======================
+
+//
+// Messages appended one after the other share a single connection, with a
+// NOOP before each append after the first.
+//
+
+TEST_F(IMAPSessionTests, AppendsReuseConnection) {
+
+    StandInIMAPServer server;
+
+    {
+        IMAPSession session(server.url(), "", "", false);
+        appendMessages(session, 2);
+        appendMessages(session, 3);
+        appendMessages(session, 1);
+    }
+
+    EXPECT_EQ(6, server.messages().size());
+    EXPECT_EQ(1, server.connections);
+    EXPECT_EQ(2, server.noops);
+
+}
+
+//
+// A message is appended exactly as generated, attachment included.
+//
+
+TEST_F(IMAPSessionTests, MessageStreamedWhole) {
+
+    StandInIMAPServer server;
+    std::string attachment { "/tmp/fpe_imapsession_attachment.txt" };
+    std::string wholeMessage;
+
+    {
+        std::ofstream attachmentStream(attachment);
+        for (int line = 0; line < 100000; line++) {
+            attachmentStream << "Attachment line " << line << "\n";
+        }
+    }
+
+    {
+        IMAPSession session(server.url(), "", "", false);
+        MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+        mailMessage.addAttachment(attachment, "text/plain");
+        session.append("INBOX", { &mailMessage });
+        mailMessage.rewind();
+        mailMessage.appendTo(wholeMessage);
+    }
+
+    std::remove(attachment.c_str());
+
+    ASSERT_EQ(1, server.messages().size());
+    EXPECT_EQ(wholeMessage, server.messages()[0]);
+
+}
+
+//
+// A connection dropped by the server is found by the NOOP and the next
+// append made on a new connection.
+//
+
+TEST_F(IMAPSessionTests, DroppedConnectionReconnects) {
+
+    StandInIMAPServer server;
+    server.bDropAfterAppend = true;
+
+    {
+        IMAPSession session(server.url(), "", "", false);
+        for (int append = 0; append < 3; append++) {
+            appendMessages(session, 1);
+        }
+    }
+
+    EXPECT_EQ(3, server.messages().size());
+    EXPECT_EQ(3, server.connections);
+
+}
+
+//
+// A message whose attachment cannot be read fails and the session still
+// appends the next message.
+//
+
+TEST_F(IMAPSessionTests, UnreadableAttachment) {
+
+    StandInIMAPServer server;
+    std::string attachment { "/tmp/fpe_imapsession_attachment.txt" };
+
+    {
+        IMAPSession session(server.url(), "", "", false);
+        MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+        std::ofstream(attachment) << "ATTACHMENT";
+        mailMessage.addAttachment(attachment, "text/plain");
+        std::remove(attachment.c_str());
+        EXPECT_THROW(session.append("INBOX", { &mailMessage }), IMAPSession::Exception);
+        appendMessages(session, 1);
+    }
+
+    EXPECT_EQ(1, server.messages().size());
+
+}
+
+//
+// A failed append ends the appends and reports how many were made before it
+// (so that they are not appended again).
+//
+
+TEST_F(IMAPSessionTests, FailedAppendCounted) {
+
+    StandInIMAPServer server;
+    server.failAppend = 3;
+
+    {
+        IMAPSession session(server.url(), "", "", false);
+        try {
+            appendMessages(session, 5);
+            FAIL() << "Append did not fail.";
+        } catch (const IMAPSession::Exception &e) {
+            EXPECT_EQ(2, e.appended);
+        }
+    }
+
+    EXPECT_EQ(2, server.messages().size());
+
+}
+
+//
+// No server listening.
+//
+
+TEST_F(IMAPSessionTests, NoServer) {
+
+    IMAPSession session("imap://127.0.0.1:1", "", "", false);
+
+    EXPECT_THROW(appendMessages(session, 1), IMAPSession::Exception);
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,223 @@
+#include "HOST.hpp"
+/*
+ * File:   MailMessageTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE streamed MIME mail message and
+ * base64 encoding.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_MailMessage.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL
+//
+
+#include <cstdio>
+#include <fstream>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class MailMessageTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    MailMessageTests() {
+    }
+
+    // Empty destructor
+
+    ~MailMessageTests() override {
+    }
+
+    void SetUp() override {
+    }
+
+    void TearDown() override {
+        std::remove(kAttachmentFile.c_str());
+    }
+
+    void createAttachment(std::size_t bytes);
+    static std::string encode(const std::string &input);
+
+    static const std::string kAttachmentFile; // Attachment test file
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string MailMessageTests::kAttachmentFile("/tmp/fpe_mailmessage_test.bin");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Create attachment of given size with every byte value present.
+//
+
+void MailMessageTests::createAttachment(std::size_t bytes) {
+
+    std::ofstream attachmentFile(kAttachmentFile, std::ios::binary);
+
+    for (std::size_t byte = 0; byte < bytes; byte++) {
+        attachmentFile.put(static_cast<char> ((byte * 7) & 0xff));
+    }
+
+}
+
+//
+// Base64 encode string.
+//
+
+std::string MailMessageTests::encode(const std::string &input) {
+
+    std::string output(MailMessage::encodedLength(input.length()), ' ');
+
+    output.resize(MailMessage::encodeBase64(reinterpret_cast<const unsigned char *> (input.data()),
+                                            input.length(), &output[0]));
+
+    return (output);
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// RFC 4648 test vectors (each line CRLF terminated).
+//
+
+TEST_F(MailMessageTests, Base64TestVectors) {
+
+    EXPECT_EQ("", encode(""));
+    EXPECT_EQ("Zg==\r\n", encode("f"));
+    EXPECT_EQ("Zm8=\r\n", encode("fo"));
+    EXPECT_EQ("Zm9v\r\n", encode("foo"));
+    EXPECT_EQ("Zm9vYg==\r\n", encode("foob"));
+    EXPECT_EQ("Zm9vYmE=\r\n", encode("fooba"));
+    EXPECT_EQ("Zm9vYmFy\r\n", encode("foobar"));
+
+}
+
+//
+// 57 bytes fill exactly one 76 character line; one more starts a second.
+//
+
+TEST_F(MailMessageTests, Base64LineLength) {
+
+    std::string line57(57, 'a');
+
+    EXPECT_EQ(78, encode(line57).length());
+    EXPECT_EQ(78, MailMessage::encodedLength(57));
+    EXPECT_EQ(78 + 6, encode(line57 + "a").length());
+    EXPECT_EQ(78 + 6, MailMessage::encodedLength(58));
+
+    for (std::size_t bytes = 0; bytes < 1024; bytes++) {
+        EXPECT_EQ(MailMessage::encodedLength(bytes), encode(std::string(bytes, '\xfe')).length());
+    }
+
+}
+
+//
+// Reading message in small chunks gives the same message as appending it whole
+// and its length matches that reported up front.
+//
+
+TEST_F(MailMessageTests, ChunkedReadMatchesLength) {
+
+    this->createAttachment(200 * 1024 + 13);
+
+    MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+    mailMessage.addAttachment(kAttachmentFile, "application/octet-stream");
+
+    std::string wholeMessage;
+    mailMessage.appendTo(wholeMessage);
+    EXPECT_EQ(mailMessage.length(), wholeMessage.length());
+
+    std::string chunkedMessage;
+    char buffer[1000];
+    std::size_t bytesRead;
+
+    mailMessage.rewind();
+    while ((bytesRead = mailMessage.read(buffer, sizeof (buffer))) != 0) {
+        chunkedMessage.append(buffer, bytesRead);
+    }
+
+    EXPECT_EQ(wholeMessage, chunkedMessage);
+    EXPECT_NE(std::string::npos, wholeMessage.find("Content-Transfer-Encoding: base64"));
+
+}
+
+//
+// Compressed attachment is sent as file.gz and is much smaller.
+//
+
+TEST_F(MailMessageTests, CompressedAttachment) {
+
+    this->createAttachment(512 * 1024);
+
+    {
+        MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+        mailMessage.addCompressedAttachment(kAttachmentFile);
+
+        std::string wholeMessage;
+        mailMessage.appendTo(wholeMessage);
+
+        EXPECT_NE(std::string::npos, wholeMessage.find("filename=\"fpe_mailmessage_test.bin.gz\""));
+        EXPECT_NE(std::string::npos, wholeMessage.find("Content-Type: application/gzip"));
+        EXPECT_LT(mailMessage.length(), MailMessage::encodedLength(512 * 1024) / 10);
+    }
+
+    EXPECT_TRUE(GZipFile::isCompressedType("image/jpeg"));
+    EXPECT_TRUE(GZipFile::isCompressedType("application/zip"));
+    EXPECT_FALSE(GZipFile::isCompressedType("text/csv"));
+
+}
+
+//
+// Missing attachment.
+//
+
+TEST_F(MailMessageTests, MissingAttachment) {
+
+    MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+
+    EXPECT_THROW(mailMessage.addAttachment("/tmp/fpe_mailmessage_missing.bin", "text/plain"), MailMessage::Exception);
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
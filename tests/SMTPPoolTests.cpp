@@ -0,0 +1,330 @@
+#include "HOST.hpp"
+/*
+ * File:   SMTPPoolTests.cpp
+ * 
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE SMTP session pool run against a
+ * local stand-in SMTP server.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_SMTPPool.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL / Sockets
+//
+
+#include <atomic>
+#include <thread>
+#include <list>
+#include <fstream>
+#include <cstdio>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// ==========================
+// STAND-IN SMTP SERVER CLASS
+// ==========================
+
+//
+// Minimal SMTP server on localhost that counts connections, messages and RSETs.
+// It can be told to drop each connection after a message to test reconnects.
+//
+
+class StandInSMTPServer {
+public:
+
+    StandInSMTPServer() {
+        struct sockaddr_in address {};
+        socklen_t addressLength = sizeof (address);
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listenSocket, reinterpret_cast<struct sockaddr *> (&address), sizeof (address));
+        listen(m_listenSocket, 8);
+        getsockname(m_listenSocket, reinterpret_cast<struct sockaddr *> (&address), &addressLength);
+        m_port = ntohs(address.sin_port);
+        m_acceptThread = std::thread(&StandInSMTPServer::acceptConnections, this);
+    }
+
+    ~StandInSMTPServer() {
+        m_bStop = true;
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+        for (auto &sessionThread : m_sessionThreads) {
+            sessionThread.join();
+        }
+    }
+
+    std::string url() const {
+        return ("smtp://127.0.0.1:" + std::to_string(m_port));
+    }
+
+    std::atomic<int> connections { 0 };
+    std::atomic<int> messages { 0 };
+    std::atomic<int> resets { 0 };
+    std::atomic<bool> bDropAfterMessage { false };
+
+private:
+
+    void acceptConnections() {
+        int sessionSocket;
+        while ((sessionSocket = accept(m_listenSocket, nullptr, nullptr)) >= 0) {
+            connections++;
+            m_sessionThreads.emplace_back(&StandInSMTPServer::session, this, sessionSocket);
+        }
+    }
+
+    static void reply(int sessionSocket, const std::string &response) {
+        if (send(sessionSocket, response.data(), response.length(), MSG_NOSIGNAL) < 0) {
+            return;
+        }
+    }
+
+    void session(int sessionSocket) {
+        std::string buffer;
+        bool bInData = false;
+        char readBuffer[4096];
+        ssize_t bytesRead;
+        reply(sessionSocket, "220 localhost ESMTP stand-in\r\n");
+        while (!m_bStop && ((bytesRead = recv(sessionSocket, readBuffer, sizeof (readBuffer), 0)) > 0)) {
+            buffer.append(readBuffer, bytesRead);
+            std::size_t lineEnd;
+            while ((lineEnd = buffer.find("\r\n")) != std::string::npos) {
+                std::string line { buffer.substr(0, lineEnd) };
+                buffer.erase(0, lineEnd + 2);
+                if (bInData) {
+                    if (line == ".") {
+                        bInData = false;
+                        messages++;
+                        reply(sessionSocket, "250 OK queued\r\n");
+                        if (bDropAfterMessage) {
+                            close(sessionSocket);
+                            return;
+                        }
+                    }
+                } else if (line.compare(0, 4, "EHLO") == 0) {
+                    reply(sessionSocket, "250-localhost\r\n250 8BITMIME\r\n");
+                } else if (line.compare(0, 4, "RSET") == 0) {
+                    resets++;
+                    reply(sessionSocket, "250 OK\r\n");
+                } else if (line.compare(0, 4, "DATA") == 0) {
+                    bInData = true;
+                    reply(sessionSocket, "354 End data with <CR><LF>.<CR><LF>\r\n");
+                } else if (line.compare(0, 4, "QUIT") == 0) {
+                    reply(sessionSocket, "221 Bye\r\n");
+                    break;
+                } else {
+                    reply(sessionSocket, "250 OK\r\n");
+                }
+            }
+        }
+        close(sessionSocket);
+    }
+
+    int m_listenSocket { -1 };
+    int m_port { 0 };
+    std::atomic<bool> m_bStop { false };
+    std::thread m_acceptThread;
+    std::list<std::thread> m_sessionThreads;
+
+};
+
+// =======================
+// UNIT TEST FIXTURE CLASS
+// =======================
+
+class SMTPPoolTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    SMTPPoolTests() {
+    }
+
+    // Empty destructor
+
+    ~SMTPPoolTests() override {
+    }
+
+    void SetUp() override {
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    void TearDown() override {
+        curl_global_cleanup();
+    }
+
+    void postMessages(SMTPPool &pool, int count);
+
+};
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Post a number of test messages through pool.
+//
+
+void SMTPPoolTests::postMessages(SMTPPool &pool, int count) {
+    for (int message = 0; message < count; message++) {
+        MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+        mailMessage.setBody("TEST TEXT");
+        pool.postMail("<fpe@localhost>", {"<test@localhost>"}, mailMessage);
+    }
+}
+
+// ===================
+// SMTP POOL UNIT TESTS
+// ===================
+
+//
+// Messages sent one after the other share a single connection with RSET between them.
+//
+
+TEST_F(SMTPPoolTests, MessagesReuseConnection) {
+
+    StandInSMTPServer server;
+
+    {
+        SMTPPool pool(server.url(), "", "", false);
+        this->postMessages(pool, 5);
+    }
+
+    EXPECT_EQ(5, server.messages);
+    EXPECT_EQ(1, server.connections);
+    EXPECT_EQ(4, server.resets);
+
+}
+
+//
+// A session idle for longer than the idle timeout is reconnected.
+//
+
+TEST_F(SMTPPoolTests, IdleSessionReconnects) {
+
+    StandInSMTPServer server;
+
+    {
+        SMTPPool pool(server.url(), "", "", false);
+        pool.setIdleTimeout(std::chrono::seconds(0));
+        this->postMessages(pool, 3);
+    }
+
+    EXPECT_EQ(3, server.messages);
+    EXPECT_EQ(3, server.connections);
+
+}
+
+//
+// A connection dropped by the server is detected and the next message still sent.
+//
+
+TEST_F(SMTPPoolTests, DroppedConnectionReconnects) {
+
+    StandInSMTPServer server;
+    server.bDropAfterMessage = true;
+
+    {
+        SMTPPool pool(server.url(), "", "", false);
+        this->postMessages(pool, 3);
+    }
+
+    EXPECT_EQ(3, server.messages);
+    EXPECT_EQ(3, server.connections);
+
+}
+
+//
+// Sessions are shared by threads and only as many connections as are needed are made.
+//
+
+TEST_F(SMTPPoolTests, SharedAcrossThreads) {
+
+    StandInSMTPServer server;
+
+    {
+        SMTPPool pool(server.url(), "", "", false);
+        std::vector<std::thread> senders;
+        for (int sender = 0; sender < 4; sender++) {
+            senders.emplace_back([this, &pool] () {
+                this->postMessages(pool, 5);
+            });
+        }
+        for (auto &sender : senders) {
+            sender.join();
+        }
+    }
+
+    EXPECT_EQ(20, server.messages);
+    EXPECT_LE(server.connections, 4);
+
+}
+
+//
+// A message whose attachment cannot be read fails without losing the
+// session's resources and the pool still sends the next message.
+//
+
+TEST_F(SMTPPoolTests, UnreadableAttachment) {
+
+    StandInSMTPServer server;
+    std::string attachment { "/tmp/fpe_smtppool_attachment.txt" };
+
+    {
+        SMTPPool pool(server.url(), "", "", false);
+        MailMessage mailMessage("<fpe@localhost>", "<test@localhost>", "FPE Attached File");
+        std::ofstream(attachment) << "ATTACHMENT";
+        mailMessage.addAttachment(attachment, "text/plain");
+        std::remove(attachment.c_str());
+        EXPECT_THROW(pool.postMail("<fpe@localhost>", {"<test@localhost>"}, mailMessage), SMTPPool::Exception);
+        this->postMessages(pool, 1);
+    }
+
+    EXPECT_EQ(1, server.messages);
+
+}
+
+//
+// No server listening.
+//
+
+TEST_F(SMTPPoolTests, NoServer) {
+
+    SMTPPool pool("smtp://127.0.0.1:1", "", "", false);
+
+    EXPECT_THROW(this->postMessages(pool, 1), SMTPPool::Exception);
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
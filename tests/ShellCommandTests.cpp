@@ -0,0 +1,232 @@
+#include "HOST.hpp"
+/*
+ * File:   ShellCommandTests.cpp
+ * 
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE shell command templates.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_ShellCommand.hpp"
+
+#include <chrono>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace FPE_TaskActions;
+
+// =======================
+// UNIT TEST FIXTURE CLASS
+// =======================
+
+class ShellCommandTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    ShellCommandTests() {
+    }
+
+    // Empty destructor
+
+    ~ShellCommandTests() override {
+    }
+
+    void SetUp() override {
+    }
+
+    void TearDown() override {
+    }
+
+    std::vector<std::string> toVector(char *const argv[]);
+
+};
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Convert rendered argv to a vector of strings for comparison.
+//
+
+std::vector<std::string> ShellCommandTests::toVector(char *const argv[]) {
+    std::vector<std::string> arguments;
+    while (*argv != nullptr) {
+        arguments.push_back(*argv++);
+    }
+    return (arguments);
+}
+
+// ============================
+// SHELL COMMAND TEMPLATE TESTS
+// ============================
+
+//
+// Command with no placeholders
+//
+
+TEST_F(ShellCommandTests, NoPlaceholders) {
+
+    ShellCommand command("echo  hello   world");
+
+    EXPECT_FALSE(command.hasSource());
+    EXPECT_FALSE(command.hasDestination());
+    EXPECT_FALSE(command.hasFiles());
+    EXPECT_EQ(std::vector<std::string>({"echo", "hello", "world"}), this->toVector(command.argv("/tmp/watch/a.txt")));
+
+}
+
+//
+// Source and destination placeholders as whole and part arguments
+//
+
+TEST_F(ShellCommandTests, SourceAndDestination) {
+
+    ShellCommand command("cp %1% --target=%2%");
+
+    EXPECT_TRUE(command.hasSource());
+    EXPECT_TRUE(command.hasDestination());
+    EXPECT_EQ(std::vector<std::string>({"cp", "/tmp/watch/a.txt", "--target=/tmp/destination/a.txt"}),
+            this->toVector(command.argv("/tmp/watch/a.txt", "/tmp/destination/a.txt")));
+    EXPECT_EQ(std::vector<std::string>({"cp", "/tmp/watch/b.txt", "--target=/tmp/destination/b.txt"}),
+            this->toVector(command.argv("/tmp/watch/b.txt", "/tmp/destination/b.txt")));
+
+}
+
+//
+// Paths containing spaces stay a single argument
+//
+
+TEST_F(ShellCommandTests, SourceWithSpaces) {
+
+    ShellCommand command("echo %1%");
+
+    EXPECT_EQ(std::vector<std::string>({"echo", "/tmp/watch/a file.txt"}), this->toVector(command.argv("/tmp/watch/a file.txt")));
+
+}
+
+//
+// Single and double quoted arguments
+//
+
+TEST_F(ShellCommandTests, QuotedArguments) {
+
+    ShellCommand command("HandBrakeCLI -i \"%1%\" --preset=\"Very Fast 1080p30\" 'literal %1%' \"a \\\"b\\\"\" '' back\\ slash");
+
+    EXPECT_EQ(std::vector<std::string>({"HandBrakeCLI", "-i", "/tmp/watch/a.mkv", "--preset=Very Fast 1080p30",
+        "literal %1%", "a \"b\"", "", "back slash"}), this->toVector(command.argv("/tmp/watch/a.mkv")));
+
+}
+
+//
+// Batch of files replaces %files%
+//
+
+TEST_F(ShellCommandTests, FilesPlaceholder) {
+
+    ShellCommand command("gzip -9 %files%");
+
+    EXPECT_TRUE(command.hasFiles());
+    EXPECT_EQ(std::vector<std::string>({"gzip", "-9", "/tmp/watch/a", "/tmp/watch/b", "/tmp/watch/c"}),
+            this->toVector(command.argv(std::vector<std::string>({"/tmp/watch/a", "/tmp/watch/b", "/tmp/watch/c"}))));
+    EXPECT_LT(command.argumentSpace(), static_cast<std::size_t>(sysconf(_SC_ARG_MAX)));
+
+}
+
+//
+// Invalid command templates
+//
+
+TEST_F(ShellCommandTests, InvalidCommands) {
+
+    EXPECT_THROW(ShellCommand("echo \"unterminated"), ShellCommand::Exception);
+    EXPECT_THROW(ShellCommand("   "), ShellCommand::Exception);
+    EXPECT_THROW(ShellCommand("echo --files=%files%"), ShellCommand::Exception);
+
+}
+
+//
+// Run command and check exit status
+//
+
+TEST_F(ShellCommandTests, RunCommand) {
+
+    std::string output;
+
+    EXPECT_EQ(0, ShellCommand("true %1%").run("/tmp/watch/a.txt"));
+    EXPECT_NE(0, ShellCommand("false %1%").run("/tmp/watch/a.txt"));
+    EXPECT_NE(0, ShellCommand("foobar %1%").run("/tmp/watch/a.txt"));
+    EXPECT_EQ(0, ShellCommand("echo OK %files%").run(std::vector<std::string>({"a", "b"}), output));
+    EXPECT_EQ("OK a b\n", output);
+
+}
+
+//
+// Command exceeding timeout is killed along with its process group
+//
+
+TEST_F(ShellCommandTests, RunCommandTimeout) {
+
+    ShellCommand command("sh -c \"sleep 30 & sleep 30; echo %1%\"");
+    ShellCommand::Limits limits;
+    std::string output;
+
+    limits.timeout = 1;
+    limits.killGrace = 1;
+    command.setLimits(limits);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(128 + SIGTERM, command.run("/tmp/watch/a.txt"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+    ShellCommand ignoreTerm("sh -c \"trap '' TERM; sleep 30\" %files%");
+    ignoreTerm.setLimits(limits);
+    EXPECT_EQ(128 + SIGKILL, ignoreTerm.run(std::vector<std::string>({"a"}), output));
+
+}
+
+//
+// Command resource limits
+//
+
+TEST_F(ShellCommandTests, RunCommandResourceLimits) {
+
+    ShellCommand command("sh -c \"ulimit -n; ulimit -t\" %files%");
+    ShellCommand::Limits limits;
+    std::string output;
+
+    limits.openFiles = 64;
+    limits.cpuSeconds = 30;
+    command.setLimits(limits);
+
+    EXPECT_EQ(0, command.run(std::vector<std::string>({}), output));
+    EXPECT_EQ("64\n30\n", output);
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
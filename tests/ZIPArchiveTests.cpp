@@ -0,0 +1,455 @@
+#include "HOST.hpp"
+/*
+ * File:   ZIPArchiveTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE ZIP archive appender.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_ZIPArchive.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL / Linux
+//
+
+#include <fstream>
+#include <cstdlib>
+#include <thread>
+#include <filesystem>
+#include <zlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class ZIPArchiveTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    ZIPArchiveTests() {
+    }
+
+    // Empty destructor
+
+    ~ZIPArchiveTests() override {
+    }
+
+    void SetUp() override {
+        std::filesystem::remove_all(kTestDirectory);
+        std::filesystem::create_directories(kTestDirectory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    std::string createFile(const std::string &fileName, std::size_t lines);
+    static std::string inflateEntry(const std::string &archiveName, const ZIPArchive::Entry &entry);
+
+    static const std::string kTestDirectory; // Test files and archives
+    static const std::string kArchive; // Test archive
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string ZIPArchiveTests::kTestDirectory("/tmp/fpe_zip_test");
+const std::string ZIPArchiveTests::kArchive("/tmp/fpe_zip_test/archive.zip");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Create text file of a number of lines.
+//
+
+std::string ZIPArchiveTests::createFile(const std::string &fileName, std::size_t lines) {
+
+    std::string file { kTestDirectory + "/" + fileName };
+    std::ofstream fileStream(file);
+
+    for (std::size_t line = 0; line < lines; line++) {
+        fileStream << fileName << " line " << line << "\n";
+    }
+
+    return (file);
+
+}
+
+//
+// Read entry back from archive through its local header and inflate it.
+//
+
+std::string ZIPArchiveTests::inflateEntry(const std::string &archiveName, const ZIPArchive::Entry &entry) {
+
+    std::ifstream archiveStream(archiveName, std::ios::binary);
+    unsigned char header[30];
+
+    archiveStream.seekg(entry.headerOffset);
+    archiveStream.read(reinterpret_cast<char *> (header), sizeof (header));
+    archiveStream.seekg(entry.headerOffset + 30 + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8)));
+
+    std::string compressed(entry.compressedSize, '\0');
+    std::string uncompressed(entry.uncompressedSize, '\0');
+    archiveStream.read(&compressed[0], compressed.size());
+
+    if (entry.method == 0) {
+        return (compressed);
+    }
+
+    z_stream inflateStream {};
+    inflateInit2(&inflateStream, -MAX_WBITS);
+    inflateStream.next_in = reinterpret_cast<Bytef *> (&compressed[0]);
+    inflateStream.avail_in = static_cast<uInt> (compressed.size());
+    inflateStream.next_out = reinterpret_cast<Bytef *> (&uncompressed[0]);
+    inflateStream.avail_out = static_cast<uInt> (uncompressed.size());
+    int result = inflate(&inflateStream, Z_FINISH);
+    inflateEnd(&inflateStream);
+
+    return ((result == Z_STREAM_END) ? uncompressed : std::string());
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Files appended across open/close are all listed and read back intact.
+//
+
+TEST_F(ZIPArchiveTests, AppendAndReopen) {
+
+    {
+        ZIPArchive archive(kArchive);
+        archive.open();
+        archive.add(this->createFile("file1.txt", 1000), "file1.txt");
+        archive.add(this->createFile("file2.txt", 0), "file2.txt");
+        archive.close();
+    }
+
+    ZIPArchive archive(kArchive);
+    archive.open();
+    archive.add(this->createFile("file3.txt", 50000), "file3.txt");
+    archive.close();
+
+    archive.open();
+    auto entries = archive.entries();
+    archive.close();
+
+    ASSERT_EQ(3, entries.size());
+    EXPECT_EQ("file1.txt", entries[0].name);
+    EXPECT_EQ("file3.txt", entries[2].name);
+    EXPECT_EQ(0, entries[1].uncompressedSize);
+
+    for (auto &entry : entries) {
+        std::string contents { inflateEntry(kArchive, entry) };
+        std::ifstream fileStream(kTestDirectory + "/" + entry.name);
+        std::string original((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(original, contents);
+        EXPECT_EQ(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *> (contents.data()), contents.size()), entry.crc32);
+    }
+
+}
+
+//
+// A file deflated in parallel chunks reads back intact and is compressed.
+//
+
+TEST_F(ZIPArchiveTests, ParallelDeflate) {
+
+    ZIPArchive archive(kArchive);
+    archive.setThreads(4);
+    archive.open();
+    archive.add(this->createFile("large.txt", 200000), "large.txt");
+    archive.close();
+
+    archive.open();
+    auto entries = archive.entries();
+    archive.close();
+
+    ASSERT_EQ(1, entries.size());
+
+    std::string contents { inflateEntry(kArchive, entries[0]) };
+    std::ifstream fileStream(kTestDirectory + "/large.txt");
+    std::string original((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+
+    EXPECT_EQ(original, contents);
+    EXPECT_EQ(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *> (original.data()), original.size()), entries[0].crc32);
+    EXPECT_LT(entries[0].compressedSize, original.size() / 4);
+
+}
+
+//
+// Compressed formats (by extension, magic bytes or entropy) are stored and
+// everything else is deflated.
+//
+
+TEST_F(ZIPArchiveTests, StoreIncompressible) {
+
+    std::string random(kTestDirectory + "/random.dat");
+    std::string gzipped(kTestDirectory + "/data.bin");
+    std::string text { this->createFile("file.txt", 1000) };
+
+    {
+        std::ofstream randomStream(random, std::ios::binary);
+        std::srand(1);
+        for (int byte = 0; byte < 100000; byte++) {
+            randomStream.put(static_cast<char> (std::rand() & 0xff));
+        }
+        std::ofstream gzipStream(gzipped, std::ios::binary);
+        gzipStream << "\x1f\x8b\x08 rest of header";
+    }
+
+    std::filesystem::copy_file(text, kTestDirectory + "/photo.JPG");
+
+    ZIPArchive archive(kArchive);
+    archive.open();
+    archive.add(random, "random.dat");
+    archive.add(gzipped, "data.bin");
+    archive.add(kTestDirectory + "/photo.JPG", "photo.JPG");
+    archive.add(text, "file.txt");
+    archive.close();
+
+    archive.open();
+    auto entries = archive.entries();
+    archive.close();
+
+    ASSERT_EQ(4, entries.size());
+    EXPECT_EQ(0, entries[0].method);
+    EXPECT_EQ(0, entries[1].method);
+    EXPECT_EQ(0, entries[2].method);
+    EXPECT_EQ(8, entries[3].method);
+    EXPECT_EQ(entries[0].uncompressedSize, entries[0].compressedSize);
+
+    std::ifstream randomStream(random, std::ios::binary);
+    std::string original((std::istreambuf_iterator<char>(randomStream)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(original, inflateEntry(kArchive, entries[0]));
+    EXPECT_EQ(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *> (original.data()), original.size()), entries[0].crc32);
+
+}
+
+//
+// Files already in the archive (found through the index loaded from its
+// central directory) are skipped or added as new versions.
+//
+
+TEST_F(ZIPArchiveTests, Duplicates) {
+
+    std::string file { this->createFile("file.txt", 100) };
+
+    {
+        ZIPArchive archive(kArchive);
+        archive.open();
+        EXPECT_EQ("file.txt", archive.add(file, "file.txt"));
+        archive.close();
+    }
+
+    ZIPArchive archive(kArchive);
+    ZIPArchive::Entry entry;
+
+    archive.setDuplicates(ZIPArchive::Duplicates::version);
+    archive.open();
+    EXPECT_TRUE(archive.find("file.txt", entry));
+    EXPECT_FALSE(archive.find("file~2.txt", entry));
+
+    EXPECT_EQ("", archive.add(file, "file.txt"));
+    this->createFile("file.txt", 200);
+    EXPECT_EQ("file~2.txt", archive.add(file, "file.txt"));
+    EXPECT_EQ("", archive.add(file, "file.txt"));
+    this->createFile("file.txt", 300);
+    EXPECT_EQ("file~3.txt", archive.add(file, "file.txt"));
+
+    archive.setDuplicates(ZIPArchive::Duplicates::skip);
+    EXPECT_EQ("file.txt", archive.add(file, "file.txt"));
+    EXPECT_EQ("", archive.add(file, "file.txt"));
+
+    archive.setDuplicates(ZIPArchive::Duplicates::add);
+    EXPECT_EQ("file.txt", archive.add(file, "file.txt"));
+
+    EXPECT_EQ(5, archive.entryCount());
+    ASSERT_TRUE(archive.find("file~3.txt", entry));
+    EXPECT_EQ(std::filesystem::file_size(file), entry.uncompressedSize);
+    archive.close();
+
+}
+
+//
+// Entries of an archive opened read only are extracted by several threads
+// at once; a corrupt entry is not left behind.
+//
+
+TEST_F(ZIPArchiveTests, ExtractEntries) {
+
+    {
+        ZIPArchive archive(kArchive);
+        archive.setThreads(2);
+        archive.open();
+        for (int file = 0; file < 8; file++) {
+            std::string fileName { "file" + std::to_string(file) + ".txt" };
+            archive.add(this->createFile(fileName, 20000 * file), fileName);
+        }
+        archive.close();
+    }
+
+    ZIPArchive archive(kArchive);
+    archive.open(true);
+
+    auto entries = archive.entries();
+    std::vector<std::thread> workers;
+
+    for (auto &entry : entries) {
+        workers.emplace_back([&archive, &entry] () {
+            archive.extract(entry, kTestDirectory + "/" + entry.name + ".out");
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (auto &entry : entries) {
+        std::ifstream originalStream(kTestDirectory + "/" + entry.name);
+        std::ifstream extractedStream(kTestDirectory + "/" + entry.name + ".out");
+        std::string original((std::istreambuf_iterator<char>(originalStream)), std::istreambuf_iterator<char>());
+        std::string extracted((std::istreambuf_iterator<char>(extractedStream)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(original, extracted);
+    }
+
+    ZIPArchive::Entry badEntry { entries[1] };
+    badEntry.crc32 ^= 1;
+
+    EXPECT_THROW(archive.extract(badEntry, kTestDirectory + "/bad.out"), ZIPArchive::Exception);
+    EXPECT_FALSE(std::filesystem::exists(kTestDirectory + "/bad.out"));
+    EXPECT_THROW(archive.extract(entries[1], kTestDirectory + "/" + entries[2].name + ".out"), ZIPArchive::Exception);
+    EXPECT_TRUE(std::filesystem::exists(kTestDirectory + "/" + entries[2].name + ".out"));
+    EXPECT_THROW(archive.add(kTestDirectory + "/file1.txt", "file1.txt"), ZIPArchive::Exception);
+
+    archive.close();
+
+}
+
+//
+// An archive of more than 65535 entries gets ZIP64 end records and its
+// central directory is read back (not recovered) when reopened.
+//
+
+TEST_F(ZIPArchiveTests, ZIP64EntryCount) {
+
+    std::string file { this->createFile("file.txt", 1) };
+
+    {
+        ZIPArchive archive(kArchive);
+        archive.open();
+        for (int entry = 0; entry < 70000; entry++) {
+            archive.add(file, "file" + std::to_string(entry) + ".txt");
+        }
+        archive.close();
+    }
+
+    ZIPArchive archive(kArchive);
+
+    testing::internal::CaptureStderr();
+    archive.open();
+    std::string recovered { testing::internal::GetCapturedStderr() };
+
+    auto entries = archive.entries();
+    archive.close();
+
+    EXPECT_TRUE(recovered.empty());
+    ASSERT_EQ(70000, entries.size());
+    EXPECT_EQ("file69999.txt", entries.back().name);
+    EXPECT_EQ("file.txt line 0\n", inflateEntry(kArchive, entries.back()));
+
+}
+
+//
+// Entries added after the last flush by a process that then dies are
+// recovered from their local headers when the archive is reopened.
+//
+
+TEST_F(ZIPArchiveTests, RecoverAfterCrash) {
+
+    {
+        ZIPArchive archive(kArchive);
+        archive.open();
+        archive.add(this->createFile("file1.txt", 100), "file1.txt");
+        archive.close();
+    }
+
+    std::string file2 { this->createFile("file2.txt", 200) };
+    std::string file3 { this->createFile("file3.txt", 300) };
+
+    pid_t child = fork();
+    if (child == 0) {
+        ZIPArchive archive(kArchive);
+        archive.open();
+        archive.add(file2, "file2.txt");
+        archive.add(file3, "file3.txt");
+        _exit(0);
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+
+    ZIPArchive archive(kArchive);
+    archive.open();
+    auto entries = archive.entries();
+    archive.close();
+
+    ASSERT_EQ(3, entries.size());
+    EXPECT_EQ("file3.txt", entries[2].name);
+    std::string contents { inflateEntry(kArchive, entries[2]) };
+    EXPECT_EQ(300, std::count(contents.begin(), contents.end(), '\n'));
+
+}
+
+//
+// A file that is not a ZIP archive is not overwritten.
+//
+
+TEST_F(ZIPArchiveTests, NotAnArchive) {
+
+    this->createFile("archive.zip", 10);
+
+    ZIPArchive archive(kArchive);
+
+    EXPECT_THROW(archive.open(), ZIPArchive::Exception);
+    EXPECT_EQ(10 * std::string("archive.zip line 0\n").length(), std::filesystem::file_size(kArchive));
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
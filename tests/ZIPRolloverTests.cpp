@@ -0,0 +1,259 @@
+#include "HOST.hpp"
+/*
+ * File:   ZIPRolloverTests.cpp
+ *
+ * Author: Robert Tizzard
+ *
+ * Description: Google unit tests for FPE rolling/sharded ZIP archives.
+ *
+ * Copyright 2016.
+ *
+ */
+
+// =============
+// INCLUDE FILES
+// =============
+
+//
+// Google test definitions
+//
+
+#include "gtest/gtest.h"
+
+//
+// FPE Components
+//
+
+#include "FPE_ZIPRollover.hpp"
+
+using namespace FPE_TaskActions;
+
+//
+// C++ STL
+//
+
+#include <fstream>
+#include <filesystem>
+
+// =========================
+// UNIT TEST FIXTURE CLASSES
+// =========================
+
+class ZIPRolloverTests : public ::testing::Test {
+protected:
+
+    // Empty constructor
+
+    ZIPRolloverTests() {
+    }
+
+    // Empty destructor
+
+    ~ZIPRolloverTests() override {
+    }
+
+    void SetUp() override {
+        std::filesystem::remove_all(kTestDirectory);
+        std::filesystem::create_directories(kTestDirectory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(kTestDirectory);
+    }
+
+    std::string createFile(const std::string &fileName, std::size_t lines);
+    static std::size_t entryCount(const std::string &archiveName);
+
+    static const std::string kTestDirectory; // Test files and archives
+
+};
+
+// =================
+// FIXTURE CONSTANTS
+// =================
+
+const std::string ZIPRolloverTests::kTestDirectory("/tmp/fpe_ziprollover_test");
+
+// ===============
+// FIXTURE METHODS
+// ===============
+
+//
+// Create text file of a number of lines.
+//
+
+std::string ZIPRolloverTests::createFile(const std::string &fileName, std::size_t lines) {
+
+    std::string file { kTestDirectory + "/" + fileName };
+    std::ofstream fileStream(file);
+
+    for (std::size_t line = 0; line < lines; line++) {
+        fileStream << fileName << " line " << line << "\n";
+    }
+
+    return (file);
+
+}
+
+//
+// Number of entries in an archive.
+//
+
+std::size_t ZIPRolloverTests::entryCount(const std::string &archiveName) {
+
+    ZIPArchive archive(archiveName);
+
+    archive.open();
+    std::size_t entries = archive.entryCount();
+    archive.close();
+
+    return (entries);
+
+}
+
+// =====================
+// TEST FIXTURE MAIN CODE
+// =====================
+
+//
+// Pattern expansion of date, sequence and shard (and escaped %).
+//
+
+TEST_F(ZIPRolloverTests, ArchiveName) {
+
+    struct tm localTime {};
+
+    localTime.tm_year = 2016 - 1900;
+    localTime.tm_mon = 6;
+    localTime.tm_mday = 4;
+    localTime.tm_isdst = -1;
+
+    std::time_t when = std::mktime(&localTime);
+
+    EXPECT_EQ("archive-20160704-3.zip", ZIPRollover::archiveName("archive-%Y%m%d-%n.zip", when, 3, ZIPRollover::kNoShard));
+    EXPECT_EQ("2016/archive-2-1.zip", ZIPRollover::archiveName("%Y/archive-%i-%n.zip", when, 1, 2));
+    EXPECT_EQ("archive-%n.zip", ZIPRollover::archiveName("archive-%%n.zip", when, 1, ZIPRollover::kNoShard));
+
+}
+
+//
+// An entry limit starts a new archive (sequence number added to name) and
+// reopening the series carries on from the last archive.
+//
+
+TEST_F(ZIPRolloverTests, RolloverOnEntries) {
+
+    ZIPRollover::Limits limits;
+
+    limits.maxEntries = 2;
+
+    {
+        ZIPRollover archive(kTestDirectory + "/archive.zip", limits);
+        archive.open();
+        for (int file = 0; file < 5; file++) {
+            std::string fileName { "file" + std::to_string(file) + ".txt" };
+            archive.add(this->createFile(fileName, 10), fileName);
+        }
+        archive.close();
+    }
+
+    EXPECT_EQ(2, entryCount(kTestDirectory + "/archive-1.zip"));
+    EXPECT_EQ(2, entryCount(kTestDirectory + "/archive-2.zip"));
+    EXPECT_EQ(1, entryCount(kTestDirectory + "/archive-3.zip"));
+
+    ZIPRollover archive(kTestDirectory + "/archive.zip", limits);
+    archive.open();
+    archive.add(this->createFile("file5.txt", 10), "file5.txt");
+    EXPECT_EQ(kTestDirectory + "/archive-3.zip", archive.currentArchive());
+    archive.add(this->createFile("file6.txt", 10), "file6.txt");
+    EXPECT_EQ(kTestDirectory + "/archive-4.zip", archive.currentArchive());
+    archive.close();
+
+}
+
+//
+// A byte limit starts a new archive before the next file would pass it.
+//
+
+TEST_F(ZIPRolloverTests, RolloverOnBytes) {
+
+    ZIPRollover::Limits limits;
+
+    limits.maxBytes = 64 * 1024;
+
+    ZIPRollover archive(kTestDirectory + "/archive-%n.zip", limits);
+    archive.open();
+    archive.add(this->createFile("small.txt", 10), "small.txt");
+    EXPECT_EQ(kTestDirectory + "/archive-1.zip", archive.currentArchive());
+    archive.add(this->createFile("large.txt", 10000), "large.txt");
+    EXPECT_EQ(kTestDirectory + "/archive-2.zip", archive.currentArchive());
+    archive.close();
+
+}
+
+//
+// Files queued to shards all end up in one of the shard archives.
+//
+
+TEST_F(ZIPRolloverTests, Shards) {
+
+    {
+        ZIPShards shards(kTestDirectory + "/archive.zip", ZIPRollover::Limits(), 3, 1, 0, std::chrono::seconds(0));
+        for (int file = 0; file < 30; file++) {
+            std::string fileName { "file" + std::to_string(file) + ".txt" };
+            shards.add(this->createFile(fileName, 1000), fileName);
+        }
+        shards.close();
+    }
+
+    std::size_t entries = 0;
+
+    for (int shard = 1; shard <= 3; shard++) {
+        std::string archiveName { kTestDirectory + "/archive-" + std::to_string(shard) + ".zip" };
+        ASSERT_TRUE(std::filesystem::exists(archiveName));
+        entries += entryCount(archiveName);
+    }
+
+    EXPECT_EQ(30, entries);
+
+}
+
+//
+// A name always goes to the same shard so duplicates are found across
+// shards and files that cannot be added are counted.
+//
+
+TEST_F(ZIPRolloverTests, ShardsDuplicatesAndFailures) {
+
+    {
+        ZIPShards shards(kTestDirectory + "/archive.zip", ZIPRollover::Limits(), 3, 1, 0, std::chrono::seconds(0),
+                ZIPArchive::Duplicates::skip);
+        for (int pass = 0; pass < 2; pass++) {
+            for (int file = 0; file < 30; file++) {
+                std::string fileName { "file" + std::to_string(file) + ".txt" };
+                shards.add(this->createFile(fileName, 1000), fileName);
+            }
+        }
+        shards.add(kTestDirectory + "/missing.txt", "missing.txt");
+        shards.close();
+        EXPECT_EQ(1, shards.failed());
+    }
+
+    std::size_t entries = 0;
+
+    for (int shard = 1; shard <= 3; shard++) {
+        entries += entryCount(kTestDirectory + "/archive-" + std::to_string(shard) + ".zip");
+    }
+
+    EXPECT_EQ(30, entries);
+
+}
+
+// =====================
+// RUN GOOGLE UNIT TESTS
+// =====================
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}